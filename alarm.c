@@ -0,0 +1,125 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "bmp180.h"
+#include "alarm.h"
+
+/* the pressure thresholds of the altitudes at the current QNH */
+static void thresholds(struct alarm_t *alarm)
+{
+	float h;
+	uint8_t i;
+
+	h = (float)alarm->hyst / 2;
+
+	for (i = 0; i < alarm->n; i++) {
+		alarm->rise[i] = bmp180_math_p_altitude(alarm->altitude[i] + h,
+				alarm->p0);
+		alarm->fall[i] = bmp180_math_p_altitude(alarm->altitude[i] - h,
+				alarm->p0);
+	}
+
+	/* the band must be found again */
+	alarm->band = ALARM_UNKNOWN;
+}
+
+/*! Init with no thresholds at the standard sea level pressure.
+ *
+ * \param event the callback, called by alarm_check(), can be NULL.
+ */
+void alarm_init(struct alarm_t *alarm,
+		void (*event)(const uint8_t threshold, const uint8_t dir))
+{
+	alarm->n = 0;
+	alarm->hyst = 0;
+	alarm->band = ALARM_UNKNOWN;
+	alarm->p0 = BMP180_SEALEVEL;
+	alarm->event = event;
+}
+
+/*! Set the thresholds.
+ *
+ * \param altitude the thresholds in m, ascending.
+ * \param n the number of thresholds.
+ * \param hyst the hysteresis in m.
+ * \return 0 - OK, 1 - too many or not ascending.
+ */
+uint8_t alarm_set(struct alarm_t *alarm, const int16_t *altitude,
+		const uint8_t n, const uint8_t hyst)
+{
+	uint8_t i;
+
+	if (n > ALARM_MAX)
+		return(1);
+
+	for (i = 1; i < n; i++)
+		if (altitude[i] <= altitude[i - 1] + hyst)
+			return(1);
+
+	for (i = 0; i < n; i++)
+		alarm->altitude[i] = altitude[i];
+
+	alarm->n = n;
+	alarm->hyst = hyst;
+	thresholds(alarm);
+	return(0);
+}
+
+/*! Set the QNH, the thresholds are computed again.
+ *
+ * \param p0 the pressure at the sea level in Pa.
+ */
+void alarm_qnh(struct alarm_t *alarm, const int32_t p0)
+{
+	alarm->p0 = p0;
+	thresholds(alarm);
+}
+
+/*! Check a sample.
+ *
+ * The first sample after a set or a QNH change only finds the band,
+ * no event is sent.
+ *
+ * \param p the pressure in Pa.
+ */
+void alarm_check(struct alarm_t *alarm, const int32_t p)
+{
+	uint8_t b;
+
+	if (alarm->band == ALARM_UNKNOWN) {
+		for (b = 0; (b < alarm->n) && (p < alarm->rise[b]); b++);
+
+		alarm->band = b;
+		return;
+	}
+
+	/* the pressure falls, the altitude rises */
+	while ((alarm->band < alarm->n) && (p < alarm->rise[alarm->band])) {
+		if (alarm->event)
+			alarm->event(alarm->band, ALARM_UP);
+
+		alarm->band++;
+	}
+
+	while (alarm->band && (p > alarm->fall[alarm->band - 1])) {
+		alarm->band--;
+
+		if (alarm->event)
+			alarm->event(alarm->band, ALARM_DOWN);
+	}
+}
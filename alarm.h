@@ -0,0 +1,75 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file alarm.h
+ * \brief Altitude band alarms in the pressure domain.
+ *
+ * The altitude thresholds are turned into pressure thresholds once,
+ * by alarm_set() or alarm_qnh(), with pow(). Every sample is then
+ * checked against the two pressures around the current band: two
+ * int32 compares if nothing happens, no float.
+ *
+ * The band is the number of thresholds below the altitude, 0 is
+ * below the lowest one. Crossing a threshold calls the event
+ * callback with the threshold and the direction.
+ */
+
+#ifndef _ALARM_H_
+#define _ALARM_H_
+
+#include <stdint.h>
+
+/*! Max thresholds */
+#ifndef ALARM_MAX
+#define ALARM_MAX 8
+#endif
+
+/*! Band still unknown, before the first sample. */
+#define ALARM_UNKNOWN 0xff
+
+/*! Event directions */
+#define ALARM_DOWN 0
+#define ALARM_UP 1
+
+/*! Alarm set. */
+struct alarm_t {
+	/*! thresholds, m, ascending. */
+	int16_t altitude[ALARM_MAX];
+	/*! cross upward when p < rise[i]. */
+	int32_t rise[ALARM_MAX];
+	/*! cross downward when p > fall[i]. */
+	int32_t fall[ALARM_MAX];
+	/*! thresholds in use. */
+	uint8_t n;
+	/*! hysteresis, m, half on each side of the threshold. */
+	uint8_t hyst;
+	/*! current band. */
+	uint8_t band;
+	/*! pressure at the sea level, QNH in Pa. */
+	int32_t p0;
+	/*! event callback, can be NULL. */
+	void (*event)(const uint8_t threshold, const uint8_t dir);
+};
+
+void alarm_init(struct alarm_t *alarm,
+		void (*event)(const uint8_t threshold, const uint8_t dir));
+uint8_t alarm_set(struct alarm_t *alarm, const int16_t *altitude,
+		const uint8_t n, const uint8_t hyst);
+void alarm_qnh(struct alarm_t *alarm, const int32_t p0);
+void alarm_check(struct alarm_t *alarm, const int32_t p);
+
+#endif
@@ -0,0 +1,274 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench.c
+ * \brief Cycle count benchmarks, results printed on the uart.
+ *
+ * Build with make bench, each line is
+ * <name> <cycles per call>
+ * then the RAM of a sensor, ram_<name> <bytes>.
+ *
+ * With make bench CAL=header.h the specialized compensation too and
+ * math_t_p_ratio, its speedup: math_t_p / math_t_p_fixed x100.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <util/twi.h>
+#include "i2c_soft.h"
+#include "bmp180.h"
+#include "bmp180_set.h"
+#include "fusion.h"
+#include "timer.h"
+#include "uart.h"
+#include "fmt.h"
+
+/*! Calls per benchmark */
+#define BENCH_LOOPS 64
+
+/*! Software bus used by the benchmark, SCL on PD2 and SDA on PD3 */
+static struct i2c_bus_t soft_bus = {
+	&DDRD, &PORTD, &PIND, _BV(PD2), _BV(PD3)
+};
+
+static void print_result(const char *name, uint32_t cycles, char *string)
+{
+	uart_printstr(0, name);
+	uart_printstr(0, " ");
+	string = ultoa(cycles / BENCH_LOOPS, string, 10);
+	uart_printstr(0, string);
+	uart_printstr(0, "\n");
+}
+
+/*! A value not per call, bytes or a ratio. */
+static void print_value(const char *name, uint16_t value, char *string)
+{
+	uart_printstr(0, name);
+	uart_printstr(0, " ");
+	string = utoa(value, string, 10);
+	uart_printstr(0, string);
+	uart_printstr(0, "\n");
+}
+
+/*! Read the 2 byte ADC register, the same transaction used by
+ * the driver for every word.
+ */
+static uint32_t bench_twi(void)
+{
+	uint32_t start;
+	uint8_t i, reg, buf[2];
+
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		reg = BMP180_REG_ADC;
+		i2c_mtm(BMP180_ADDR, 1, &reg, FALSE);
+		i2c_mrm(BMP180_ADDR, 2, buf, TRUE);
+	}
+
+	return(timer_cycles() - start);
+}
+
+static uint32_t bench_soft(void)
+{
+	uint32_t start;
+	uint8_t i, reg, buf[2];
+
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		reg = BMP180_REG_ADC;
+		i2c_soft_mXm(&soft_bus, BMP180_ADDR, 1, &reg, FALSE);
+		i2c_soft_mXm(&soft_bus, BMP180_ADDR | TW_READ, 2, buf, TRUE);
+	}
+
+	return(timer_cycles() - start);
+}
+
+/*! Datasheet calibration example */
+static struct bmp180_cal_t cal = {
+	408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868
+};
+
+/*! Temperature and pressure compensation. */
+static uint32_t bench_math(void)
+{
+	uint32_t start;
+	volatile int32_t UT, UP, p;
+	int32_t b5;
+	uint8_t i;
+
+	UT = 27898;
+	UP = 23843;
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		b5 = bmp180_math_b5(&cal, UT);
+		p = bmp180_math_pressure(&cal, b5, UP, BMP180_RES_LOW);
+	}
+
+	(void)p;
+	return(timer_cycles() - start);
+}
+
+/*! Put and fuse FUSION_SIZE samples, one outlier. */
+static uint32_t bench_fusion(void)
+{
+	struct fusion_t fusion;
+	uint32_t start;
+	int32_t p;
+	uint8_t i, k;
+
+	fusion_init(&fusion, FUSION_SIZE);
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		for (k = 0; k < FUSION_SIZE; k++)
+			fusion_put(&fusion, k, i * 50 + k * 10, 101325 + k +
+					((k == 1) ? 500 : 0));
+
+		fusion_get(&fusion, i * 50 + 40, &p);
+	}
+
+	return(timer_cycles() - start);
+}
+
+#ifdef BMP180_FIXED_CAL
+#include BMP180_FIXED_CAL
+
+/*! Same as bench_math() with the constant coefficients. */
+static uint32_t bench_fixed(void)
+{
+	uint32_t start;
+	volatile int32_t UT, UP, p;
+	int32_t b5;
+	uint8_t i;
+
+	UT = 27898;
+	UP = 23843;
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		b5 = bmp180_fixed_b5(UT);
+		p = bmp180_fixed_pressure(b5, UP, BMP180_RES_LOW);
+	}
+
+	(void)p;
+	return(timer_cycles() - start);
+}
+#endif
+
+/*! The main.c sample line "p dp dA\n" with the libc functions,
+ * the line is built in the buffer instead of sent.
+ */
+static uint32_t bench_line_libc(char *line)
+{
+	uint32_t start;
+	volatile int32_t p, dp;
+	volatile float dA;
+	uint8_t i;
+	char *e;
+
+	p = 101325;
+	dp = -7;
+	dA = 59.01;
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		ultoa(p, line, 10);
+		e = line + strlen(line);
+		*e++ = ' ';
+		itoa(dp, e, 10);
+		e += strlen(e);
+		*e++ = ' ';
+		dtostrf(dA, 10, 2, e);
+		strcat(e, "\n");
+	}
+
+	return(timer_cycles() - start);
+}
+
+/*! The same line with fmt.h, dA in cm. */
+static uint32_t bench_line_fmt(char *line)
+{
+	uint32_t start;
+	volatile int32_t p, dp, dA;
+	uint8_t i;
+	char *e;
+
+	p = 101325;
+	dp = -7;
+	dA = 5901;
+	start = timer_cycles();
+
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		e = fmt_u32(line, p);
+		e = fmt_str(e, " ");
+		e = fmt_i32(e, dp);
+		e = fmt_str(e, " ");
+		e = fmt_fix(e, dA, 2, 10);
+		fmt_str(e, "\n");
+	}
+
+	return(timer_cycles() - start);
+}
+
+int main(void)
+{
+	char line[32];
+	char string[12];
+#ifdef BMP180_FIXED_CAL
+	uint32_t generic, fixed;
+#endif
+
+	uart_init(0);
+	timer_init();
+	i2c_init();
+	i2c_soft_init(&soft_bus);
+	sei();
+
+	uart_printstr(0, "BMP180 bench prg.\n");
+	_delay_ms(1000);
+
+	print_result("i2c_twi_rw", bench_twi(), string);
+	print_result("i2c_soft_rw", bench_soft(), string);
+#ifdef BMP180_FIXED_CAL
+	generic = bench_math();
+	print_result("math_t_p", generic, string);
+#else
+	print_result("math_t_p", bench_math(), string);
+#endif
+	print_result("fusion", bench_fusion(), string);
+	print_result("line_libc", bench_line_libc(line), string);
+	print_result("line_fmt", bench_line_fmt(line), string);
+#ifdef BMP180_FIXED_CAL
+	fixed = bench_fixed();
+	print_result("math_t_p_fixed", fixed, string);
+	print_value("math_t_p_ratio", generic * 100 / fixed, string);
+#endif
+	print_value("ram_bmp180_t", sizeof(struct bmp180_t), string);
+	print_value("ram_set_sensor", BMP180_SET_SENSOR_BYTES, string);
+	print_value("ram_set_shared", sizeof(struct bmp180_set_t) -
+			BMP180_SET_SIZE * BMP180_SET_SENSOR_BYTES, string);
+
+	while (1);
+
+	return(0);
+}
@@ -17,21 +17,137 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <avr/io.h>
 #include <util/delay.h>
+#include "i2c_soft.h"
 #include "bmp180.h"
+#include "trace.h"
+#include "lowpower.h"
+#include "i2c_rec.h"
+#include "cic.h"
+#ifdef BMP180_SCHED
+#include "i2c_sched.h"
+#endif
+
+/* calibration specialized build, see tools/bmp180_calgen.py */
+#ifdef BMP180_FIXED_CAL
+#include BMP180_FIXED_CAL
+
+/** CRC-8, poly 0x07.
+ *
+ * @param data the buffer.
+ * @param n the buffer size.
+ */
+static uint8_t crc8(const uint8_t *data, uint8_t n)
+{
+	uint8_t i, crc;
+
+	crc = 0;
+
+	while (n--) {
+		crc ^= *data++;
+
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+
+	return(crc);
+}
+#endif
+
+/** Transfer on the sensor's bus.
+ *
+ * @param rw READ or WRITE.
+ * @param lenght the number of byte.
+ * @param data the buffer.
+ * @param stop send the stop at the end.
+ */
+static uint8_t bus_tx(struct bmp180_t *bmp180, const uint8_t rw,
+		const uint16_t lenght, uint8_t *data, const uint8_t stop)
+{
+	uint8_t err;
+
+	I2C_REC_BEGIN();
+
+	if (bmp180->bus)
+		err = i2c_soft_mXm(bmp180->bus, BMP180_ADDR | rw,
+				lenght, data, stop);
+	else if (rw)
+		err = i2c_mrm(BMP180_ADDR, lenght, data, stop);
+	else
+		err = i2c_mtm(BMP180_ADDR, lenght, data, stop);
+
+	I2C_REC_END(BMP180_ADDR | rw, lenght, data, stop, err);
+	return(err);
+}
+
+#ifdef BMP180_SCHED
+/* the sensor on the scheduled TWI */
+static struct i2c_dev_t sched_dev = { BMP180_ADDR, 0 };
+
+/** A register transaction through i2c_sched.h, waited for.
+ *
+ * The ADC reads go first, the calibration in bulk chunks, the
+ * rest at normal priority.
+ *
+ * @param reg the first register address.
+ * @param lenght the number of byte.
+ * @param data the buffer.
+ * @param flags I2C_XFER_READ or 0.
+ */
+static uint8_t sched_tx(const uint8_t reg, const uint8_t lenght,
+		uint8_t *data, uint8_t flags)
+{
+	struct i2c_xfer_t xfer;
+
+	if (reg == BMP180_REG_ADC) {
+		xfer.prio = I2C_SCHED_PRIO_RT;
+	} else if (lenght > I2C_SCHED_CHUNK) {
+		xfer.prio = I2C_SCHED_PRIO_BULK;
+		flags |= I2C_XFER_BULK;
+	} else {
+		xfer.prio = I2C_SCHED_PRIO_NORMAL;
+	}
 
-/** Swap MSB<->LSB of an uint16.
+	xfer.dev = &sched_dev;
+	xfer.reg = reg;
+	xfer.data = data;
+	xfer.lenght = lenght;
+	xfer.flags = flags;
+	xfer.deadline = 0;
+	xfer.status = I2C_XFER_OK;
+	xfer.done = NULL;
+	i2c_sched_submit(&xfer);
+	return(i2c_sched_wait(&xfer));
+}
+#endif
+
+/** Read consecutive registers in a single transaction.
+ *
+ * With BMP180_SCHED the TWI ones are queued on i2c_sched.h.
  *
- * @param swapme ptr to the uint16.
+ * @param reg_addr the first register address.
+ * @param lenght the number of byte.
+ * @param data the buffer.
  */
-void swapit(uint16_t *swapme)
+static uint8_t read_regs(struct bmp180_t *bmp180, uint8_t reg_addr,
+		const uint8_t lenght, uint8_t *data)
 {
-	uint8_t lsb;
+	uint8_t err;
+
+#ifdef BMP180_SCHED
+	if (!bmp180->bus)
+		return(sched_tx(reg_addr, lenght, data, I2C_XFER_READ));
+#endif
+
+	// do not STOP the tx
+	err = bus_tx(bmp180, WRITE, 1, &reg_addr, FALSE);
 
-	lsb = (*swapme) & 0xff;
-	(*swapme) = (*swapme) >> 8;
-	(*swapme) |= (uint16_t)lsb << 8;
+	if (!err)
+		err = bus_tx(bmp180, READ, lenght, data, TRUE);
+
+	return(err);
 }
 
 /** Register Read (Byte).
@@ -39,31 +155,37 @@ void swapit(uint16_t *swapme)
  * @param reg_addr the register address.
  * @param byte the data to be read.
  */
-uint8_t register_rb(const uint8_t reg_addr, uint8_t *byte)
+uint8_t register_rb(struct bmp180_t *bmp180, uint8_t reg_addr,
+		uint8_t *byte)
 {
 	uint8_t error;
 
-	error = i2c_master_send_b(BMP180_ADDR, reg_addr, FALSE);
-
-	if (!error)
-		error = i2c_master_read_b(BMP180_ADDR, byte, TRUE);
-
+	TRACE_IN(TRACE_REGISTER_RB);
+	error = read_regs(bmp180, reg_addr, 1, byte);
+	TRACE_OUT(TRACE_REGISTER_RB);
 	return (error);
 }
 
 /** Register Read (word).
+ *
+ * The device send the MSB first.
  *
  * @param reg_addr the register address.
  * @param byte the data to be read.
  */
-uint8_t register_rw(const uint8_t reg_addr, uint16_t *word)
+uint8_t register_rw(struct bmp180_t *bmp180, uint8_t reg_addr,
+		uint16_t *word)
 {
 	uint8_t err;
+	uint8_t buf[2];
 
-	err = i2c_master_send_b(BMP180_ADDR, reg_addr, FALSE);
+	TRACE_IN(TRACE_REGISTER_RW);
+	err = read_regs(bmp180, reg_addr, 2, buf);
 
 	if (!err)
-		err = i2c_master_read_w(BMP180_ADDR, word);
+		*word = ((uint16_t)buf[0] << 8) | buf[1];
+
+	TRACE_OUT(TRACE_REGISTER_RW);
 
 	/*
 		err = i2c_master_read_w(MPU6050_ADDR, word, TRUE);
@@ -77,67 +199,45 @@ uint8_t register_rw(const uint8_t reg_addr, uint16_t *word)
  * @param reg_addr the register address.
  * @param byte the data to be written.
  */
-uint8_t register_wb(const uint8_t reg_addr, uint8_t byte)
+uint8_t register_wb(struct bmp180_t *bmp180, const uint8_t reg_addr,
+		uint8_t byte)
 {
-	uint8_t error;
+	uint8_t buf[2];
 
-	error = i2c_master_send_w(BMP180_ADDR, reg_addr, byte);
-	return (error);
+#ifdef BMP180_SCHED
+	if (!bmp180->bus)
+		return(sched_tx(reg_addr, 1, &byte, 0));
+#endif
+
+	buf[0] = reg_addr;
+	buf[1] = byte;
+	return(bus_tx(bmp180, WRITE, 2, buf, TRUE));
 }
 
 /** Read the calibration data.
  *
+ * The whole block in a single read.
  */
 uint8_t dump_calibration_data(struct bmp180_t *bmp180)
 {
 	uint8_t err;
-	uint16_t word;
+	uint8_t raw[BMP180_CAL_SIZE];
 
-	err = register_rw(BMP180_REG_AC1, &word);
-	bmp180->AC1 = (int16_t) word;
+	err = read_regs(bmp180, BMP180_REG_AC1, BMP180_CAL_SIZE, raw);
 
 	if (!err) {
-		err = register_rw(BMP180_REG_AC2, &word);
-		bmp180->AC2 = (int16_t) word;
-	}
-
-	if (!err) {
-		err = register_rw(BMP180_REG_AC3, &word);
-		bmp180->AC3 = (int16_t) word;
-	}
-
-	if (!err)
-		err = register_rw(BMP180_REG_AC4, &bmp180->AC4);
-
-	if (!err)
-		err = register_rw(BMP180_REG_AC5, &bmp180->AC5);
-
-	if (!err)
-		err = register_rw(BMP180_REG_AC6, &bmp180->AC6);
-
-	if (!err) {
-		err = register_rw(BMP180_REG_B1, &word);
-		bmp180->B1 = (int16_t) word;
-	}
-
-	if (!err) {
-		err = register_rw(BMP180_REG_B2, &word);
-		bmp180->B2 = (int16_t) word;
-	}
-
-	if (!err) {
-		err = register_rw(BMP180_REG_MB, &word);
-		bmp180->MB = (int16_t) word;
-	}
-
-	if (!err) {
-		err = register_rw(BMP180_REG_MC, &word);
-		bmp180->MC = (int16_t) word;
-	}
-
-	if (!err) {
-		err = register_rw(BMP180_REG_MD, &word);
-		bmp180->MD = (int16_t) word;
+		bmp180_math_cal(&bmp180->cal, raw);
+
+#ifdef BMP180_FIXED_CAL
+		/* this is the sensor the build is specialized for, the CRC
+		 * first, then all the coefficients: 1 in 256 blocks of
+		 * other sensors have the same CRC
+		 */
+		if ((crc8(raw, BMP180_CAL_SIZE) == BMP180_FIXED_CRC) &&
+				!memcmp(&bmp180->cal, &bmp180_fixed_cal,
+					sizeof(struct bmp180_cal_t)))
+			bmp180->flags |= BMP180_FLAG_FIXED;
+#endif
 	}
 
 	return(err);
@@ -145,52 +245,44 @@ uint8_t dump_calibration_data(struct bmp180_t *bmp180)
 
 void math_temperature(struct bmp180_t *bmp180)
 {
-	int32_t x1, x2;
+	TRACE_IN(TRACE_MATH_TEMPERATURE);
+#ifdef BMP180_FIXED_CAL
+	if (bmp180->flags & BMP180_FLAG_FIXED)
+		bmp180->B5 = bmp180_fixed_b5(bmp180->UT);
+	else
+#endif
+		bmp180->B5 = bmp180_math_b5(&bmp180->cal, bmp180->UT);
 
-	x1 = (bmp180->UT - bmp180->AC6) * bmp180->AC5 >> 15;
-	x2 = ((int32_t)bmp180->MC << 11) / (x1 + bmp180->MD);
-	bmp180->B5 = x1 + x2;
-	bmp180->T = (bmp180->B5 + 8) >> 4;
+	bmp180->T = bmp180_math_temperature(bmp180->B5);
+	TRACE_OUT(TRACE_MATH_TEMPERATURE);
 }
 
 void math_pressure(struct bmp180_t *bmp180)
 {
-	uint32_t b4, b7;
-	int32_t x1, x2, x3, b3, b6;
-
-	b6 = bmp180->B5 - 4000;
-	x1 = (bmp180->B2 * (b6 * b6 >> 12)) >> 11;
-	x2 = bmp180->AC2 * b6 >> 11;
-	x3 = x1 + x2;
-
-	b3 = ((((int32_t)bmp180->AC1 * 4 + x3) << bmp180->oss) + 2) >> 2;
-	x1 = bmp180->AC3 * b6 >> 13;
-	x2 = (bmp180->B1 * (b6 * b6 >> 12)) >> 16;
-	x3 = (x1 + x2 + 2) >> 2;
-	b4 = (bmp180->AC4 * (uint32_t)(x3 + 32768)) >> 15;
-	b7 = (uint32_t)(bmp180->UP - b3) * (50000 >> bmp180->oss);
-
-	if (b7 < 0x80000000)
-		bmp180->p = (b7 << 1) / b4;
+	TRACE_IN(TRACE_MATH_PRESSURE);
+#ifdef BMP180_FIXED_CAL
+	if (bmp180->flags & BMP180_FLAG_FIXED)
+		bmp180->p = bmp180_fixed_pressure(bmp180->B5, bmp180->UP,
+				bmp180->oss);
 	else
-		bmp180->p = (b7 / b4) << 1;
-
-	x1 = (bmp180->p >> 8) * (bmp180->p >> 8);
-	x1 = (x1 * 3038) >> 16;
-	x2 = (-7357 * bmp180->p) >> 16;
-	bmp180->p += ((x1 + x2 + 3791) >> 4);
+#endif
+		bmp180->p = bmp180_math_pressure(&bmp180->cal, bmp180->B5,
+				bmp180->UP, bmp180->oss);
+	TRACE_OUT(TRACE_MATH_PRESSURE);
 }
 
 void bmp180_altitude(struct bmp180_t *bmp180)
 {
-	bmp180->altitude = 44330.0F * (1.0F - ((float)pow(((float)bmp180->p/(float)bmp180->p0), 0.190223F)));
+	TRACE_IN(TRACE_MATH_ALTITUDE);
+	bmp180->altitude = bmp180_math_altitude(bmp180->p, bmp180->p0);
+	TRACE_OUT(TRACE_MATH_ALTITUDE);
 }
 
-uint8_t bmp180_resolution(const uint8_t mode)
+uint8_t bmp180_resolution(struct bmp180_t *bmp180, const uint8_t mode)
 {
 	uint8_t err, byte;
 
-	err = register_rb(BMP180_REG_CTRL, &byte);
+	err = register_rb(bmp180, BMP180_REG_CTRL, &byte);
 
 	if (!err) {
 		byte &= 0x3f; /* 0b00111111 */
@@ -200,82 +292,249 @@ uint8_t bmp180_resolution(const uint8_t mode)
 	return(err);
 }
 
-/** The temperature read and converter.
+/** Wait for the end of a pressure conversion.
  *
- * See datasheet for details.
+ * @param oss the oversampling setting in use.
  */
-uint8_t bmp180_read_temperature(struct bmp180_t *bmp180)
+static void pressure_delay(const uint8_t oss)
+{
+	TRACE_IN(TRACE_DELAY);
+
+	switch (oss) {
+		case BMP180_RES_LOW:
+			BMP180_WAIT_MS(5);
+			break;
+		case BMP180_RES_STD:
+			BMP180_WAIT_MS(8);
+			break;
+		case BMP180_RES_HIGH:
+			BMP180_WAIT_MS(14);
+			break;
+		default:
+			BMP180_WAIT_MS(26);
+	}
+
+	TRACE_OUT(TRACE_DELAY);
+}
+
+/** Read the uncompensated temperature.
+ *
+ * Only UT is updated, the compensated T is marked as stale.
+ */
+uint8_t bmp180_read_ut(struct bmp180_t *bmp180)
 {
 	uint8_t err;
 	uint16_t word;
 
 	/* Read UT */
-	err = register_wb(BMP180_REG_CTRL, 0x2e);
+	err = register_wb(bmp180, BMP180_REG_CTRL, 0x2e);
 
 	if (!err) {
-		_delay_ms(5);
-		err = register_rw(BMP180_REG_ADC, &word);
-		bmp180->UT = (long)word;
+		TRACE_IN(TRACE_DELAY);
+		BMP180_WAIT_MS(5);
+		TRACE_OUT(TRACE_DELAY);
+		err = register_rw(bmp180, BMP180_REG_ADC, &word);
+	}
 
-		if (!err)
-			math_temperature(bmp180);
+	if (!err) {
+		bmp180->UT = (long)word;
+		bmp180->flags &= ~(BMP180_FLAG_T | BMP180_FLAG_P);
 	}
 
 	return (err);
 }
 
-uint8_t bmp180_read_pressure(struct bmp180_t *bmp180)
+/** Read the uncompensated pressure.
+ *
+ * Only UP is updated, the compensated p is marked as stale.
+ */
+uint8_t bmp180_read_up(struct bmp180_t *bmp180)
 {
-	uint8_t err, byte;
-	uint16_t word;
+	uint8_t err;
+	uint8_t buf[3];
 
 	/* Read UP */
-	err = register_wb(BMP180_REG_CTRL, (0x34 + (bmp180->oss << 6)));
+	err = register_wb(bmp180, BMP180_REG_CTRL,
+			(0x34 + (bmp180->oss << 6)));
 
 	if (!err) {
-		switch (bmp180->oss) {
-			case BMP180_RES_LOW:
-				_delay_ms(5);
-				break;
-			case BMP180_RES_STD:
-				_delay_ms(8);
-				break;
-			case BMP180_RES_HIGH:
-				_delay_ms(14);
-				break;
-			default:
-				_delay_ms(26);
-		}
-
-		err = register_rw(BMP180_REG_ADC, &word);
-		bmp180->UP = (int32_t)word << 8;
+		pressure_delay(bmp180->oss);
+		TRACE_IN(TRACE_REGISTER_RW);
+		/* MSB, LSB and XLSB in a single read */
+		err = read_regs(bmp180, BMP180_REG_ADC, 3, buf);
+		TRACE_OUT(TRACE_REGISTER_RW);
 
 		if (!err) {
-			err = register_rb(BMP180_REG_ADCXLSB, &byte);
-			bmp180->UP |= byte;
+			bmp180->UP = ((int32_t)buf[0] << 16) |
+				((int32_t)buf[1] << 8) | buf[2];
 			bmp180->UP >>= (8 - bmp180->oss);
+			bmp180->flags &= ~BMP180_FLAG_P;
 		}
+	}
 
-		if (!err)
-			math_pressure(bmp180);
+	return(err);
+}
+
+/** Compensate the last raw values.
+ *
+ * Only the stale values are computed, calling it more than once
+ * after a read costs nothing.
+ */
+void bmp180_compensate(struct bmp180_t *bmp180)
+{
+	if (!(bmp180->flags & BMP180_FLAG_T)) {
+		math_temperature(bmp180);
+		bmp180->flags |= BMP180_FLAG_T;
 	}
 
+	if (!(bmp180->flags & BMP180_FLAG_P)) {
+		math_pressure(bmp180);
+		bmp180->flags |= BMP180_FLAG_P;
+	}
+}
+
+/** The temperature read and converter.
+ *
+ * See datasheet for details.
+ */
+uint8_t bmp180_read_temperature(struct bmp180_t *bmp180)
+{
+	uint8_t err;
+
+	err = bmp180_read_ut(bmp180);
+
+	if (!err) {
+		math_temperature(bmp180);
+		bmp180->flags |= BMP180_FLAG_T;
+	}
+
+	return (err);
+}
+
+uint8_t bmp180_read_pressure(struct bmp180_t *bmp180)
+{
+	uint8_t err;
+
+	err = bmp180_read_up(bmp180);
+
+	if (!err)
+		bmp180_compensate(bmp180);
+
 	return(err);
 }
 
-/** Init
+/** Capture a batch of raw samples.
+ *
+ * The temperature is read once, then n pressure conversions are
+ * done back to back at the max rate allowed by the oss in use,
+ * no compensation is done.
+ *
+ * @param raw the caller's buffer, at least n elements.
+ * @param n the number of samples to capture.
  */
-uint8_t bmp180_init(struct bmp180_t *bmp180)
+uint8_t bmp180_capture(struct bmp180_t *bmp180, struct bmp180_raw_t *raw,
+		const uint8_t n)
+{
+	uint8_t i, err;
+
+	err = bmp180_read_ut(bmp180);
+
+	for (i = 0; (i < n) && !err; i++) {
+		err = bmp180_read_up(bmp180);
+		raw[i].UT = (uint16_t)bmp180->UT;
+		raw[i].UP = bmp180->UP;
+	}
+
+	return(err);
+}
+
+/** Compensate the average of a batch of raw samples.
+ *
+ * For a given UT the pressure is a linear function of UP
+ * plus a second order correction which is below 1 Pa over the
+ * noise range of the sensor, the compensation of the mean UP
+ * is then the mean of the compensated p. The math is done only
+ * once for the whole batch.
+ *
+ * @param raw the captured samples.
+ * @param n the number of samples, 1 to 255.
+ */
+void bmp180_compensate_avg(struct bmp180_t *bmp180,
+		const struct bmp180_raw_t *raw, const uint8_t n)
+{
+	uint8_t i;
+	int32_t ut, up;
+
+	ut = 0;
+	up = 0;
+
+	for (i = 0; i < n; i++) {
+		ut += raw[i].UT;
+		up += raw[i].UP;
+	}
+
+	bmp180->UT = (ut + (n >> 1)) / n;
+	bmp180->UP = (up + (n >> 1)) / n;
+	bmp180->flags &= ~(BMP180_FLAG_T | BMP180_FLAG_P);
+	bmp180_compensate(bmp180);
+}
+
+/** Capture at oss 0 and decimate, one output.
+ *
+ * UT is read once per output, UP at oss 0 until the filter has an
+ * output. The result is compensated at the oss 3 scale of the
+ * filter, so bmp180->oss is CIC_OSS on return.
+ *
+ * @param cic the filter, see cic_init().
+ */
+uint8_t bmp180_capture_cic(struct bmp180_t *bmp180, struct cic_t *cic)
 {
 	uint8_t err;
 
+	bmp180->oss = BMP180_RES_LOW;
+	err = bmp180_read_ut(bmp180);
+
+	while (!err) {
+		err = bmp180_read_up(bmp180);
+
+		if (!err && cic_put(cic, bmp180->UP))
+			break;
+	}
+
+	if (!err) {
+		bmp180->UP = cic->out;
+		bmp180->oss = CIC_OSS;
+		bmp180_compensate(bmp180);
+	}
+
+	return(err);
+}
+
+/** Init on a given bus.
+ *
+ * @param bus the software i2c bus, NULL = TWI.
+ */
+uint8_t bmp180_init_bus(struct bmp180_t *bmp180, struct i2c_bus_t *bus)
+{
+	uint8_t err;
+
+	bmp180->bus = bus;
 	bmp180->flags = 0;
 	bmp180->p0 = BMP180_SEALEVEL;
-	i2c_init();
-	err = register_rb(BMP180_REG_ID, &bmp180->id);
+
+	if (bus)
+		i2c_soft_init(bus);
+	else
+#ifdef BMP180_SCHED
+		i2c_sched_init();
+#else
+		i2c_init();
+#endif
+
+	err = register_rb(bmp180, BMP180_REG_ID, &bmp180->id);
 
 	if (!err && (bmp180->id == 0x55)) {
-		err = register_rb(BMP180_REG_CTRL, &bmp180->oss);
+		err = register_rb(bmp180, BMP180_REG_CTRL, &bmp180->oss);
 		bmp180->oss >>= 6;
 
 		if (!err)
@@ -285,6 +544,13 @@ uint8_t bmp180_init(struct bmp180_t *bmp180)
 	return (err);
 }
 
+/** Init on the TWI.
+ */
+uint8_t bmp180_init(struct bmp180_t *bmp180)
+{
+	return(bmp180_init_bus(bmp180, NULL));
+}
+
 uint8_t bmp180_read_all(struct bmp180_t *bmp180)
 {
 	uint8_t err;
@@ -15,271 +15,510 @@
  * If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*! \file bmp180.cpp
+ * \brief The family driver, see bmpx.h.
+ */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <avr/io.h>
 #include <util/delay.h>
 #include "bmp180.h"
-
-/** Swap MSB<->LSB of an uint16.
- *
- * @param swapme ptr to the uint16.
- */
-void swapit(uint16_t *swapme)
-{
-	uint8_t lsb;
-
-	lsb = (*swapme) & 0xff;
-	(*swapme) = (*swapme) >> 8;
-	(*swapme) |= (uint16_t)lsb << 8;
-}
+#include "trace.h"
+#include "lowpower.h"
 
 /** Register Read (Byte).
  *
  * @param reg_addr the register address.
  * @param byte the data to be read.
  */
-uint8_t BMP180::register_rb(uint8_t reg_addr, uint8_t *byte)
+template <class Chip>
+uint8_t BMPx<Chip>::register_rb(uint8_t reg_addr, uint8_t *byte)
 {
 	uint8_t error;
 
+	TRACE_IN(TRACE_REGISTER_RB);
 	// do not STOP the tx
 	error = i2c.tx(WRITE, 1, &reg_addr, false);
 
 	if (!error)
 		error = i2c.tx(READ, 1, byte);
 
+	TRACE_OUT(TRACE_REGISTER_RB);
 	return (error);
 }
 
-/** Register Read (word).
+/** Read consecutive registers in a single transaction.
  *
- * @param reg_addr the register address.
- * @param byte the data to be read.
+ * The device sends the first register first.
+ *
+ * @param reg_addr the first register address.
+ * @param len the number of registers.
+ * @param buf the data to be read.
  */
-uint8_t BMP180::register_rw(uint8_t reg_addr, uint16_t *word)
+template <class Chip>
+uint8_t BMPx<Chip>::read_regs(uint8_t reg_addr, const uint8_t len,
+		uint8_t *buf)
 {
 	uint8_t err;
 
+	TRACE_IN(TRACE_REGISTER_RW);
 	// do not STOP the tx
 	err = i2c.tx(WRITE, 1, &reg_addr, false);
 
 	if (!err)
-		err = i2c.tx(READ, 2, (uint8_t*) word);
+		err = i2c.tx(READ, len, buf);
 
+	TRACE_OUT(TRACE_REGISTER_RW);
 	return (err);
 }
 
-/** Read the calibration data.
+/** Register write (Byte).
+ *
+ * @param reg_addr the register address.
+ * @param byte the data to be written.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::register_wb(uint8_t reg_addr, uint8_t byte)
+{
+	uint8_t buf[2];
+
+	buf[0] = reg_addr;
+	buf[1] = byte;
+	return(i2c.tx(WRITE, 2, buf));
+}
+
+/** Wait for the end of a conversion.
+ *
+ * @param ms the conversion time.
+ */
+template <class Chip>
+void BMPx<Chip>::wait(const uint8_t ms)
+{
+	TRACE_IN(TRACE_DELAY);
+
+#ifdef BMP180_SLEEP
+	BMP180_WAIT_MS(ms);
+#else
+	// _delay_ms() wants a constant
+	for (uint8_t i = 0; i < ms; i++)
+		BMP180_WAIT_MS(1);
+#endif
+
+	TRACE_OUT(TRACE_DELAY);
+}
+
+/** Constructor
  *
- * \note: can this be a single data read from the
- * device's memory?
+ * The calibration is read only if the id is one of the chip's.
+ *
+ * @param addr the device address.
+ * @param bus the software i2c bus, default the TWI.
  */
-uint8_t BMP180::dump_calibration_data(void)
+template <class Chip>
+BMPx<Chip>::BMPx(uint8_t addr, struct i2c_bus_t *bus) :
+	i2c{addr, bus}
 {
 	uint8_t err;
-	uint16_t word;
+	uint8_t raw[Chip::cal_map::size()];
 
-	err = register_rw(BMP180_REG_AC1, &word);
-	AC1 = (int16_t) word;
+	flags = 0;
+	p0 = BMP180_SEALEVEL;
 
-	if (!err) {
-		err = register_rw(BMP180_REG_AC2, &word);
-		AC2 = (int16_t) word;
-	}
+	// Read the device's id
+	err = register_rb(BMP180_REG_ID, &id);
 
-	if (!err) {
-		err = register_rw(BMP180_REG_AC3, &word);
-		AC3 = (int16_t) word;
+	if (!err && Chip::match(id)) {
+		err = register_rb(Chip::ctrl_reg, &oss);
+		oss = Chip::oss_of(oss);
+		up_oss = oss;
+
+		// The whole calibration block in a single read.
+		if (!err)
+			err = Chip::cal_map::read(*this, raw);
+
+		if (!err)
+			Chip::decode_cal(&cal, raw);
 	}
+}
+
+/** The chip answered with its id. */
+template <class Chip>
+bool BMPx<Chip>::present() const
+{
+	return(Chip::match(id));
+}
+
+template <class Chip>
+void BMPx<Chip>::math_temperature()
+{
+	TRACE_IN(TRACE_MATH_TEMPERATURE);
+	fine = Chip::fine(cal, UT);
+	T = Chip::temperature(fine);
+	TRACE_OUT(TRACE_MATH_TEMPERATURE);
+}
+
+template <class Chip>
+void BMPx<Chip>::math_pressure()
+{
+	TRACE_IN(TRACE_MATH_PRESSURE);
+	p = Chip::pressure(cal, fine, UP, up_oss);
+	TRACE_OUT(TRACE_MATH_PRESSURE);
+}
+
+/** Start the continuous conversions, BMP280 normal mode.
+ *
+ * read_all() is then the read of the last conversion only, the
+ * oss is the one in use at the call. Any start_ or forced() goes
+ * back to a conversion per read.
+ *
+ * @param standby the t_sb code between the conversions.
+ * @return 0 - OK, 1 - the chip has no normal mode, or the bus error.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::normal(const uint8_t standby)
+{
+	uint8_t err;
+
+	if (!Chip::normal)
+		return(1);
+
+	// the config is written only in sleep mode
+	err = register_wb(Chip::ctrl_reg, 0);
 
 	if (!err)
-		err = register_rw(BMP180_REG_AC4, &AC4);
+		err = register_wb(BMP280_REG_CONFIG,
+				Chip::normal_config(standby));
 
 	if (!err)
-		err = register_rw(BMP180_REG_AC5, &AC5);
+		err = register_wb(Chip::ctrl_reg, Chip::normal_ctrl(oss));
 
 	if (!err)
-		err = register_rw(BMP180_REG_AC6, &AC6);
+		flags |= BMPX_FLAG_NORMAL;
 
-	if (!err) {
-		err = register_rw(BMP180_REG_B1, &word);
-		B1 = (int16_t) word;
-	}
+	return(err);
+}
 
-	if (!err) {
-		err = register_rw(BMP180_REG_B2, &word);
-		B2 = (int16_t) word;
-	}
+/** Stop the normal mode, a conversion per read again. */
+template <class Chip>
+uint8_t BMPx<Chip>::forced()
+{
+	flags &= ~BMPX_FLAG_NORMAL;
+	return(register_wb(Chip::ctrl_reg, 0));
+}
 
-	if (!err) {
-		err = register_rw(BMP180_REG_MB, &word);
-		MB = (int16_t) word;
-	}
+/** Free a bus held low, see I2C::recover(). */
+template <class Chip>
+uint8_t BMPx<Chip>::recover()
+{
+	return(i2c.recover());
+}
 
-	if (!err) {
-		err = register_rw(BMP180_REG_MC, &word);
-		MC = (int16_t) word;
-	}
+/** Set the oversampling.
+ *
+ * The oss is part of the conversion command, there is nothing to
+ * write to the device until the next conversion. UP keeps the old
+ * oss, up_oss, p is compensated with it until the next UP.
+ *
+ * @param mode BMP180_RES_LOW .. the chip's max.
+ * @return 0 - OK, 1 - invalid mode.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::resolution(const uint8_t mode)
+{
+	if (mode > Chip::oss_max)
+		return(1);
 
-	if (!err) {
-		err = register_rw(BMP180_REG_MD, &word);
-		MD = (int16_t) word;
-	}
+	oss = mode;
+	return(0);
+}
 
-	return(err);
+/** Conversion time.
+ *
+ * @param pressure true the pressure, false the temperature.
+ * @return the ms to wait between start and fetch.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::conversion_ms(const bool pressure) const
+{
+	return(Chip::conversion_ms(pressure, oss));
 }
 
-/** Constructor
+/** Start a temperature conversion.
+ *
+ * Wait conversion_ms(false) before the fetch_temperature().
  */
-BMP180::BMP180(uint8_t addr) : address{addr}
+template <class Chip>
+uint8_t BMPx<Chip>::start_temperature()
 {
-	uint8_t err;
+	flags &= ~BMPX_FLAG_NORMAL;
+	return(register_wb(Chip::ctrl_reg, Chip::start_t(oss)));
+}
 
-	// Read the device's id
-	err = register_rb(BMP180_REG_ID, &id);
+/** Set both raw values of a conversion at the current oss, the
+ * compensated ones are marked as stale.
+ */
+template <class Chip>
+void BMPx<Chip>::set_raw(const int32_t ut, const int32_t up)
+{
+	UT = ut;
+	UP = up;
+	up_oss = oss;
+	flags &= ~(BMP180_FLAG_T | BMP180_FLAG_P);
+}
+
+/** Read the uncompensated temperature of a finished conversion.
+ *
+ * Only UT is updated, the compensated T is marked as stale.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::fetch_ut()
+{
+	uint8_t err;
+	uint8_t buf[Chip::t_map::size()];
 
-	if (!err && (id == 0x55)) {
-		err = register_rb(BMP180_REG_CTRL, &oss);
-		oss >>= 6;
+	err = Chip::t_map::read(*this, buf);
 
-		if (!err)
-			err = dump_calibration_data();
+	if (!err) {
+		UT = Chip::ut(buf);
+		flags &= ~(BMP180_FLAG_T | BMP180_FLAG_P);
 	}
+
+	return(err);
 }
 
-void BMP180::math_temperature()
+/** Start a pressure conversion.
+ *
+ * Wait conversion_ms(true) before the fetch_pressure().
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::start_pressure()
 {
-	int32_t x1, x2;
-
-	x1 = (UT - AC6) * AC5 >> 15;
-	x2 = ((int32_t)MC << 11) / (x1 + MD);
-	B5 = x1 + x2;
-	T = (B5 + 8) >> 4;
+	flags &= ~BMPX_FLAG_NORMAL;
+	return(register_wb(Chip::ctrl_reg, Chip::start_p(oss)));
 }
 
-void BMP180::math_pressure()
+/** Read the uncompensated pressure of a finished conversion.
+ *
+ * Only UP is updated, the compensated p is marked as stale.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::fetch_up()
 {
-	uint32_t b4, b7;
-	int32_t x1, x2, x3, b3, b6;
-
-	b6 = B5 - 4000;
-	x1 = (B2 * (b6 * b6 >> 12)) >> 11;
-	x2 = AC2 * b6 >> 11;
-	x3 = x1 + x2;
-
-	b3 = ((((int32_t)AC1 * 4 + x3) << oss) + 2) >> 2;
-	x1 = AC3 * b6 >> 13;
-	x2 = (B1 * (b6 * b6 >> 12)) >> 16;
-	x3 = (x1 + x2 + 2) >> 2;
-	b4 = (AC4 * (uint32_t)(x3 + 32768)) >> 15;
-	b7 = (uint32_t)(UP - b3) * (50000 >> oss);
-
-	if (b7 < 0x80000000)
-		p = (b7 << 1) / b4;
-	else
-		p = (b7 / b4) << 1;
-
-	x1 = (p >> 8) * (p >> 8);
-	x1 = (x1 * 3038) >> 16;
-	x2 = (-7357 * p) >> 16;
-	p += ((x1 + x2 + 3791) >> 4);
+	uint8_t err;
+	uint8_t buf[Chip::p_map::size()];
+
+	err = Chip::p_map::read(*this, buf);
+
+	if (!err) {
+		UP = Chip::up(buf, oss);
+		up_oss = oss;
+		flags &= ~BMP180_FLAG_P;
+	}
+
+	return(err);
 }
 
-void BMP180::math_altitude()
+/** Read the uncompensated temperature.
+ *
+ * Only UT is updated, the compensated T is marked as stale.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::read_ut()
 {
-	altitude = 44330.0F * (1.0F - ((float)pow(((float)p/BMP180_SEALEVEL), 0.190223F)));
+	uint8_t err;
+
+	err = start_temperature();
+
+	if (!err) {
+		wait(conversion_ms(false));
+		err = fetch_ut();
+	}
+
+	return (err);
 }
 
-uint8_t BMP180::resolution(const uint8_t mode)
+/** Read the uncompensated pressure.
+ *
+ * Only UP is updated, the compensated p is marked as stale.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::read_up()
 {
-	uint8_t err, byte;
+	uint8_t err;
 
-	err = register_rb(BMP180_REG_CTRL, &byte);
+	err = start_pressure();
 
 	if (!err) {
-		byte &= 0x3f; /* 0b00111111 */
-		byte |= (mode << 6);
+		wait(conversion_ms(true));
+		err = fetch_up();
 	}
 
 	return(err);
 }
 
+/** Compensate the last raw values.
+ *
+ * Only the stale values are computed.
+ */
+template <class Chip>
+void BMPx<Chip>::compensate()
+{
+	if (!(flags & BMP180_FLAG_T)) {
+		math_temperature();
+		flags |= BMP180_FLAG_T;
+	}
+
+	if (!(flags & BMP180_FLAG_P)) {
+		math_pressure();
+		flags |= BMP180_FLAG_P;
+	}
+}
+
 /** The temperature read and converter.
  *
  * See datasheet for details.
  */
-uint8_t BMP180::read_temperature()
+template <class Chip>
+uint8_t BMPx<Chip>::read_temperature()
 {
 	uint8_t err;
-	uint16_t word;
 
-	/* Read UT */
-	// BMP180_REG_CTRL = 0x2e
-	word = (uint16_t)(BMP180_REG_CTRL << 8) | 0x2e;
-	err = i2c.tx(WRITE, 2, (uint8_t *) &word);
+	err = read_ut();
 
 	if (!err) {
-		_delay_ms(5);
-		err = register_rw(BMP180_REG_ADC, &word);
-		UT = (long)word;
-
-		if (!err)
-			math_temperature();
+		math_temperature();
+		flags |= BMP180_FLAG_T;
 	}
 
 	return (err);
 }
 
-uint8_t BMP180::read_pressure()
+/** The temperature of a finished conversion, see start_temperature(). */
+template <class Chip>
+uint8_t BMPx<Chip>::fetch_temperature()
 {
-	uint8_t err, byte;
-	uint16_t word;
+	uint8_t err;
 
-	/* Read UP */
-	// BMP180_REG_CTRL = 0x34 + (oss << 6)
-	word = (uint16_t)(BMP180_REG_CTRL << 8) | (0x34 + (oss << 6));
-	err = i2c.tx(WRITE, 2, (uint8_t *) &word);
+	err = fetch_ut();
 
 	if (!err) {
-		switch (oss) {
-			case BMP180_RES_LOW:
-				_delay_ms(5);
-				break;
-			case BMP180_RES_STD:
-				_delay_ms(8);
-				break;
-			case BMP180_RES_HIGH:
-				_delay_ms(14);
-				break;
-			default:
-				_delay_ms(26);
-		}
-
-		err = register_rw(BMP180_REG_ADC, &word);
-		UP = (int32_t)word << 8;
-
-		if (!err) {
-			err = register_rb(BMP180_REG_ADCXLSB, &byte);
-			UP |= byte;
-			UP >>= (8 - oss);
-		}
-
-		if (!err)
-			math_pressure();
+		math_temperature();
+		flags |= BMP180_FLAG_T;
 	}
 
 	return(err);
 }
 
-uint8_t BMP180::read_all()
+/** The pressure of a finished conversion, see start_pressure(). */
+template <class Chip>
+uint8_t BMPx<Chip>::fetch_pressure()
 {
 	uint8_t err;
 
-	err = read_temperature();
+	err = fetch_up();
 
 	if (!err)
-		err = read_pressure();
+		compensate();
 
 	return(err);
 }
+
+template <class Chip>
+uint8_t BMPx<Chip>::read_pressure()
+{
+	uint8_t err;
+
+	err = read_up();
+
+	if (!err)
+		compensate();
+
+	return(err);
+}
+
+/** Temperature and pressure, the chip's fastest sequence. */
+template <class Chip>
+uint8_t BMPx<Chip>::read_all()
+{
+	uint8_t err;
+
+	err = Chip::read_all(*this);
+
+	if (!err)
+		compensate();
+
+	return(err);
+}
+
+/** Capture a batch of raw samples.
+ *
+ * The temperature is read once, then n pressure conversions are
+ * done back to back, no compensation is done.
+ *
+ * @param raw the caller's buffer, at least n elements.
+ * @param n the number of samples to capture.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::capture(raw_t *raw, const uint8_t n)
+{
+	uint8_t err;
+
+	err = read_ut();
+
+	for (uint8_t i = 0; (i < n) && !err; i++) {
+		err = read_up();
+		raw[i].UT = UT;
+		raw[i].UP = UP;
+	}
+
+	return(err);
+}
+
+/** Compensate the average of a batch of raw samples.
+ *
+ * See bmp180_compensate_avg() for the validity of averaging UP.
+ * The samples are of the current oss, see capture().
+ */
+template <class Chip>
+void BMPx<Chip>::compensate(const raw_t *raw, const uint8_t n)
+{
+	int32_t ut, up;
+
+	ut = 0;
+	up = 0;
+
+	for (uint8_t i = 0; i < n; i++) {
+		ut += raw[i].UT;
+		up += raw[i].UP;
+	}
+
+	UT = (ut + (n >> 1)) / n;
+	UP = (up + (n >> 1)) / n;
+	up_oss = oss;
+	flags &= ~(BMP180_FLAG_T | BMP180_FLAG_P);
+	compensate();
+}
+
+/** The chip id register, the same for the whole family.
+ *
+ * @param addr the device address.
+ * @param bus the software i2c bus, default the TWI.
+ * @return the id, 0 on bus error.
+ */
+uint8_t bmpx_id(uint8_t addr, struct i2c_bus_t *bus)
+{
+	I2C i2c(addr, bus);
+	uint8_t reg, id;
+
+	reg = BMP180_REG_ID;
+
+	if (i2c.tx(WRITE, 1, &reg, false) || i2c.tx(READ, 1, &id))
+		return(0);
+
+	return(id);
+}
+
+template class BMPx<BMP085Chip>;
+template class BMPx<BMP180Chip>;
+template class BMPx<BMP280Chip>;
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include "i2c.h"
+#include "bmp180_math.h"
 
 #define BMP180_REG_AC1 0xaa
 #define BMP180_REG_AC2 0xac
@@ -47,76 +48,54 @@
 #define BMP180_RES_HIGH 2
 #define BMP180_RES_ULTRAHIGH 3
 
+#define BMP180_SEALEVEL 101325L // Pressure at sealevel
+
+/** The address of the device.
+ * Typical it is 0x55
+ */
+#define BMP180_ADDR 0xee
+
+/* flags, the compensated value is up to date with the raw one */
+#define BMP180_FLAG_T 1
+#define BMP180_FLAG_P 2
+/* flags, the calibration matches BMP180_FIXED_CAL */
+#define BMP180_FLAG_FIXED 4
+
+/*! Raw, uncompensated sample.
+ *
+ * Filled by the capture functions, the compensation is done later
+ * only if and when the value is needed.
+ */
+struct bmp180_raw_t {
+	uint16_t UT;
+	int32_t UP;
+};
+
+/*! Compensated and timestamped sample.
+ *
+ * T in 0.1 C, p in Pa.
+ */
+struct bmp180_sample_t {
+	uint32_t time;
+	int32_t p;
+	int16_t T;
+};
+
 // C++ compiler
 #ifdef __cplusplus
 
-#define BMP180_SEALEVEL 101325.0F // Pressure at sealevel
-
-class BMP180 {
-	private:
-		int16_t AC1;
-		int16_t AC2;
-		int16_t AC3;
-		uint16_t AC4;
-		uint16_t AC5;
-		uint16_t AC6;
-		int16_t B1;
-		int16_t B2;
-		int16_t MB;
-		int16_t MC;
-		int16_t MD;
-
-		uint8_t oss;
-
-		int32_t UT;
-		int32_t UP;
-		// int32_t p0; // BMP180_SEALEVEL
-
-		int32_t B5;
-
-		I2C i2c {address}; // Contructor
-		uint8_t register_rb(uint8_t, uint8_t*);
-		uint8_t register_rw(uint8_t, uint16_t*);
-		uint8_t dump_calibration_data(void);
-		void math_temperature();
-		void math_pressure();
-		void math_altitude();
-		uint8_t resolution(const uint8_t); // WTF?
-	public:
-		BMP180(uint8_t); // constructor
-		const uint8_t address;
-		uint8_t id;
-		float altitude;
-		int32_t T; // Temperature
-		int32_t p; // Pressure
-		uint8_t read_temperature();
-		uint8_t read_pressure();
-		uint8_t read_all();
-};
+// the family driver, BMP180 is BMPx<BMP180Chip>
+#include "bmpx.h"
 
 #else // __cplusplus
 
-/** The address of the device.
- * Typical it is 0x55
- */
-#define BMP180_ADDR 0xee
-#define BMP180_SEALEVEL 101325L
+/* see cic.h */
+struct cic_t;
 
 struct bmp180_t {
+	struct i2c_bus_t *bus; // NULL = TWI
 	uint8_t id;
-
-	int16_t AC1;
-	int16_t AC2;
-	int16_t AC3;
-	uint16_t AC4;
-	uint16_t AC5;
-	uint16_t AC6;
-	int16_t B1;
-	int16_t B2;
-	int16_t MB;
-	int16_t MC;
-	int16_t MD;
-
+	struct bmp180_cal_t cal;
 	uint8_t oss;
 
 	int32_t UT;
@@ -132,9 +111,18 @@ struct bmp180_t {
 };
 
 uint8_t bmp180_init(struct bmp180_t *bmp180);
+uint8_t bmp180_init_bus(struct bmp180_t *bmp180, struct i2c_bus_t *bus);
 uint8_t bmp180_read_temperature(struct bmp180_t *bmp180);
 uint8_t bmp180_read_pressure(struct bmp180_t *bmp180);
 uint8_t bmp180_read_all(struct bmp180_t *bmp180);
+uint8_t bmp180_read_ut(struct bmp180_t *bmp180);
+uint8_t bmp180_read_up(struct bmp180_t *bmp180);
+uint8_t bmp180_capture(struct bmp180_t *bmp180, struct bmp180_raw_t *raw,
+		const uint8_t n);
+void bmp180_compensate(struct bmp180_t *bmp180);
+void bmp180_compensate_avg(struct bmp180_t *bmp180,
+		const struct bmp180_raw_t *raw, const uint8_t n);
+uint8_t bmp180_capture_cic(struct bmp180_t *bmp180, struct cic_t *cic);
 void bmp180_altitude(struct bmp180_t *bmp180);
 
 #endif // __cplusplus
@@ -0,0 +1,157 @@
+/* Copyright (C) 2013, 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_math.h
+ * \brief Integer compensation, shared by the C and C++ drivers.
+ *
+ * Everything works on a plain calibration struct and is inline,
+ * constexpr with C++14, so the compiler can fold the hot path
+ * into the caller. See the datasheet for the algorithm.
+ */
+
+#ifndef _BMP180_MATH
+#define _BMP180_MATH
+
+#include <stdint.h>
+#include <math.h>
+
+/* always inlined, the constant arguments are folded in the caller */
+#if defined(__cplusplus) && (__cplusplus >= 201402L)
+#define BMP180_INLINE constexpr inline __attribute__((always_inline))
+#define BMP180_CONST constexpr
+#else
+#define BMP180_INLINE static inline __attribute__((always_inline))
+#define BMP180_CONST static const
+#endif
+
+/*! Calibration block size in the device, from BMP180_REG_AC1 */
+#define BMP180_CAL_SIZE 22
+
+/*! The calibration coefficients. */
+struct bmp180_cal_t {
+	int16_t AC1;
+	int16_t AC2;
+	int16_t AC3;
+	uint16_t AC4;
+	uint16_t AC5;
+	uint16_t AC6;
+	int16_t B1;
+	int16_t B2;
+	int16_t MB;
+	int16_t MC;
+	int16_t MD;
+};
+
+/*! Decode the calibration block, 11 words MSB first.
+ *
+ * @param cal the coefficients.
+ * @param raw the BMP180_CAL_SIZE bytes read from BMP180_REG_AC1.
+ */
+BMP180_INLINE void bmp180_math_cal(struct bmp180_cal_t *cal,
+		const uint8_t *raw)
+{
+	cal->AC1 = (int16_t)(((uint16_t)raw[0] << 8) | raw[1]);
+	cal->AC2 = (int16_t)(((uint16_t)raw[2] << 8) | raw[3]);
+	cal->AC3 = (int16_t)(((uint16_t)raw[4] << 8) | raw[5]);
+	cal->AC4 = (uint16_t)(((uint16_t)raw[6] << 8) | raw[7]);
+	cal->AC5 = (uint16_t)(((uint16_t)raw[8] << 8) | raw[9]);
+	cal->AC6 = (uint16_t)(((uint16_t)raw[10] << 8) | raw[11]);
+	cal->B1 = (int16_t)(((uint16_t)raw[12] << 8) | raw[13]);
+	cal->B2 = (int16_t)(((uint16_t)raw[14] << 8) | raw[15]);
+	cal->MB = (int16_t)(((uint16_t)raw[16] << 8) | raw[17]);
+	cal->MC = (int16_t)(((uint16_t)raw[18] << 8) | raw[19]);
+	cal->MD = (int16_t)(((uint16_t)raw[20] << 8) | raw[21]);
+}
+
+/*! B5, the temperature term used by the pressure too.
+ *
+ * @param UT the uncompensated temperature.
+ */
+BMP180_INLINE int32_t bmp180_math_b5(const struct bmp180_cal_t *cal,
+		const int32_t UT)
+{
+	int32_t x1 = (UT - cal->AC6) * cal->AC5 >> 15;
+	int32_t x2 = ((int32_t)cal->MC * 2048) / (x1 + cal->MD);
+
+	return(x1 + x2);
+}
+
+/*! Temperature in 0.1 C from B5. */
+BMP180_INLINE int32_t bmp180_math_temperature(const int32_t b5)
+{
+	return((b5 + 8) >> 4);
+}
+
+/*! Pressure in Pa.
+ *
+ * @param b5 from bmp180_math_b5().
+ * @param UP the uncompensated pressure.
+ * @param oss the oversampling setting UP has been read with.
+ */
+BMP180_INLINE int32_t bmp180_math_pressure(const struct bmp180_cal_t *cal,
+		const int32_t b5, const int32_t UP, const uint8_t oss)
+{
+	int32_t b6 = b5 - 4000;
+	int32_t x1 = (cal->B2 * (b6 * b6 >> 12)) >> 11;
+	int32_t x2 = cal->AC2 * b6 >> 11;
+	int32_t x3 = x1 + x2;
+	int32_t b3 = ((((int32_t)cal->AC1 * 4 + x3) << oss) + 2) >> 2;
+	uint32_t b4 = 0;
+	uint32_t b7 = 0;
+	int32_t p = 0;
+
+	x1 = cal->AC3 * b6 >> 13;
+	x2 = (cal->B1 * (b6 * b6 >> 12)) >> 16;
+	x3 = (x1 + x2 + 2) >> 2;
+	b4 = (cal->AC4 * (uint32_t)(x3 + 32768)) >> 15;
+	b7 = (uint32_t)(UP - b3) * (50000 >> oss);
+
+	if (b7 < 0x80000000)
+		p = (b7 << 1) / b4;
+	else
+		p = (b7 / b4) << 1;
+
+	x1 = (p >> 8) * (p >> 8);
+	x1 = (x1 * 3038) >> 16;
+	x2 = (-7357 * p) >> 16;
+	return(p + ((x1 + x2 + 3791) >> 4));
+}
+
+/*! Altitude in m.
+ *
+ * @param p the pressure.
+ * @param p0 the pressure at the sea level.
+ */
+static inline float bmp180_math_altitude(const int32_t p, const int32_t p0)
+{
+	return(44330.0F * (1.0F - ((float)pow(((float)p / (float)p0),
+						0.190223F))));
+}
+
+/*! Pressure at an altitude, the inverse of bmp180_math_altitude().
+ *
+ * @param altitude the altitude in m.
+ * @param p0 the pressure at the sea level.
+ */
+static inline int32_t bmp180_math_p_altitude(const float altitude,
+		const int32_t p0)
+{
+	return((int32_t)((float)p0 * (float)pow(1.0F - altitude / 44330.0F,
+					1.0F / 0.190223F) + 0.5F));
+}
+
+#endif
@@ -0,0 +1,155 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_set.c
+ * \brief Many sensors in little RAM, see bmp180_set.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "bmp180_set.h"
+
+/*! The calibration of sensor i in EEPROM. */
+#define SET_EEPROM(i) ((void *)(uintptr_t)(BMP180_SET_EEPROM_BASE + \
+			(i) * sizeof(struct bmp180_cal_t)))
+
+/*! Empty set. */
+void bmp180_set_init(struct bmp180_set_t *set)
+{
+	set->n = 0;
+	set->cur = BMP180_SET_NONE;
+}
+
+/** Copy the calibration of sensor i in the work struct.
+ *
+ * @param i the sensor.
+ */
+static void load(struct bmp180_set_t *set, const uint8_t i)
+{
+	set->work.bus = set->bus[i];
+	set->work.oss = set->oss[i];
+	set->work.flags = 0;
+
+	if (set->cur == i)
+		return;
+
+#if BMP180_SET_CAL == BMP180_SET_CAL_EEPROM
+	eeprom_read_block(&set->work.cal, SET_EEPROM(i),
+			sizeof(struct bmp180_cal_t));
+#elif BMP180_SET_CAL == BMP180_SET_CAL_FLASH
+	memcpy_P(&set->work.cal, &bmp180_set_cal_P[i],
+			sizeof(struct bmp180_cal_t));
+#else
+	set->work.cal = set->cal[i];
+#endif
+	set->cur = i;
+}
+
+/** Add a sensor.
+ *
+ * The bus is initialized, the sensor's oss is the one in its
+ * control register.
+ *
+ * @param bus the software i2c bus, NULL = TWI.
+ * @return 0 - OK the sensor is set->n - 1, BMP180_SET_E_ or the
+ * bus error.
+ */
+uint8_t bmp180_set_add(struct bmp180_set_t *set, struct i2c_bus_t *bus)
+{
+	uint8_t err, i;
+
+	if (set->n == BMP180_SET_SIZE)
+		return(BMP180_SET_E_FULL);
+
+	i = set->n;
+	/* the work calibration is overwritten by the sensor's */
+	set->cur = BMP180_SET_NONE;
+	err = bmp180_init_bus(&set->work, bus);
+
+	if (err)
+		return(err);
+
+	if (set->work.id != 0x55)
+		return(BMP180_SET_E_ID);
+
+#if BMP180_SET_CAL == BMP180_SET_CAL_EEPROM
+	eeprom_update_block(&set->work.cal, SET_EEPROM(i),
+			sizeof(struct bmp180_cal_t));
+#elif BMP180_SET_CAL == BMP180_SET_CAL_FLASH
+	if (memcmp_P(&set->work.cal, &bmp180_set_cal_P[i],
+				sizeof(struct bmp180_cal_t)))
+		return(BMP180_SET_E_CAL);
+#else
+	set->cal[i] = set->work.cal;
+#endif
+
+	set->bus[i] = bus;
+	set->oss[i] = set->work.oss;
+	set->p[i] = 0;
+	set->T[i] = 0;
+	set->cur = i;
+	set->n++;
+	return(0);
+}
+
+/** Read T and p of a sensor.
+ *
+ * @param i the sensor.
+ * @return 0 - OK, set->T[i] and set->p[i] updated, the bus error.
+ */
+uint8_t bmp180_set_read(struct bmp180_set_t *set, const uint8_t i)
+{
+	uint8_t err;
+
+	load(set, i);
+	err = bmp180_read_all(&set->work);
+
+	if (!err) {
+		set->T[i] = set->work.T;
+		set->p[i] = set->work.p;
+	}
+
+	return(err);
+}
+
+/** Read the average of n raw samples of a sensor.
+ *
+ * See bmp180_capture() and bmp180_compensate_avg().
+ *
+ * @param i the sensor.
+ * @param raw the caller's buffer, n elements.
+ * @param n the samples.
+ * @return 0 - OK, set->T[i] and set->p[i] updated, the bus error.
+ */
+uint8_t bmp180_set_read_avg(struct bmp180_set_t *set, const uint8_t i,
+		struct bmp180_raw_t *raw, const uint8_t n)
+{
+	uint8_t err;
+
+	load(set, i);
+	err = bmp180_capture(&set->work, raw, n);
+
+	if (!err) {
+		bmp180_compensate_avg(&set->work, raw, n);
+		set->T[i] = set->work.T;
+		set->p[i] = set->work.p;
+	}
+
+	return(err);
+}
@@ -0,0 +1,122 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_set.h
+ * \brief Many sensors in little RAM.
+ *
+ * A struct bmp180_t is 55 bytes on the AVR, most of it the
+ * calibration and the transient UT, UP, B5 of a read. The set
+ * keeps per sensor only what lasts between two reads, in arrays:
+ * the bus, the oss, T and p, 9 bytes, plus the 22 bytes calibration
+ * if it is in RAM. The transfers and the compensation run on a
+ * single struct bmp180_t shared by all the sensors, the calibration
+ * of the sensor read is copied in it first, from:
+ *
+ * BMP180_SET_CAL_RAM: an array in the set, the default.
+ * BMP180_SET_CAL_EEPROM: the EEPROM from BMP180_SET_EEPROM_BASE,
+ *   written by bmp180_set_add() only if changed. With make LOG=eeprom
+ *   the log must start after it, see LOGGER_EEPROM_BASE.
+ * BMP180_SET_CAL_FLASH: bmp180_set_cal_P[], the application's table
+ *   in flash, ex. from tools/bmp180_calgen.py --table. The sensor
+ *   found must match it.
+ *
+ * The copy is skipped when the same sensor is read again. The set
+ * always uses the generic compensation, not BMP180_FIXED_CAL.
+ * Sensors at the same address need their own bus, see i2c_soft.h.
+ */
+
+#ifndef _BMP180_SET_H_
+#define _BMP180_SET_H_
+
+#include <stdint.h>
+#include "bmp180.h"
+
+/*! Max sensors */
+#ifndef BMP180_SET_SIZE
+#define BMP180_SET_SIZE 4
+#endif
+
+#define BMP180_SET_CAL_RAM 0
+#define BMP180_SET_CAL_EEPROM 1
+#define BMP180_SET_CAL_FLASH 2
+
+/*! Where the calibrations are */
+#ifndef BMP180_SET_CAL
+#define BMP180_SET_CAL BMP180_SET_CAL_RAM
+#endif
+
+/*! First EEPROM byte of the calibrations */
+#ifndef BMP180_SET_EEPROM_BASE
+#define BMP180_SET_EEPROM_BASE 0
+#endif
+
+/*! bmp180_set_add(), the set is full */
+#define BMP180_SET_E_FULL 1
+/*! bmp180_set_add(), no BMP180 answered */
+#define BMP180_SET_E_ID 2
+/*! bmp180_set_add(), the calibration in flash is of another sensor */
+#define BMP180_SET_E_CAL 3
+
+/*! The calibration in the work struct is of no sensor. */
+#define BMP180_SET_NONE 0xff
+
+/*! Calibration RAM bytes per sensor */
+#if BMP180_SET_CAL == BMP180_SET_CAL_RAM
+#define BMP180_SET_CAL_BYTES sizeof(struct bmp180_cal_t)
+#else
+#define BMP180_SET_CAL_BYTES 0
+#endif
+
+/*! RAM bytes per sensor */
+#define BMP180_SET_SENSOR_BYTES (sizeof(struct i2c_bus_t *) + \
+		sizeof(int32_t) + sizeof(int16_t) + sizeof(uint8_t) + \
+		BMP180_SET_CAL_BYTES)
+
+/*! The sensors, struct of arrays. */
+struct bmp180_set_t {
+	/*! per sensor: the bus, NULL = TWI. */
+	struct i2c_bus_t *bus[BMP180_SET_SIZE];
+	/*! per sensor: the last pressure, Pa. */
+	int32_t p[BMP180_SET_SIZE];
+	/*! per sensor: the last temperature, 0.1 C. */
+	int16_t T[BMP180_SET_SIZE];
+	/*! per sensor: the oversampling, BMP180_RES_ ones. */
+	uint8_t oss[BMP180_SET_SIZE];
+#if BMP180_SET_CAL == BMP180_SET_CAL_RAM
+	/*! per sensor: the calibration. */
+	struct bmp180_cal_t cal[BMP180_SET_SIZE];
+#endif
+	/*! sensors added. */
+	uint8_t n;
+	/*! the sensor of the calibration in work. */
+	uint8_t cur;
+	/*! shared by all the sensors. */
+	struct bmp180_t work;
+};
+
+#if BMP180_SET_CAL == BMP180_SET_CAL_FLASH
+/*! The calibrations, in the order the sensors are added. */
+extern const struct bmp180_cal_t bmp180_set_cal_P[BMP180_SET_SIZE];
+#endif
+
+void bmp180_set_init(struct bmp180_set_t *set);
+uint8_t bmp180_set_add(struct bmp180_set_t *set, struct i2c_bus_t *bus);
+uint8_t bmp180_set_read(struct bmp180_set_t *set, const uint8_t i);
+uint8_t bmp180_set_read_avg(struct bmp180_set_t *set, const uint8_t i,
+		struct bmp180_raw_t *raw, const uint8_t n);
+
+#endif
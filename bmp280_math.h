@@ -0,0 +1,108 @@
+/* Copyright (C) 2013, 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp280_math.h
+ * \brief BMP280 integer compensation, the 32 bit one of the
+ * datasheet, shared by the C and C++ code like bmp180_math.h.
+ *
+ * The 64 bit pressure code gives 1/256 Pa but costs a 64 bit
+ * division on the AVR, the 32 bit one is 3 Pa off the datasheet
+ * example, see host/verify_bmp280.cpp.
+ */
+
+#ifndef _BMP280_MATH
+#define _BMP280_MATH
+
+#include <stdint.h>
+#include "bmp180_math.h"
+
+/*! Calibration block size in the device, from BMP280_REG_CAL */
+#define BMP280_CAL_SIZE 24
+
+/*! The calibration coefficients. */
+struct bmp280_cal_t {
+	uint16_t T1;
+	int16_t T2;
+	int16_t T3;
+	uint16_t P1;
+	int16_t P2;
+	int16_t P3;
+	int16_t P4;
+	int16_t P5;
+	int16_t P6;
+	int16_t P7;
+	int16_t P8;
+	int16_t P9;
+};
+
+/*! t_fine, the temperature term used by the pressure too.
+ *
+ * @param UT the 20 bit uncompensated temperature.
+ */
+BMP180_INLINE int32_t bmp280_math_t_fine(const struct bmp280_cal_t *cal,
+		const int32_t UT)
+{
+	int32_t x1 = (((UT >> 3) - ((int32_t)cal->T1 << 1)) *
+			(int32_t)cal->T2) >> 11;
+	int32_t x2 = (((((UT >> 4) - (int32_t)cal->T1) *
+				((UT >> 4) - (int32_t)cal->T1)) >> 12) *
+			(int32_t)cal->T3) >> 14;
+
+	return(x1 + x2);
+}
+
+/*! Temperature in 0.1 C from t_fine, as the BMP180 one. */
+BMP180_INLINE int32_t bmp280_math_temperature(const int32_t t_fine)
+{
+	return((t_fine + 256) >> 9);
+}
+
+/*! Pressure in Pa.
+ *
+ * @param t_fine from bmp280_math_t_fine().
+ * @param UP the 20 bit uncompensated pressure.
+ * @return 0 with an invalid calibration.
+ */
+BMP180_INLINE int32_t bmp280_math_pressure(const struct bmp280_cal_t *cal,
+		const int32_t t_fine, const int32_t UP)
+{
+	int32_t x1 = (t_fine >> 1) - 64000;
+	int32_t x2 = (((x1 >> 2) * (x1 >> 2)) >> 11) * cal->P6;
+	uint32_t p = 0;
+
+	x2 = x2 + ((x1 * cal->P5) << 1);
+	x2 = (x2 >> 2) + ((int32_t)cal->P4 << 16);
+	x1 = (((cal->P3 * (((x1 >> 2) * (x1 >> 2)) >> 13)) >> 3) +
+			((cal->P2 * x1) >> 1)) >> 18;
+	x1 = ((32768 + x1) * (int32_t)cal->P1) >> 15;
+
+	if (!x1)
+		return(0);
+
+	p = ((uint32_t)(1048576 - UP) - (x2 >> 12)) * 3125;
+
+	if (p < 0x80000000)
+		p = (p << 1) / (uint32_t)x1;
+	else
+		p = (p / (uint32_t)x1) << 1;
+
+	x1 = (cal->P9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+	x2 = ((int32_t)(p >> 2) * cal->P8) >> 13;
+	return((int32_t)p + ((x1 + x2 + cal->P7) >> 4));
+}
+
+#endif
@@ -0,0 +1,550 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmpx.h
+ * \brief The Bosch barometer family, C++ only, included by bmp180.h.
+ *
+ * BMPx<Chip> is the driver, the Chip traits hold what changes
+ * between the chips: id, register map, calibration layout,
+ * compensation, conversion commands and times, and the read_all()
+ * sequence, each chip with its fastest one:
+ *
+ * BMP085, BMP180: a T and then a p conversion, 2 + 3 byte reads.
+ * BMP280: one forced conversion of both, a single 6 byte burst. In
+ * normal mode, see BMPx::normal(), the chip converts on its own and
+ * read_all() is the burst only.
+ *
+ * The registers are typed fields read through BMPxMap, see
+ * bmpx_regs.h. Everything is resolved at compile time, the
+ * specializations are instantiated in bmp180.cpp. BMP180 is
+ * BMPx<BMP180Chip>, the same API as before. At runtime bmpx_detect()
+ * reads the id and runs the code with the specialization of the chip
+ * found.
+ *
+ * The oversampling is the API's oss for every chip: 0..3 the
+ * BMP180_RES_ ones, the BMP280 has the BMP280_RES_ULTRAHIGH 4 too.
+ * T is always in 0.1 C and p in Pa.
+ */
+
+#ifndef _BMPX_H_
+#define _BMPX_H_
+
+#include <stdint.h>
+#include "bmp180.h"
+#include "bmp280_math.h"
+#include "bmpx_regs.h"
+
+#define BMP280_REG_CAL 0x88
+#define BMP280_REG_ID 0xd0
+#define BMP280_REG_CTRL_MEAS 0xf4
+#define BMP280_REG_CONFIG 0xf5
+#define BMP280_REG_PRESS 0xf7
+#define BMP280_REG_TEMP 0xfa
+
+/*! pressure x16, temperature x2 */
+#define BMP280_RES_ULTRAHIGH 4
+
+/*! BMP280 normal mode running, see BMPx::normal(). */
+#define BMPX_FLAG_NORMAL 8
+
+/*! timer_cycles() per second, Timer1 without prescaler. */
+#ifdef F_CPU
+#define BMPX_TIMER_HZ F_CPU
+#else
+#define BMPX_TIMER_HZ 16000000UL
+#endif
+
+/*! stream_poll(), the stream is over. */
+#define BMPX_STREAM_STOP 0xff
+
+/*! The sample delivery of a stream, non zero stops it. */
+typedef uint8_t (*bmpx_stream_cb_t)(void *ctx,
+		const struct bmp180_sample_t *sample);
+
+/*! A stream of samples, see BMPx::start_stream().
+ *
+ * The caller sets the config and owns the memory, the rest is the
+ * driver's state and the figures of the run.
+ */
+struct bmpx_stream_t {
+	/*! config: samples per second, 0 back to back. */
+	uint16_t rate;
+	/*! config: the oversampling. */
+	uint8_t oss;
+	/*! config: a T conversion every t_every samples, 0 only the
+	 * first. The BMP280 measures T with every p anyway.
+	 */
+	uint8_t t_every;
+	/*! config: samples to deliver, 0 until the callback stops it. */
+	uint32_t count;
+	/*! the delivery, from start_stream(). */
+	bmpx_stream_cb_t cb;
+	void *ctx;
+	/*! state: STREAM_ ones, see bmpx_stream.cpp. */
+	uint8_t state;
+	/*! state: failed transactions in a row. */
+	uint8_t fails;
+	/*! the error which stopped the stream, 0 none. */
+	uint8_t err;
+	/*! state: samples to the next T conversion. */
+	uint8_t t_left;
+	/*! state: the end of the running conversion, timer_cycles(). */
+	uint32_t ready;
+	/*! state: the start of the next pressure conversion. */
+	uint32_t due;
+	/*! state: the start of the running pressure conversion. */
+	uint32_t start;
+	/*! samples delivered. */
+	uint32_t samples;
+	/*! T conversions done. */
+	uint32_t temperatures;
+	/*! failed transactions, retried. */
+	uint16_t errors;
+	/*! samples started after their slot, the rate is too high. */
+	uint16_t late;
+	/*! timer_cycles() of the last sample. */
+	uint32_t last;
+	/*! first to last sample in ms and cycles, added up per sample,
+	 * the timer wraps in 268 s.
+	 */
+	uint32_t span_ms;
+	uint32_t span_cycles;
+};
+
+/*! BMP280 raw sample, 20 bit both. */
+struct bmp280_raw_t {
+	int32_t UT;
+	int32_t UP;
+};
+
+/*! BMP180 traits. */
+struct BMP180Chip {
+	typedef struct bmp180_cal_t cal_t;
+	typedef struct bmp180_raw_t raw_t;
+
+	typedef BMPxField<BMP180_REG_AC1, 2, true, true> AC1;
+	typedef BMPxField<BMP180_REG_AC2, 2, true, true> AC2;
+	typedef BMPxField<BMP180_REG_AC3, 2, true, true> AC3;
+	typedef BMPxField<BMP180_REG_AC4, 2, false, true> AC4;
+	typedef BMPxField<BMP180_REG_AC5, 2, false, true> AC5;
+	typedef BMPxField<BMP180_REG_AC6, 2, false, true> AC6;
+	typedef BMPxField<BMP180_REG_B1, 2, true, true> B1;
+	typedef BMPxField<BMP180_REG_B2, 2, true, true> B2;
+	typedef BMPxField<BMP180_REG_MB, 2, true, true> MB;
+	typedef BMPxField<BMP180_REG_MC, 2, true, true> MC;
+	typedef BMPxField<BMP180_REG_MD, 2, true, true> MD;
+	typedef BMPxField<BMP180_REG_ADC, 2, false, true> UT;
+	// 19 bit at oss 3, up() drops the unused low bits of the oss
+	typedef BMPxField<BMP180_REG_ADC, 3, false, true> UP;
+
+	typedef BMPxMap<AC1, AC2, AC3, AC4, AC5, AC6, B1, B2, MB, MC, MD>
+		cal_map;
+	typedef BMPxMap<UT> t_map;
+	typedef BMPxMap<UP> p_map;
+
+	static_assert(cal_map::size() == BMP180_CAL_SIZE, "calibration");
+
+	static constexpr uint8_t ctrl_reg = BMP180_REG_CTRL;
+	static constexpr uint8_t oss_max = BMP180_RES_ULTRAHIGH;
+	static constexpr bool eoc = false;
+	static constexpr bool normal = false;
+	// the p conversion measures T too
+	static constexpr bool t_in_p = false;
+
+	static constexpr bool match(const uint8_t id)
+	{
+		return(id == 0x55);
+	}
+
+	static constexpr uint8_t normal_ctrl(const uint8_t oss)
+	{
+		return(0);
+	}
+
+	static constexpr uint8_t normal_config(const uint8_t standby)
+	{
+		return(0);
+	}
+
+	/*! The cal_map buffer to the calibration. */
+	static void decode_cal(cal_t *cal, const uint8_t *raw)
+	{
+		cal->AC1 = cal_map::get<AC1>(raw);
+		cal->AC2 = cal_map::get<AC2>(raw);
+		cal->AC3 = cal_map::get<AC3>(raw);
+		cal->AC4 = cal_map::get<AC4>(raw);
+		cal->AC5 = cal_map::get<AC5>(raw);
+		cal->AC6 = cal_map::get<AC6>(raw);
+		cal->B1 = cal_map::get<B1>(raw);
+		cal->B2 = cal_map::get<B2>(raw);
+		cal->MB = cal_map::get<MB>(raw);
+		cal->MC = cal_map::get<MC>(raw);
+		cal->MD = cal_map::get<MD>(raw);
+	}
+
+	/*! The oss of the last conversion, from the ctrl register. */
+	static constexpr uint8_t oss_of(const uint8_t ctrl)
+	{
+		return(ctrl >> 6);
+	}
+
+	static constexpr uint8_t start_t(const uint8_t oss)
+	{
+		return(0x2e);
+	}
+
+	static constexpr uint8_t start_p(const uint8_t oss)
+	{
+		return(0x34 + (oss << 6));
+	}
+
+	/*! ms from start to fetch, the datasheet max rounded up. */
+	static constexpr uint8_t conversion_ms(const bool pressure,
+			const uint8_t oss)
+	{
+		return(!pressure ? 5 : (oss == BMP180_RES_LOW) ? 5 :
+				(oss == BMP180_RES_STD) ? 8 :
+				(oss == BMP180_RES_HIGH) ? 14 : 26);
+	}
+
+	/*! UT of the t_map buffer. */
+	static constexpr int32_t ut(const uint8_t *buf)
+	{
+		return(t_map::get<UT>(buf));
+	}
+
+	/*! UP of the p_map buffer. */
+	static constexpr int32_t up(const uint8_t *buf, const uint8_t oss)
+	{
+		return(p_map::get<UP>(buf) >> (8 - oss));
+	}
+
+	static constexpr int32_t fine(const cal_t &cal, const int32_t UT)
+	{
+		return(bmp180_math_b5(&cal, UT));
+	}
+
+	static constexpr int32_t temperature(const int32_t fine)
+	{
+		return(bmp180_math_temperature(fine));
+	}
+
+	static constexpr int32_t pressure(const cal_t &cal, const int32_t fine,
+			const int32_t UP, const uint8_t oss)
+	{
+		return(bmp180_math_pressure(&cal, fine, UP, oss));
+	}
+
+	/*! The result of a finished start_p(). */
+	template <class D> static uint8_t fetch_all(D &d)
+	{
+		return(d.fetch_pressure());
+	}
+
+	/*! A T then a p conversion. */
+	template <class D> static uint8_t read_all(D &d)
+	{
+		uint8_t err;
+
+		err = d.read_temperature();
+
+		if (!err)
+			err = d.read_pressure();
+
+		return(err);
+	}
+};
+
+/*! BMP085 traits, the BMP180 registers, calibration and times.
+ *
+ * It differs only in the EOC pin, see LOWPOWER_EOC in lowpower.h.
+ */
+struct BMP085Chip : BMP180Chip {
+	static constexpr bool eoc = true;
+};
+
+/*! BMP280 traits, forced mode. */
+struct BMP280Chip {
+	typedef struct bmp280_cal_t cal_t;
+	typedef struct bmp280_raw_t raw_t;
+
+	// the calibration is little endian
+	typedef BMPxField<BMP280_REG_CAL, 2, false, false> T1;
+	typedef BMPxField<BMP280_REG_CAL + 2, 2, true, false> T2;
+	typedef BMPxField<BMP280_REG_CAL + 4, 2, true, false> T3;
+	typedef BMPxField<BMP280_REG_CAL + 6, 2, false, false> P1;
+	typedef BMPxField<BMP280_REG_CAL + 8, 2, true, false> P2;
+	typedef BMPxField<BMP280_REG_CAL + 10, 2, true, false> P3;
+	typedef BMPxField<BMP280_REG_CAL + 12, 2, true, false> P4;
+	typedef BMPxField<BMP280_REG_CAL + 14, 2, true, false> P5;
+	typedef BMPxField<BMP280_REG_CAL + 16, 2, true, false> P6;
+	typedef BMPxField<BMP280_REG_CAL + 18, 2, true, false> P7;
+	typedef BMPxField<BMP280_REG_CAL + 20, 2, true, false> P8;
+	typedef BMPxField<BMP280_REG_CAL + 22, 2, true, false> P9;
+	// msb, lsb, xlsb[7:4]
+	typedef BMPxField<BMP280_REG_TEMP, 3, false, true, 4> UT;
+	typedef BMPxField<BMP280_REG_PRESS, 3, false, true, 4> UP;
+
+	typedef BMPxMap<T1, T2, T3, P1, P2, P3, P4, P5, P6, P7, P8, P9>
+		cal_map;
+	typedef BMPxMap<UT> t_map;
+	typedef BMPxMap<UP> p_map;
+	// p and T, adjacent: a single burst
+	typedef BMPxMap<UP, UT> all_map;
+
+	static_assert(cal_map::size() == BMP280_CAL_SIZE, "calibration");
+	static_assert(all_map::bursts() == 1, "p and T in one burst");
+
+	static constexpr uint8_t ctrl_reg = BMP280_REG_CTRL_MEAS;
+	static constexpr uint8_t oss_max = BMP280_RES_ULTRAHIGH;
+	static constexpr bool eoc = false;
+	static constexpr bool normal = true;
+	static constexpr bool t_in_p = true;
+
+	/*! 0x56, 0x57 samples, 0x58 production */
+	static constexpr bool match(const uint8_t id)
+	{
+		return((id >= 0x56) && (id <= 0x58));
+	}
+
+	/*! The cal_map buffer to the calibration. */
+	static void decode_cal(cal_t *cal, const uint8_t *raw)
+	{
+		cal->T1 = cal_map::get<T1>(raw);
+		cal->T2 = cal_map::get<T2>(raw);
+		cal->T3 = cal_map::get<T3>(raw);
+		cal->P1 = cal_map::get<P1>(raw);
+		cal->P2 = cal_map::get<P2>(raw);
+		cal->P3 = cal_map::get<P3>(raw);
+		cal->P4 = cal_map::get<P4>(raw);
+		cal->P5 = cal_map::get<P5>(raw);
+		cal->P6 = cal_map::get<P6>(raw);
+		cal->P7 = cal_map::get<P7>(raw);
+		cal->P8 = cal_map::get<P8>(raw);
+		cal->P9 = cal_map::get<P9>(raw);
+	}
+
+	/*! From osrs_p, x1 .. x16 is oss 0 .. 4. */
+	static constexpr uint8_t oss_of(const uint8_t ctrl)
+	{
+		return((((ctrl >> 2) & 7) < 2) ? 0 :
+				(((ctrl >> 2) & 7) > 5) ? 4 : ((ctrl >> 2) & 7) - 1);
+	}
+
+	/*! osrs_t x1, x2 at the highest oss as the datasheet suggests */
+	static constexpr uint8_t osrs_t(const uint8_t oss)
+	{
+		return((oss == BMP280_RES_ULTRAHIGH) ? 2 : 1);
+	}
+
+	/*! Forced mode, the pressure skipped. */
+	static constexpr uint8_t start_t(const uint8_t oss)
+	{
+		return((osrs_t(oss) << 5) | 1);
+	}
+
+	/*! Forced mode, T and p. */
+	static constexpr uint8_t start_p(const uint8_t oss)
+	{
+		return((osrs_t(oss) << 5) | ((oss + 1) << 2) | 1);
+	}
+
+	/*! Normal mode, T and p. */
+	static constexpr uint8_t normal_ctrl(const uint8_t oss)
+	{
+		return((osrs_t(oss) << 5) | ((oss + 1) << 2) | 3);
+	}
+
+	/*! t_sb, the standby between conversions, 0 .. 7 is 0.5 ms ..
+	 * 4 s, the IIR filter off.
+	 */
+	static constexpr uint8_t normal_config(const uint8_t standby)
+	{
+		return((standby & 7) << 5);
+	}
+
+	/*! The datasheet max, 1.25 + 2.3 per sample + 0.575 ms with p. */
+	static constexpr uint8_t conversion_ms(const bool pressure,
+			const uint8_t oss)
+	{
+		return(!pressure ? ((oss == BMP280_RES_ULTRAHIGH) ? 6 : 4) :
+				(oss == 0) ? 7 : (oss == 1) ? 9 : (oss == 2) ? 14 :
+				(oss == 3) ? 23 : 44);
+	}
+
+	/*! UT of the t_map buffer. */
+	static constexpr int32_t ut(const uint8_t *buf)
+	{
+		return(t_map::get<UT>(buf));
+	}
+
+	/*! UP of the p_map buffer. */
+	static constexpr int32_t up(const uint8_t *buf, const uint8_t oss)
+	{
+		return(p_map::get<UP>(buf));
+	}
+
+	static constexpr int32_t fine(const cal_t &cal, const int32_t UT)
+	{
+		return(bmp280_math_t_fine(&cal, UT));
+	}
+
+	static constexpr int32_t temperature(const int32_t fine)
+	{
+		return(bmp280_math_temperature(fine));
+	}
+
+	static constexpr int32_t pressure(const cal_t &cal, const int32_t fine,
+			const int32_t UP, const uint8_t oss)
+	{
+		return(bmp280_math_pressure(&cal, fine, UP));
+	}
+
+	/*! p and T of a finished start_p() in a 6 byte burst.
+	 *
+	 * The burst keeps both of the same conversion (datasheet 3.9,
+	 * shadowing), in normal mode too.
+	 */
+	template <class D> static uint8_t fetch_all(D &d)
+	{
+		uint8_t err, buf[all_map::size()];
+
+		err = all_map::read(d, buf);
+
+		if (!err)
+			d.set_raw(all_map::get<UT>(buf), all_map::get<UP>(buf));
+
+		return(err);
+	}
+
+	/*! One conversion of both, in normal mode the last one. */
+	template <class D> static uint8_t read_all(D &d)
+	{
+		uint8_t err;
+
+		err = 0;
+
+		if (!(d.flags & BMPX_FLAG_NORMAL)) {
+			err = d.start_pressure();
+
+			if (!err)
+				d.wait(d.conversion_ms(true));
+		}
+
+		if (!err)
+			err = fetch_all(d);
+
+		return(err);
+	}
+};
+
+/*! The family driver. */
+template <class Chip> class BMPx {
+	friend Chip;
+	template <class...> friend struct BMPxMap;
+
+	private:
+		typename Chip::cal_t cal;
+		uint8_t oss;
+		uint8_t flags;
+		int32_t UT;
+		int32_t UP;
+		// the oss UP was sampled at
+		uint8_t up_oss;
+		// the temperature term of the pressure, B5 or t_fine
+		int32_t fine;
+		I2C i2c; // Contructor
+		uint8_t register_rb(uint8_t, uint8_t*);
+		uint8_t register_wb(uint8_t, uint8_t);
+		uint8_t read_regs(uint8_t, const uint8_t, uint8_t*);
+		void wait(const uint8_t);
+		void set_raw(const int32_t, const int32_t);
+		void math_temperature();
+		void math_pressure();
+		uint8_t fetch_ut();
+		uint8_t fetch_up();
+		uint8_t read_ut();
+		uint8_t read_up();
+	public:
+		typedef typename Chip::raw_t raw_t;
+		BMPx(uint8_t, struct i2c_bus_t * = nullptr); // constructor
+		uint8_t id;
+		int32_t T; // Temperature
+		int32_t p; // Pressure
+		int32_t p0; // Pressure at sealevel, BMP180_SEALEVEL
+		bool present() const;
+		uint8_t read_temperature();
+		uint8_t read_pressure();
+		uint8_t read_all();
+		uint8_t resolution(const uint8_t);
+		uint8_t capture(raw_t *, const uint8_t);
+		void compensate();
+		void compensate(const raw_t *, const uint8_t);
+		// split conversions, the caller waits conversion_ms()
+		uint8_t conversion_ms(const bool) const;
+		uint8_t start_temperature();
+		uint8_t fetch_temperature();
+		uint8_t start_pressure();
+		uint8_t fetch_pressure();
+		// continuous conversions, BMP280 only
+		uint8_t normal(const uint8_t);
+		uint8_t forced();
+		// free the bus after TW_MT_ARB_LOST or TW_NO_INFO
+		uint8_t recover();
+		// sample stream, see bmpx_stream.cpp
+		uint8_t start_stream(struct bmpx_stream_t *, bmpx_stream_cb_t,
+				void *);
+		uint8_t stream_poll(struct bmpx_stream_t *);
+		uint8_t stream_run(struct bmpx_stream_t *);
+};
+
+typedef BMPx<BMP085Chip> BMP085;
+typedef BMPx<BMP180Chip> BMP180;
+typedef BMPx<BMP280Chip> BMP280;
+
+uint8_t bmpx_id(uint8_t, struct i2c_bus_t * = nullptr);
+uint8_t bmpx_stream_queue(void *queue, const struct bmp180_sample_t *sample);
+float bmpx_stream_sps(const struct bmpx_stream_t *stream);
+
+/*! Run f with the driver of the chip at addr.
+ *
+ * f is called once with a BMP180 or a BMP280 (a generic lambda
+ * takes both), the BMP085 has the BMP180 id and is driven as one.
+ *
+ * @return the chip id, 0 if no chip of the family answered.
+ */
+template <class F> uint8_t bmpx_detect(uint8_t addr, struct i2c_bus_t *bus,
+		F f)
+{
+	uint8_t id;
+
+	id = bmpx_id(addr, bus);
+
+	if (BMP180Chip::match(id)) {
+		BMP180 sensor(addr, bus);
+		f(sensor);
+	} else if (BMP280Chip::match(id)) {
+		BMP280 sensor(addr, bus);
+		f(sensor);
+	} else {
+		id = 0;
+	}
+
+	return(id);
+}
+
+#endif
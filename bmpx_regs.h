@@ -0,0 +1,242 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmpx_regs.h
+ * \brief Typed register map, C++ only, included by bmpx.h.
+ *
+ * A BMPxField is a register field: first address, bytes, signed or
+ * not, byte order and the right shift of the unused low bits. A
+ * BMPxMap is the set of fields a read needs, in any order: at
+ * compile time it merges the fields at adjacent or overlapping
+ * addresses into the fewest bursts, lays the bursts one after the
+ * other in a buffer of size() bytes and gives every field its
+ * offset in it. read() is then one read_regs() per burst and
+ * get<Field>() the decoding of a field, both with constants only.
+ * A get<>() of a field not in the map does not compile.
+ *
+ * ex. BMPxMap<BMP280Chip::UP, BMP280Chip::UT> is one 6 byte burst
+ * from 0xf7, the BMP180 calibration one 22 byte burst from 0xaa.
+ *
+ * The C driver keeps the BMP180_REG_ defines of bmp180.h, the
+ * fields take their addresses from them.
+ */
+
+#ifndef _BMPX_REGS_H_
+#define _BMPX_REGS_H_
+
+#include <stdint.h>
+
+/*! A compile time constant, forced. */
+template <class T, T V> struct BMPxConst {
+	static constexpr T value = V;
+};
+
+/*! The unsigned word holding n bytes. */
+template <uint8_t n> struct BMPxWord {
+	typedef uint32_t type;
+};
+
+template <> struct BMPxWord<1> {
+	typedef uint8_t type;
+};
+
+template <> struct BMPxWord<2> {
+	typedef uint16_t type;
+};
+
+/*! A register field.
+ *
+ * @param Addr the first register.
+ * @param Bytes 1 .. 4 registers.
+ * @param Signed two's complement.
+ * @param Big the first register is the most significant byte.
+ * @param Shift the low bits not in the field.
+ */
+template <uint8_t Addr, uint8_t Bytes, bool Signed, bool Big,
+	uint8_t Shift = 0>
+struct BMPxField {
+	typedef typename BMPxWord<Bytes>::type word_t;
+
+	static_assert((Bytes > 0) && (Bytes <= 4), "1 .. 4 bytes");
+	static constexpr uint8_t addr = Addr;
+	static constexpr uint8_t bytes = Bytes;
+
+	/*! The raw word, raw at the first register. */
+	static constexpr word_t word(const uint8_t *raw, const uint8_t i = 0)
+	{
+		return((i == Bytes) ? 0 : (word_t)((word_t)raw[Big ? i :
+					Bytes - 1 - i] << (8 * (Bytes - 1 - i))) |
+				word(raw, i + 1));
+	}
+
+	static constexpr int32_t get(const uint8_t *raw)
+	{
+		return(Signed ? ((int32_t)((uint32_t)word(raw) <<
+						(32 - 8 * Bytes)) >> (32 - 8 * Bytes + Shift)) :
+				(int32_t)(word(raw) >> Shift));
+	}
+};
+
+/*! A set of fields and its burst plan. */
+template <class... F> struct BMPxMap {
+	static_assert(sizeof...(F) > 0, "no fields");
+
+	/*! The end of the burst from start, merging the fields at its
+	 * end or over it.
+	 */
+	static constexpr uint16_t end(const uint8_t start)
+	{
+		const uint8_t a[] = { F::addr... };
+		const uint8_t n[] = { F::bytes... };
+		uint16_t e = start, grown = 1;
+
+		while (grown) {
+			grown = 0;
+
+			for (uint8_t i = 0; i < sizeof...(F); i++)
+				if ((a[i] <= e) && (a[i] + n[i] > e)) {
+					e = a[i] + n[i];
+					grown = 1;
+				}
+		}
+
+		return(e);
+	}
+
+	/*! A field address no other field covers or ends at. */
+	static constexpr bool is_start(const uint8_t addr)
+	{
+		const uint8_t a[] = { F::addr... };
+		const uint8_t n[] = { F::bytes... };
+
+		for (uint8_t i = 0; i < sizeof...(F); i++)
+			if ((a[i] < addr) && (a[i] + n[i] >= addr))
+				return(false);
+
+		return(true);
+	}
+
+	/*! The first register of burst b, in address order, 0x100
+	 * after the last.
+	 */
+	static constexpr uint16_t start(const uint8_t b)
+	{
+		const uint8_t a[] = { F::addr... };
+		int16_t last = -1;
+		uint16_t next = 0;
+
+		for (uint8_t k = 0; k <= b; k++) {
+			next = 0x100;
+
+			for (uint8_t i = 0; i < sizeof...(F); i++)
+				if ((a[i] > last) && (a[i] < next) && is_start(a[i]))
+					next = a[i];
+
+			last = next;
+		}
+
+		return(next);
+	}
+
+	static constexpr uint8_t bursts()
+	{
+		uint8_t b = 0;
+
+		while (start(b) < 0x100)
+			b++;
+
+		return(b);
+	}
+
+	/*! The offset of the register addr in the buffer, 0xff none. */
+	static constexpr uint8_t offset(const uint8_t addr)
+	{
+		uint8_t o = 0;
+
+		for (uint8_t b = 0; b < bursts(); b++) {
+			if ((start(b) <= addr) && (addr < end(start(b))))
+				return(o + addr - start(b));
+
+			o += end(start(b)) - start(b);
+		}
+
+		return(0xff);
+	}
+
+	/*! The buffer bytes. */
+	static constexpr uint8_t size()
+	{
+		uint8_t o = 0;
+
+		for (uint8_t b = 0; b < bursts(); b++)
+			o += end(start(b)) - start(b);
+
+		return(o);
+	}
+
+	/*! Fill buf, size() bytes, with d.read_regs() bursts. */
+	template <class D> static uint8_t read(D &d, uint8_t *buf)
+	{
+		return(burst<0>(d, buf, BMPxConst<bool, (bursts() > 0)>()));
+	}
+
+	/*! Field G of the buffer filled by read(). */
+	template <class G> static constexpr int32_t get(const uint8_t *buf)
+	{
+		static_assert(is_field(G::addr, G::bytes), "not in the map");
+		return(G::get(buf + BMPxConst<uint8_t, offset(G::addr)>::value));
+	}
+
+	private:
+		static constexpr bool is_field(const uint8_t addr,
+				const uint8_t bytes)
+		{
+			const uint8_t a[] = { F::addr... };
+			const uint8_t n[] = { F::bytes... };
+
+			for (uint8_t i = 0; i < sizeof...(F); i++)
+				if ((a[i] == addr) && (n[i] == bytes))
+					return(true);
+
+			return(false);
+		}
+
+		template <uint8_t B, class D> static uint8_t burst(D &d,
+				uint8_t *buf, BMPxConst<bool, true>)
+		{
+			constexpr uint8_t s = start(B);
+			constexpr uint8_t n = end(s) - s;
+			uint8_t err;
+
+			err = d.read_regs(s, n, buf +
+					BMPxConst<uint8_t, offset(s)>::value);
+
+			if (!err)
+				err = burst<B + 1>(d, buf,
+						BMPxConst<bool, (B + 1 < bursts())>());
+
+			return(err);
+		}
+
+		template <uint8_t B, class D> static uint8_t burst(D &, uint8_t *,
+				BMPxConst<bool, false>)
+		{
+			return(0);
+		}
+};
+
+#endif
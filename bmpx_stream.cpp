@@ -0,0 +1,294 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmpx_stream.cpp
+ * \brief Sample stream of the family driver.
+ *
+ * The conversions run back to back, or one per slot of the rate,
+ * with a T conversion every t_every samples squeezed in before the
+ * slot. stream_poll() never waits: it fetches a finished conversion,
+ * delivers the sample, starts the next conversion and returns the
+ * ms to the next event, the caller sleeps or does something else.
+ * stream_run() is the blocking loop of it.
+ *
+ * Time is timer_cycles(), timer_init() must be called first, the
+ * sample time is the start of its pressure conversion.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "bmp180.h"
+#include "queue.h"
+#include "timer.h"
+
+/*! Waiting the slot of the next pressure conversion. */
+#define STREAM_IDLE 0
+/*! A temperature conversion running. */
+#define STREAM_T 1
+/*! A pressure conversion running. */
+#define STREAM_P 2
+/*! Failed transactions in a row stopping the stream. */
+#define STREAM_RETRY 8
+
+/*! The ms to wait for cycles, rounded down, at most 254. */
+static uint8_t stream_ms(const int32_t cycles)
+{
+	int32_t ms;
+
+	if (cycles <= 0)
+		return(0);
+
+	ms = cycles / (BMPX_TIMER_HZ / 1000);
+	return((ms < BMPX_STREAM_STOP) ? ms : BMPX_STREAM_STOP - 1);
+}
+
+/*! A conversion time in cycles. */
+static uint32_t stream_cycles(const uint8_t ms)
+{
+	return((uint32_t)ms * (BMPX_TIMER_HZ / 1000));
+}
+
+/*! Add the time since the last sample to the span, per sample as
+ * the timer wraps.
+ */
+static void stream_span(struct bmpx_stream_t *stream)
+{
+	stream->span_cycles += stream->start - stream->last;
+	stream->span_ms += stream->span_cycles / (BMPX_TIMER_HZ / 1000);
+	stream->span_cycles %= BMPX_TIMER_HZ / 1000;
+}
+
+/** Start a stream.
+ *
+ * The config fields of the stream are set by the caller, the
+ * stream memory must last until the stream is over. The first
+ * conversion starts at the next stream_poll().
+ *
+ * @param stream the config and the state.
+ * @param cb the delivery, called from stream_poll().
+ * @param ctx the first argument of cb.
+ * @return 0 - OK, 1 - invalid oss.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::start_stream(struct bmpx_stream_t *stream,
+		bmpx_stream_cb_t cb, void *ctx)
+{
+	if (resolution(stream->oss))
+		return(1);
+
+	stream->cb = cb;
+	stream->ctx = ctx;
+	stream->state = STREAM_IDLE;
+	stream->fails = 0;
+	stream->err = 0;
+	// T first
+	stream->t_left = 0;
+	stream->due = timer_cycles();
+	stream->samples = 0;
+	stream->temperatures = 0;
+	stream->errors = 0;
+	stream->late = 0;
+	stream->last = 0;
+	stream->span_ms = 0;
+	stream->span_cycles = 0;
+	return(0);
+}
+
+/** Run the stream, never waits.
+ *
+ * @param stream the stream started.
+ * @return the ms to the next event, BMPX_STREAM_STOP the stream is
+ * over: the count is reached, the callback stopped it or the
+ * sensor fails (stream->err).
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::stream_poll(struct bmpx_stream_t *stream)
+{
+	struct bmp180_sample_t sample;
+	uint32_t now;
+	int32_t left;
+	uint8_t err;
+
+	if (stream->state == BMPX_STREAM_STOP)
+		return(BMPX_STREAM_STOP);
+
+	now = timer_cycles();
+
+	if (stream->state != STREAM_IDLE) {
+		left = stream->ready - now;
+
+		if (left > 0)
+			return(stream_ms(left));
+
+		if (stream->state == STREAM_T) {
+			err = fetch_temperature();
+
+			if (!err) {
+				stream->temperatures++;
+				// t_every 0, never again
+				stream->t_left = stream->t_every ?
+					stream->t_every : 1;
+			}
+		} else {
+			err = Chip::fetch_all(*this);
+
+			if (!err) {
+				compensate();
+				sample.time = stream->start;
+				sample.p = p;
+				sample.T = T;
+
+				if (stream->samples)
+					stream_span(stream);
+
+				stream->last = stream->start;
+				stream->samples++;
+
+				if (stream->cb(stream->ctx, &sample) ||
+						(stream->samples == stream->count)) {
+					stream->state = BMPX_STREAM_STOP;
+					return(BMPX_STREAM_STOP);
+				}
+			}
+		}
+
+		stream->state = STREAM_IDLE;
+
+		if (err)
+			goto fail;
+
+		stream->fails = 0;
+	}
+
+	// the T before the slot, the BMP280 has it in every sample
+	if (!Chip::t_in_p && !stream->t_left) {
+		err = start_temperature();
+
+		if (err)
+			goto fail;
+
+		stream->ready = now + stream_cycles(conversion_ms(false));
+		stream->state = STREAM_T;
+		return(conversion_ms(false));
+	}
+
+	left = stream->due - now;
+
+	if (left > 0)
+		return(stream_ms(left));
+
+	err = start_pressure();
+
+	if (err)
+		goto fail;
+
+	if (stream->rate) {
+		// a whole slot behind, restart the slots from now
+		if ((uint32_t)-left >= BMPX_TIMER_HZ / stream->rate) {
+			stream->late++;
+			stream->due = now;
+		}
+
+		stream->due += BMPX_TIMER_HZ / stream->rate;
+	} else {
+		stream->due = now;
+	}
+
+	if (stream->t_every)
+		stream->t_left--;
+
+	stream->start = now;
+	stream->ready = now + stream_cycles(conversion_ms(true));
+	stream->state = STREAM_P;
+	return(conversion_ms(true));
+
+fail:
+	if (stream->errors != 0xffff)
+		stream->errors++;
+
+	if (++stream->fails == STREAM_RETRY) {
+		stream->err = err;
+		stream->state = BMPX_STREAM_STOP;
+		return(BMPX_STREAM_STOP);
+	}
+
+	// again in a ms: a failed start or T fetch is the same
+	// conversion, a failed p fetch drops its sample as due has
+	// moved on to the next slot
+	return(1);
+}
+
+/** Run the stream to its end, waiting with the driver's wait.
+ *
+ * @param stream the stream started.
+ * @return 0 - OK, the error which stopped the stream.
+ */
+template <class Chip>
+uint8_t BMPx<Chip>::stream_run(struct bmpx_stream_t *stream)
+{
+	uint8_t ms;
+
+	while ((ms = stream_poll(stream)) != BMPX_STREAM_STOP)
+		wait(ms);
+
+	return(stream->err);
+}
+
+/** Delivery in a queue, see queue.h.
+ *
+ * The samples of a full queue are dropped, the queue counts them.
+ *
+ * @param queue the struct queue_t.
+ * @param sample the sample.
+ * @return 0, the stream goes on.
+ */
+uint8_t bmpx_stream_queue(void *queue, const struct bmp180_sample_t *sample)
+{
+	queue_push((struct queue_t *)queue, sample);
+	return(0);
+}
+
+/** The samples per second of a stream.
+ *
+ * @param stream the stream, running or over.
+ * @return the average rate between the first and the last sample.
+ */
+float bmpx_stream_sps(const struct bmpx_stream_t *stream)
+{
+	float span;
+
+	span = stream->span_ms + (float)stream->span_cycles /
+		(BMPX_TIMER_HZ / 1000);
+
+	if ((stream->samples < 2) || !span)
+		return(0);
+
+	return((stream->samples - 1) * 1000.0f / span);
+}
+
+template uint8_t BMPx<BMP085Chip>::start_stream(struct bmpx_stream_t *,
+		bmpx_stream_cb_t, void *);
+template uint8_t BMPx<BMP085Chip>::stream_poll(struct bmpx_stream_t *);
+template uint8_t BMPx<BMP085Chip>::stream_run(struct bmpx_stream_t *);
+template uint8_t BMPx<BMP180Chip>::start_stream(struct bmpx_stream_t *,
+		bmpx_stream_cb_t, void *);
+template uint8_t BMPx<BMP180Chip>::stream_poll(struct bmpx_stream_t *);
+template uint8_t BMPx<BMP180Chip>::stream_run(struct bmpx_stream_t *);
+template uint8_t BMPx<BMP280Chip>::start_stream(struct bmpx_stream_t *,
+		bmpx_stream_cb_t, void *);
+template uint8_t BMPx<BMP280Chip>::stream_poll(struct bmpx_stream_t *);
+template uint8_t BMPx<BMP280Chip>::stream_run(struct bmpx_stream_t *);
@@ -0,0 +1,88 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "cic.h"
+
+/*! Init the filter.
+ *
+ * \param rate the log2 of the decimation, 0 .. CIC_RATE_MAX.
+ * \return 0 - OK, 1 - rate too high.
+ */
+uint8_t cic_init(struct cic_t *cic, const uint8_t rate)
+{
+	uint8_t i;
+
+	if (rate > CIC_RATE_MAX)
+		return(1);
+
+	for (i = 0; i < CIC_ORDER; i++) {
+		cic->integ[i] = 0;
+		cic->comb[i] = 0;
+	}
+
+	cic->rate = rate;
+	cic->count = 1 << rate;
+	cic->warm = CIC_ORDER;
+	cic->out = 0;
+	return(0);
+}
+
+/*! Filter an oss 0 UP.
+ *
+ * \return 1 - a new output in cic->out, 0 - none yet.
+ */
+uint8_t cic_put(struct cic_t *cic, const int32_t up)
+{
+	uint32_t x, y;
+	uint8_t i, shift;
+
+	x = (uint32_t)up;
+
+	for (i = 0; i < CIC_ORDER; i++) {
+		cic->integ[i] += x;
+		x = cic->integ[i];
+	}
+
+	if (--cic->count)
+		return(0);
+
+	cic->count = 1 << cic->rate;
+
+	for (i = 0; i < CIC_ORDER; i++) {
+		y = x - cic->comb[i];
+		cic->comb[i] = x;
+		x = y;
+	}
+
+	if (cic->warm) {
+		cic->warm--;
+		return(0);
+	}
+
+	/* gain 2^(order * rate), to the oss 3 scale */
+	shift = CIC_ORDER * cic->rate;
+
+	if (shift > CIC_OSS) {
+		shift -= CIC_OSS;
+		cic->out = (int32_t)((x + (1UL << (shift - 1))) >> shift);
+	} else {
+		cic->out = (int32_t)(x << (CIC_OSS - shift));
+	}
+
+	return(1);
+}
@@ -0,0 +1,74 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file cic.h
+ * \brief CIC decimator of the raw pressure.
+ *
+ * Sampling at oss 0 (5 ms) and decimating on the MCU gives the
+ * same or less noise than the chip oversampling at a chosen output
+ * rate. The filter is a CIC_ORDER integrator-comb cascade with
+ * decimation 2^rate, in modulo 2^32 arithmetic: the wrap of the
+ * integrators cancels in the combs as long as the output fits,
+ * 16 bit + CIC_ORDER * rate bit <= 32. Per input sample it costs
+ * CIC_ORDER 32 bit additions.
+ *
+ * host/cic_noise, datasheet noise model, order 2:
+ * oss 3 average of 32: 0.66 Pa RMS, 837 ms per output, 403 ms delay.
+ * oss 0 CIC rate 6:    0.68 Pa RMS, 325 ms per output, 315 ms delay.
+ *
+ * The output is UP at the oss 3 scale (19 bit), the 3 more bits
+ * come from the averaging, compensate it with oss 3.
+ */
+
+#ifndef _CIC_H_
+#define _CIC_H_
+
+#include <stdint.h>
+
+/*! Integrator-comb stages */
+#ifndef CIC_ORDER
+#define CIC_ORDER 2
+#endif
+
+/*! Max log2 of the decimation, the output fits in 32 bit */
+#if ((32 - 16) / CIC_ORDER) > 7
+#define CIC_RATE_MAX 7
+#else
+#define CIC_RATE_MAX ((32 - 16) / CIC_ORDER)
+#endif
+
+/*! The oss of the output scale */
+#define CIC_OSS 3
+
+/*! The filter state. */
+struct cic_t {
+	uint32_t integ[CIC_ORDER];
+	uint32_t comb[CIC_ORDER];
+	/*! log2 of the decimation. */
+	uint8_t rate;
+	/*! input samples to the next output. */
+	uint8_t count;
+	/*! outputs to discard, the combs are filling. */
+	uint8_t warm;
+	/*! last output, UP at oss 3 scale. */
+	int32_t out;
+};
+
+uint8_t cic_init(struct cic_t *cic, const uint8_t rate);
+uint8_t cic_put(struct cic_t *cic, const int32_t up);
+
+#endif
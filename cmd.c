@@ -0,0 +1,104 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uart.h"
+#include "cmd.h"
+
+/* the line being received */
+static char line[CMD_LINE_SIZE + 1];
+static uint8_t len;
+/* the line is too long, skip it up to the end */
+static uint8_t overflow;
+
+/* split the line in name and argument, run it */
+static uint8_t run(const struct cmd_t *cmds, const uint8_t n, void *ctx)
+{
+	char *arg, *end;
+	int32_t value;
+	uint8_t i;
+
+	value = CMD_NOARG;
+	arg = strchr(line, ' ');
+
+	if (arg) {
+		*arg++ = 0;
+
+		while (*arg == ' ')
+			arg++;
+
+		if (*arg) {
+			value = strtol(arg, &end, 10);
+
+			if (*end)
+				return(CMD_E_ARG);
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		if (!strcmp(line, cmds[i].name))
+			return(cmds[i].fn(ctx, value));
+
+	return(CMD_E_UNKNOWN);
+}
+
+/*! Run the commands received since the last call.
+ *
+ * \param cmds the command table.
+ * \param n the number of commands.
+ * \param ctx passed to the commands.
+ * \return the number of lines run.
+ */
+uint8_t cmd_poll(const struct cmd_t *cmds, const uint8_t n, void *ctx)
+{
+	char c, s[4];
+	uint8_t err, lines;
+
+	lines = 0;
+
+	while ((c = uart_getchar(0, 0))) {
+		if (c != '\n' && c != '\r') {
+			if (len < CMD_LINE_SIZE)
+				line[len++] = c;
+			else
+				overflow = 1;
+
+			continue;
+		}
+
+		if (!len)
+			continue;
+
+		line[len] = 0;
+		err = overflow ? CMD_E_LINE : run(cmds, n, ctx);
+		len = 0;
+		overflow = 0;
+		lines++;
+
+		if (err) {
+			uart_printstr(0, "err ");
+			uart_printstr(0, utoa(err, s, 10));
+			uart_printstr(0, "\n");
+		} else {
+			uart_printstr(0, "ok\n");
+		}
+	}
+
+	return(lines);
+}
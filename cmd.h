@@ -0,0 +1,75 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file cmd.h
+ * \brief Line commands on the UART RX.
+ *
+ * The RX interrupt (UART_RX_IRQ) stores the incoming chars while
+ * the main loop samples. cmd_poll(), called between samples,
+ * collects them into a line and, at the end of a line, runs the
+ * matching command of the table. Sampling never stops; a command
+ * takes effect from the next sample.
+ *
+ * A line is a name and an optional decimal argument:
+ *
+ * \code
+ * oss 2\n
+ * stat\n
+ * \endcode
+ *
+ * Every line gets one reply after the command output, "ok" or
+ * "err N" with the CMD_E_ code. Lines longer than CMD_LINE_SIZE are
+ * refused as a whole. Both "\n" and "\r" end a line, empty lines are
+ * ignored. Size the RX buffer for the commands arriving during the
+ * longest sample, 64 chars are a few lines.
+ */
+
+#ifndef _CMD_H_
+#define _CMD_H_
+
+#include <stdint.h>
+
+/*! Max line length, without the end of line */
+#ifndef CMD_LINE_SIZE
+#define CMD_LINE_SIZE 24
+#endif
+
+/*! The argument of a line without one */
+#define CMD_NOARG INT32_MIN
+
+/*! Command result codes */
+#define CMD_OK 0
+/*! No such command */
+#define CMD_E_UNKNOWN 1
+/*! Missing, malformed or out of range argument */
+#define CMD_E_ARG 2
+/*! Line too long */
+#define CMD_E_LINE 3
+
+/*! A command.
+ *
+ * fn gets the context given to cmd_poll() and the argument,
+ * CMD_NOARG if there is none, and returns a CMD_ code.
+ */
+struct cmd_t {
+	const char *name;
+	uint8_t (*fn)(void *ctx, const int32_t arg);
+};
+
+uint8_t cmd_poll(const struct cmd_t *cmds, const uint8_t n, void *ctx);
+
+#endif
@@ -0,0 +1,177 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "fmt.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define POW10(i) pgm_read_dword(&pow10[i])
+#else
+#define PROGMEM
+#define POW10(i) pow10[i]
+#endif
+
+/* 10^9 .. 10^4, the 32 bit digits */
+static const uint32_t pow10[] PROGMEM = {
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL
+};
+
+/* 10^3 .. 10^1, the 16 bit digits */
+static const uint16_t pow10_16[] = { 1000, 100, 10 };
+
+/* decimal digits of v, at least min (1..10) with leading zeros */
+static char *digits(char *s, uint32_t v, const uint8_t min)
+{
+	uint32_t p;
+	uint16_t w;
+	uint8_t i, first;
+	char c;
+
+	/* the first digit printed, the 10 - min or a non zero one */
+	first = 10 - min;
+
+	for (i = 0; i < 6; i++) {
+		p = POW10(i);
+		c = '0';
+
+		while (v >= p) {
+			v -= p;
+			c++;
+		}
+
+		if (c != '0' && i < first)
+			first = i;
+
+		if (i >= first)
+			*s++ = c;
+	}
+
+	w = v;
+
+	for (i = 0; i < 3; i++) {
+		c = '0';
+
+		while (w >= pow10_16[i]) {
+			w -= pow10_16[i];
+			c++;
+		}
+
+		if (c != '0' && i + 6 < first)
+			first = i + 6;
+
+		if (i + 6 >= first)
+			*s++ = c;
+	}
+
+	*s++ = '0' + w;
+	*s = 0;
+	return(s);
+}
+
+/*! Copy a string. */
+char *fmt_str(char *s, const char *str)
+{
+	while (*str)
+		*s++ = *str++;
+
+	*s = 0;
+	return(s);
+}
+
+/*! Unsigned decimal. */
+char *fmt_u32(char *s, uint32_t v)
+{
+	return(digits(s, v, 1));
+}
+
+/*! Signed decimal. */
+char *fmt_i32(char *s, const int32_t v)
+{
+	if (v < 0) {
+		*s++ = '-';
+		return(digits(s, -(uint32_t)v, 1));
+	}
+
+	return(digits(s, v, 1));
+}
+
+/*! Fixed point decimal.
+ *
+ * \param v the value in 10^-dec units, ex. T in 0.1 C with dec 1.
+ * \param dec the decimals, 0..9.
+ * \param width right aligned in width chars, 0 none.
+ */
+char *fmt_fix(char *s, const int32_t v, const uint8_t dec,
+		const uint8_t width)
+{
+	char *start, *e;
+	uint8_t i, len;
+
+	start = s;
+
+	if (v < 0)
+		*s++ = '-';
+
+	e = digits(s, (v < 0) ? -(uint32_t)v : (uint32_t)v, dec + 1);
+
+	/* make room for the point */
+	if (dec) {
+		for (i = 0; i <= dec; i++)
+			e[1 - i] = e[-i];
+
+		e[-dec] = '.';
+		e++;
+	}
+
+	len = e - start;
+
+	if (len >= width)
+		return(e);
+
+	/* right align */
+	for (i = 0; i <= len; i++)
+		start[width - i] = start[len - i];
+
+	for (i = 0; i < width - len; i++)
+		start[i] = ' ';
+
+	return(start + width);
+}
+
+/*! Hex, no leading zeros. */
+char *fmt_hex(char *s, const uint16_t v)
+{
+	uint8_t shift, d, lead;
+
+	lead = 1;
+
+	for (shift = 12; shift; shift -= 4) {
+		d = (v >> shift) & 0xf;
+
+		if (d)
+			lead = 0;
+
+		if (!lead)
+			*s++ = d + ((d < 10) ? '0' : 'a' - 10);
+	}
+
+	d = v & 0xf;
+	*s++ = d + ((d < 10) ? '0' : 'a' - 10);
+	*s = 0;
+	return(s);
+}
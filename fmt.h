@@ -0,0 +1,53 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file fmt.h
+ * \brief Number formatting into a caller buffer, no division.
+ *
+ * A whole output line is built in one buffer and sent with a
+ * single uart_printstr(). Every function writes at s, NUL
+ * terminates and returns the position of the NUL, where the next
+ * field goes:
+ *
+ * \code
+ * e = fmt_u32(line, p);
+ * e = fmt_str(e, " ");
+ * e = fmt_fix(e, T, 1, 0);
+ * \endcode
+ *
+ * The digits come from subtracting the powers of ten, at most 9
+ * times a digit, 32 bit for the top digits and 16 bit below 10^4.
+ * The AVR has no divide instruction and itoa()/ultoa() call the
+ * libgcc division once per digit. No float, no heap.
+ *
+ * Max length: fmt_u32() 10, fmt_i32() 11, fmt_fix() 12 chars or
+ * the width, plus the NUL.
+ */
+
+#ifndef _FMT_H_
+#define _FMT_H_
+
+#include <stdint.h>
+
+char *fmt_str(char *s, const char *str);
+char *fmt_u32(char *s, uint32_t v);
+char *fmt_i32(char *s, const int32_t v);
+char *fmt_fix(char *s, const int32_t v, const uint8_t dec,
+		const uint8_t width);
+char *fmt_hex(char *s, const uint16_t v);
+
+#endif
@@ -0,0 +1,224 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "fusion.h"
+
+/* defaults, change them after fusion_init() */
+#define SKEW 100
+#define REJECT 50
+#define SHIFT 6
+/* the trend smoothing, 2^-TREND_SHIFT per output */
+#define TREND_SHIFT 4
+
+/*! Init the fusion of n sensors, 0 .. n - 1.
+ *
+ * skew 100 ticks, reject 50 Pa, shift 6, every weight 1.
+ * \return 0 - OK, 1 - n too high.
+ */
+uint8_t fusion_init(struct fusion_t *fusion, const uint8_t n)
+{
+	uint8_t i;
+
+	if (n > FUSION_SIZE)
+		return(1);
+
+	for (i = 0; i < FUSION_SIZE; i++) {
+		fusion->p[i] = 0;
+		fusion->off[i] = 0;
+		fusion->t[i] = 0;
+		fusion->weight[i] = 1;
+		fusion->outliers[i] = 0;
+	}
+
+	fusion->n = n;
+	fusion->fresh = 0;
+	fusion->used = 0;
+	fusion->shift = SHIFT;
+	fusion->skew = SKEW;
+	fusion->reject = REJECT;
+	fusion->out = 0;
+	fusion->t_out = 0;
+	fusion->trend = 0;
+	fusion->outputs = 0;
+	return(0);
+}
+
+/*! A sample of sensor i read at t, p in Pa. */
+void fusion_put(struct fusion_t *fusion, const uint8_t i,
+		const uint16_t t, const int32_t p)
+{
+	if (i >= fusion->n)
+		return;
+
+	fusion->p[i] = p;
+	fusion->t[i] = t;
+	fusion->fresh |= 1 << i;
+}
+
+/* x >> shift rounded */
+static int32_t rshift(const int32_t x, const uint8_t shift)
+{
+	if (!shift)
+		return(x);
+
+	return((x + (1L << (shift - 1))) >> shift);
+}
+
+/*! Fuse the samples put since the last output, at time t.
+ *
+ * \param p the output, Pa, unchanged if no sample.
+ * \return the sensors voting for the output, 0 - no sample.
+ */
+uint8_t fusion_get(struct fusion_t *fusion, const uint16_t t, int32_t *p)
+{
+	int32_t v[FUSION_SIZE], s[FUSION_SIZE];
+	int32_t med, d, lim, sum, out, best;
+	uint16_t age, wsum;
+	uint8_t i, j, k, mask, used, voters;
+
+	/* aligned and offset free samples, sorted in s */
+	k = 0;
+	mask = 0;
+
+	for (i = 0; i < fusion->n; i++) {
+		age = t - fusion->t[i];
+
+		if (!(fusion->fresh & (1 << i)) || (age > fusion->skew))
+			continue;
+
+		d = (fusion->p[i] << FUSION_FRAC) - fusion->off[i] +
+			((fusion->trend * (int32_t)age) >> 8);
+		v[i] = d;
+
+		for (j = k; j && (s[j - 1] > d); j--)
+			s[j] = s[j - 1];
+
+		s[j] = d;
+		k++;
+		mask |= 1 << i;
+	}
+
+	fusion->fresh = 0;
+
+	if (!k)
+		return(0);
+
+	if (k & 1)
+		med = s[k >> 1];
+	else
+		med = (s[(k >> 1) - 1] + s[k >> 1]) >> 1;
+
+	/* vote */
+	lim = (int32_t)fusion->reject << FUSION_FRAC;
+	sum = 0;
+	wsum = 0;
+	used = 0;
+	voters = 0;
+
+	for (i = 0; i < fusion->n; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+
+		d = v[i] - med;
+
+		if ((d > lim) || (d < -lim))
+			continue;
+
+		sum += (int32_t)fusion->weight[i] * d;
+		wsum += fusion->weight[i];
+		used |= 1 << i;
+		voters++;
+	}
+
+	/* none near the median, 2 sensors apart: continuity */
+	if (!voters && fusion->outputs) {
+		out = fusion->out + ((fusion->trend *
+					(int32_t)(uint16_t)(t - fusion->t_out)) >> 8);
+		best = 0;
+
+		for (i = 0; i < fusion->n; i++) {
+			if (!(mask & (1 << i)))
+				continue;
+
+			d = v[i] - out;
+
+			if (d < 0)
+				d = -d;
+
+			if (!voters || (d < best)) {
+				best = d;
+				used = 1 << i;
+				med = v[i];
+				voters = 1;
+			}
+		}
+	} else if (!voters) {
+		used = mask;
+		voters = k;
+	}
+
+	out = med;
+
+	if (wsum)
+		out += sum / (int16_t)wsum;
+
+	/* learn the offsets, the outliers by at most lim */
+	sum = 0;
+
+	for (i = 0; i < fusion->n; i++) {
+		if (mask & (1 << i)) {
+			if (!(used & (1 << i)))
+				fusion->outliers[i]++;
+
+			d = v[i] - out;
+
+			if (d > lim)
+				d = lim;
+			else if (d < -lim)
+				d = -lim;
+
+			fusion->off[i] += rshift(d, fusion->shift);
+		}
+
+		sum += fusion->off[i];
+	}
+
+	/* the offsets sum to zero */
+	sum /= fusion->n;
+
+	for (i = 0; i < fusion->n; i++)
+		fusion->off[i] -= sum;
+
+	if (fusion->outputs) {
+		age = t - fusion->t_out;
+
+		if (age) {
+			d = ((out - fusion->out) << 8) / age;
+			fusion->trend += rshift(d - fusion->trend, TREND_SHIFT);
+		}
+	}
+
+	if (fusion->outputs < 0xff)
+		fusion->outputs++;
+
+	fusion->out = out;
+	fusion->t_out = t;
+	fusion->used = used;
+	*p = rshift(out, FUSION_FRAC);
+	return(voters);
+}
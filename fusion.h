@@ -0,0 +1,101 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file fusion.h
+ * \brief One pressure out of 2 to FUSION_SIZE sensors.
+ *
+ * Every sensor read is put with its timestamp, then once per
+ * sample period fusion_get() votes on the samples put since the
+ * last output:
+ *
+ * align: a sample older than skew ticks is not used, the younger
+ *   ones are moved to the output time along the pressure trend of
+ *   the last outputs.
+ * offset: the offset learned of each sensor is removed. It is the
+ *   average of the sensor's difference from the output, learned at
+ *   2^-shift per output, and the offsets sum to zero: the output is
+ *   on the average scale of the sensors.
+ * vote: the samples farther than reject Pa from their median are
+ *   outliers, the output is the weighted mean of the others. With 2
+ *   sensors not agreeing the one closer to the last output wins.
+ *
+ * The weight of a sensor is the inverse of its noise variance,
+ * ex. 4, 6, 9, 16 for oss 0 .. 3 (6, 5, 4, 3 Pa RMS), 1 to 255.
+ * An outlier learns its offset too, by at most reject Pa per
+ * output, so a sensor with a large real offset joins the vote after
+ * some outputs and a single spike moves it by little.
+ *
+ * The pressures are in Pa / 2^FUSION_FRAC, the arithmetic is 32 bit
+ * with two divisions per output, see "fusion" in bench.c.
+ *
+ * host/fusion_noise, datasheet noise model, 4 sensors at oss 1, one
+ * spiking 1% of its samples:
+ * single sensor 5.07 Pa RMS, mean 16.7, median 4.12, fusion 2.54.
+ */
+
+#ifndef _FUSION_H_
+#define _FUSION_H_
+
+#include <stdint.h>
+
+/*! Max sensors */
+#ifndef FUSION_SIZE
+#define FUSION_SIZE 4
+#endif
+
+/*! Fraction bits of the pressures */
+#define FUSION_FRAC 4
+
+/*! The fusion state. */
+struct fusion_t {
+	/*! per sensor: the last sample, Pa. */
+	int32_t p[FUSION_SIZE];
+	/*! per sensor: the offset, Pa / 2^FUSION_FRAC. */
+	int32_t off[FUSION_SIZE];
+	/*! per sensor: the timestamp of the sample, ticks. */
+	uint16_t t[FUSION_SIZE];
+	/*! per sensor: the vote weight, 1 .. 255. */
+	uint8_t weight[FUSION_SIZE];
+	/*! per sensor: the times it was an outlier. */
+	uint16_t outliers[FUSION_SIZE];
+	/*! sensors. */
+	uint8_t n;
+	/*! mask of the samples put since the last output. */
+	uint8_t fresh;
+	/*! mask of the sensors in the last output. */
+	uint8_t used;
+	/*! offset learning rate, 2^-shift per output. */
+	uint8_t shift;
+	/*! max age of a sample, ticks. */
+	uint16_t skew;
+	/*! outlier distance from the median, Pa. */
+	uint16_t reject;
+	/*! last output, Pa / 2^FUSION_FRAC, and its time. */
+	int32_t out;
+	uint16_t t_out;
+	/*! the pressure trend, Pa / 2^FUSION_FRAC per 256 ticks. */
+	int32_t trend;
+	/*! outputs done, max 255. */
+	uint8_t outputs;
+};
+
+uint8_t fusion_init(struct fusion_t *fusion, const uint8_t n);
+void fusion_put(struct fusion_t *fusion, const uint8_t i,
+		const uint16_t t, const int32_t p);
+uint8_t fusion_get(struct fusion_t *fusion, const uint16_t t, int32_t *p);
+
+#endif
@@ -0,0 +1,264 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*! \file bench_co.cpp
+ * \brief Sensors per core, coroutines against thread per sensor.
+ *
+ * bench_co [-m co|thread] [-n sensors] [-r rate_hz] [-o oss]
+ *	[-t seconds]
+ *
+ * Every sensor is a simulated BMP180 on its own bus (i2c_sim.cpp)
+ * sampled at rate_hz on an absolute schedule, the starts are spread
+ * over the period. co runs all of them on one thread with
+ * BMP180Co and a TimerWheel, thread runs the blocking read_all()
+ * in one thread per sensor.
+ *
+ * Printed: mode sensors rate samples late(>1 period) p99_late_ms
+ * cpu_s wall_s sensors_per_core maxrss_kb
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+#include "bmp180.h"
+#include "i2c_sim.h"
+#include "bmp180_co.h"
+
+struct stats_t {
+	uint64_t samples;
+	uint64_t late;
+	/* lateness histogram, 0.1 ms bins */
+	uint32_t hist[1000];
+};
+
+static uint32_t nsensors = 100, rate = 10, seconds = 5;
+static uint8_t oss = BMP180_RES_ULTRAHIGH;
+static struct timespec epoch;
+
+static double ms_since(const struct timespec *t0)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((ts.tv_sec - t0->tv_sec) * 1e3 +
+			(ts.tv_nsec - t0->tv_nsec) / 1e6);
+}
+
+static void account(struct stats_t *st, double late_ms, double period_ms)
+{
+	uint32_t bin;
+
+	st->samples++;
+
+	if (late_ms >= period_ms)
+		st->late++;
+
+	bin = (late_ms < 0) ? 0 : (uint32_t)(late_ms * 10);
+	st->hist[std::min(bin, 999U)]++;
+}
+
+static double p99(const struct stats_t *st)
+{
+	uint64_t n = 0;
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		n += st->hist[i];
+
+		if (n * 100 >= st->samples * 99)
+			return(i / 10.0);
+	}
+
+	return(100.0);
+}
+
+/* coroutine mode */
+
+static Detached sample(BMP180Co &co, TimerWheel &wheel, uint32_t phase,
+		struct stats_t *st)
+{
+	uint64_t next, period, end;
+
+	period = 1000 / rate;
+	next = phase;
+	end = seconds * 1000;
+
+	while (next < end) {
+		co_await wheel.sleep_until(next);
+		/* the tick n starts at epoch + n ms */
+		account(st, ms_since(&epoch) - next, period);
+		co_await co.read_all();
+		next += period;
+	}
+}
+
+static void run_co(struct stats_t *st)
+{
+	std::vector<struct i2c_bus_t> bus(nsensors);
+	std::vector<BMP180 *> sensor(nsensors);
+	std::vector<BMP180Co *> co(nsensors);
+	TimerWheel wheel;
+
+	for (uint32_t i = 0; i < nsensors; i++) {
+		i2c_sim_init(&bus[i]);
+		sensor[i] = new BMP180(BMP180_ADDR, &bus[i]);
+		sensor[i]->resolution(oss);
+		co[i] = new BMP180Co(*sensor[i], wheel);
+	}
+
+	/* the wheel epoch */
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+
+	for (uint32_t i = 0; i < nsensors; i++)
+		sample(*co[i], wheel, 1 + i * (1000 / rate) / nsensors, st);
+
+	wheel.run();
+
+	for (uint32_t i = 0; i < nsensors; i++) {
+		delete co[i];
+		delete sensor[i];
+	}
+}
+
+/* thread per sensor mode */
+
+struct worker_t {
+	pthread_t tid;
+	uint32_t phase;
+	struct i2c_bus_t bus;
+	struct stats_t st;
+};
+
+static void *worker(void *arg)
+{
+	struct worker_t *w = (struct worker_t *)arg;
+	struct timespec ts;
+	uint64_t next, period, end, ns;
+
+	BMP180 sensor(BMP180_ADDR, &w->bus);
+	sensor.resolution(oss);
+	period = 1000 / rate;
+	next = w->phase;
+	end = seconds * 1000;
+
+	while (next < end) {
+		ns = (uint64_t)epoch.tv_nsec + next * 1000000ULL;
+		ts.tv_sec = epoch.tv_sec + ns / 1000000000ULL;
+		ts.tv_nsec = ns % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		account(&w->st, ms_since(&epoch) - next, period);
+		sensor.read_all();
+		next += period;
+	}
+
+	return(NULL);
+}
+
+static void run_thread(struct stats_t *st)
+{
+	std::vector<struct worker_t> w(nsensors);
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 64 * 1024);
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+
+	for (uint32_t i = 0; i < nsensors; i++) {
+		memset(&w[i].st, 0, sizeof(w[i].st));
+		i2c_sim_init(&w[i].bus);
+		w[i].phase = 1 + i * (1000 / rate) / nsensors;
+
+		if (pthread_create(&w[i].tid, &attr, worker, &w[i])) {
+			fprintf(stderr, "thread %u: cannot create\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (uint32_t i = 0; i < nsensors; i++) {
+		pthread_join(w[i].tid, NULL);
+		st->samples += w[i].st.samples;
+		st->late += w[i].st.late;
+
+		for (uint32_t j = 0; j < 1000; j++)
+			st->hist[j] += w[i].st.hist[j];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static struct stats_t st;
+	struct rusage ru;
+	struct timespec t0;
+	const char *mode = "co";
+	double cpu, wall;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:n:r:o:t:")) != -1) {
+		switch (opt) {
+			case 'm':
+				mode = optarg;
+				break;
+			case 'n':
+				nsensors = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				rate = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				oss = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				seconds = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-m co|thread] "
+						"[-n sensors] [-r rate_hz] "
+						"[-o oss] [-t seconds]\n",
+						argv[0]);
+				return(EXIT_FAILURE);
+		}
+	}
+
+	if (!nsensors || !rate || (rate > 20) || !seconds ||
+			(oss > BMP180_RES_ULTRAHIGH)) {
+		fprintf(stderr, "sensors > 0, rate 1..20, oss 0..3\n");
+		return(EXIT_FAILURE);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	if (!strcmp(mode, "thread"))
+		run_thread(&st);
+	else
+		run_co(&st);
+
+	wall = ms_since(&t0) / 1e3;
+	getrusage(RUSAGE_SELF, &ru);
+	cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	printf("%s %u %u %llu %llu %.1f %.2f %.2f %.0f %ld\n", mode,
+			nsensors, rate, (unsigned long long)st.samples,
+			(unsigned long long)st.late, p99(&st), cpu, wall,
+			nsensors * wall / cpu, ru.ru_maxrss);
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,241 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench_faults.cpp
+ * \brief read_all() latency and recovery on a faulty bus.
+ *
+ * bench_faults [-n samples] [-o oss] [-r retries] [-f faults]
+ *
+ * A simulated BMP180 on an i2c_sim.cpp bus injecting faults, on a
+ * virtual clock: the conversion waits and the bus time are counted,
+ * not slept. Every sample is a read_all() retried up to retries
+ * times, after a lost bus (TW_MT_ARB_LOST, TW_NO_INFO) the bus is
+ * recovered first. The run is repeated for each fault mix, or only
+ * for -f, ex. -f nack_addr=1000,stretch=5000,stretch_us=200.
+ *
+ * Printed per mix, ms: the read_all() latency p50 p99 p99.9 max of
+ * the samples, the recovery time from the first failure to the
+ * sample read p50 p99 max, the reads failed, the samples given up
+ * and the silent ones (a value not the simulated one, no error).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <util/twi.h>
+#include <util/delay.h>
+#include <algorithm>
+#include <vector>
+#include "bmp180.h"
+#include "i2c_sim.h"
+
+struct mix_t {
+	const char *name;
+	struct i2c_sim_fault_t fault;
+};
+
+/* ppm: nack_addr nack_data arb_lost stuck stretch corrupt,
+ * stretch_us timeout_us
+ */
+static const struct mix_t mixes[] = {
+	{ "none", { 0, 0, 0, 0, 0, 0, 0, 0 } },
+	{ "nack_addr", { 10000, 0, 0, 0, 0, 0, 0, 0 } },
+	{ "nack_data", { 0, 10000, 0, 0, 0, 0, 0, 0 } },
+	{ "arb_lost", { 0, 0, 10000, 0, 0, 0, 0, 0 } },
+	{ "stuck", { 0, 0, 0, 1000, 0, 0, 0, 0 } },
+	{ "stretch", { 0, 0, 0, 0, 100000, 0, 100, 0 } },
+	{ "timeout", { 0, 0, 0, 0, 10000, 0, 2000, 1000 } },
+	{ "corrupt", { 0, 0, 0, 0, 0, 1000, 0, 0 } },
+	{ "all", { 2500, 2500, 2500, 250, 25000, 250, 100, 0 } },
+};
+
+/* the virtual clock, us */
+static double vnow;
+
+static void advance(double us)
+{
+	vnow += us;
+}
+
+static uint64_t vclock(void)
+{
+	return((uint64_t)vnow);
+}
+
+/*! name=value,... on f, 0 - OK. */
+static int parse(char *spec, struct i2c_sim_fault_t *f)
+{
+	char *tok, *eq;
+	uint32_t v;
+
+	memset(f, 0, sizeof(*f));
+
+	for (tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+		eq = strchr(tok, '=');
+
+		if (!eq)
+			return(1);
+
+		*eq = 0;
+		v = strtoul(eq + 1, NULL, 0);
+
+		if (!strcmp(tok, "nack_addr"))
+			f->nack_addr = v;
+		else if (!strcmp(tok, "nack_data"))
+			f->nack_data = v;
+		else if (!strcmp(tok, "arb_lost"))
+			f->arb_lost = v;
+		else if (!strcmp(tok, "stuck"))
+			f->stuck = v;
+		else if (!strcmp(tok, "stretch"))
+			f->stretch = v;
+		else if (!strcmp(tok, "corrupt"))
+			f->corrupt = v;
+		else if (!strcmp(tok, "stretch_us"))
+			f->stretch_us = v;
+		else if (!strcmp(tok, "timeout_us"))
+			f->timeout_us = v;
+		else
+			return(1);
+	}
+
+	return(0);
+}
+
+/*! The q quantile of v, sorted, in ms. */
+static double quantile(const std::vector<double> &v, double q)
+{
+	if (v.empty())
+		return(0);
+
+	return(v[std::min(v.size() - 1, (size_t)(q * v.size()))] / 1e3);
+}
+
+static void run(const struct mix_t *mix, uint32_t samples, uint8_t oss,
+		uint32_t retries)
+{
+	struct i2c_bus_t bus;
+	std::vector<double> lat, rec;
+	uint32_t failed = 0, gaveup = 0, silent = 0;
+	double t0, tfail;
+	uint8_t err;
+
+	i2c_sim_init(&bus);
+	bus.sim.noise = 0;
+	bus.sim.clock = vclock;
+	// the calibration read on a good bus
+	BMP180 sensor(BMP180_ADDR, &bus);
+	sensor.resolution(oss);
+	i2c_sim_faults(&bus, &mix->fault, 0x2545f491);
+
+	for (uint32_t n = 0; n < samples; n++) {
+		t0 = vnow;
+		tfail = -1;
+		err = 0;
+
+		for (uint32_t i = 0; i <= retries; i++) {
+			err = sensor.read_all();
+
+			if (!err)
+				break;
+
+			failed++;
+
+			if (tfail < 0)
+				tfail = vnow;
+
+			if ((err == TW_MT_ARB_LOST) || (err == TW_NO_INFO))
+				sensor.recover();
+		}
+
+		lat.push_back(vnow - t0);
+
+		if (err)
+			gaveup++;
+		else if (tfail >= 0)
+			rec.push_back(vnow - tfail);
+
+		if (!err && ((sensor.p != bus.sim.p) || (sensor.T != bus.sim.T)))
+			silent++;
+	}
+
+	std::sort(lat.begin(), lat.end());
+	std::sort(rec.begin(), rec.end());
+	printf("%-10s %7.2f %7.2f %7.2f %7.2f  %7.2f %7.2f %7.2f  %6u %5u %6u\n",
+			mix->name, quantile(lat, 0.5), quantile(lat, 0.99),
+			quantile(lat, 0.999), quantile(lat, 1),
+			quantile(rec, 0.5), quantile(rec, 0.99),
+			quantile(rec, 1), failed, gaveup, silent);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n samples] [-o oss] [-r retries] "
+			"[-f faults]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct mix_t custom = { "custom", {} };
+	uint32_t samples = 10000, retries = 3;
+	uint8_t oss = BMP180_RES_ULTRAHIGH;
+	bool one = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:o:r:f:")) != -1) {
+		switch (opt) {
+			case 'n':
+				samples = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				oss = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				retries = strtoul(optarg, NULL, 0);
+				break;
+			case 'f':
+				if (parse(optarg, &custom.fault))
+					usage(argv[0]);
+
+				one = true;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (!samples || (oss > BMP180_RES_ULTRAHIGH))
+		usage(argv[0]);
+
+	host_delay_hook = advance;
+	printf("# %u samples, oss %u, %u retries, ms\n", samples, oss,
+			retries);
+	printf("# mix        lat_p50 lat_p99 lat_p999 lat_max  "
+			"rec_p50 rec_p99 rec_max  failed gaveup silent\n");
+
+	if (one) {
+		run(&custom, samples, oss, retries);
+	} else {
+		for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++)
+			run(&mixes[i], samples, oss, retries);
+	}
+
+	return(EXIT_SUCCESS);
+}
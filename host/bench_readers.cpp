@@ -0,0 +1,235 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench_readers.cpp
+ * \brief Readers contention of SharedSensor, seqlock against mutex.
+ *
+ * bench_readers [-m seqlock|mutex] [-n max_readers] [-r rate_hz]
+ *	[-o oss] [-t seconds]
+ *
+ * A simulated BMP180 (i2c_sim.cpp) sampled at rate_hz, 1, 2, 4 ..
+ * max_readers threads read the latest sample in a tight loop. A
+ * torn sample is one whose altitude is not the one of its p, or
+ * older than the last one read by the same thread.
+ *
+ * Printed per run: mode readers reads_per_s ns_per_read retries
+ * torn samples put_max_us
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include "bmp180.h"
+#include "i2c_sim.h"
+#include "bmp180_mt.h"
+
+/*! The mutex publication, the baseline. */
+template <class T>
+class Locked {
+	pthread_mutex_t lock;
+	T data;
+	uint32_t seq;
+	public:
+		Locked() : seq{0}
+		{
+			pthread_mutex_init(&lock, NULL);
+		}
+
+		~Locked()
+		{
+			pthread_mutex_destroy(&lock);
+		}
+
+		void put(const T &value)
+		{
+			pthread_mutex_lock(&lock);
+			data = value;
+			seq++;
+			pthread_mutex_unlock(&lock);
+		}
+
+		bool try_get(T &value) const
+		{
+			pthread_mutex_lock((pthread_mutex_t *)&lock);
+			value = data;
+			pthread_mutex_unlock((pthread_mutex_t *)&lock);
+			return(true);
+		}
+
+		uint32_t version() const
+		{
+			uint32_t v;
+
+			pthread_mutex_lock((pthread_mutex_t *)&lock);
+			v = seq;
+			pthread_mutex_unlock((pthread_mutex_t *)&lock);
+			return(v);
+		}
+};
+
+struct reader_t {
+	pthread_t thread;
+	const void *sensor;
+	uint64_t reads;
+	uint64_t retries;
+	uint64_t torn;
+};
+
+static std::atomic<bool> go, running;
+
+template <class Shared> static void *reader(void *arg)
+{
+	struct reader_t *r = (struct reader_t *)arg;
+	const Shared *sensor = (const Shared *)r->sensor;
+	typename Shared::sample_t s;
+	uint64_t n = 0;
+
+	while (!go);
+
+	while (running) {
+		if (!sensor->latest(s, &r->retries))
+			continue;
+
+		r->reads++;
+
+		if ((s.altitude != bmp180_math_altitude(s.p, BMP180_SEALEVEL))
+				|| (s.n < n))
+			r->torn++;
+
+		n = s.n;
+	}
+
+	return(NULL);
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+template <class Shared> static int bench(const char *mode, uint32_t readers,
+		uint32_t rate, uint8_t oss, uint32_t seconds)
+{
+	struct i2c_bus_t bus;
+	struct reader_t *r;
+	uint64_t reads = 0, retries = 0, torn = 0;
+	double t0, t;
+
+	i2c_sim_init(&bus);
+	Shared sensor(&bus);
+
+	if (!sensor.present() || sensor.start(oss, rate)) {
+		fprintf(stderr, "no sensor\n");
+		return(1);
+	}
+
+	r = (struct reader_t *)calloc(readers, sizeof(*r));
+	go = false;
+	running = true;
+
+	for (uint32_t i = 0; i < readers; i++) {
+		r[i].sensor = &sensor;
+		pthread_create(&r[i].thread, NULL, reader<Shared>, &r[i]);
+	}
+
+	// the first sample, then the readers start together
+	while (!sensor.samples())
+		usleep(1000);
+
+	t0 = now_s();
+	go = true;
+	usleep(seconds * 1000000);
+	running = false;
+	t = now_s() - t0;
+
+	for (uint32_t i = 0; i < readers; i++) {
+		pthread_join(r[i].thread, NULL);
+		reads += r[i].reads;
+		retries += r[i].retries;
+		torn += r[i].torn;
+	}
+
+	sensor.stop();
+	printf("%s %u %.0f %.1f %llu %llu %u %.1f\n", mode, readers, reads / t,
+			t * 1e9 * readers / (reads ? reads : 1),
+			(unsigned long long)retries, (unsigned long long)torn,
+			sensor.samples(), sensor.put_max_ns() / 1e3);
+	fflush(stdout);
+	free(r);
+	return(torn ? 1 : 0);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-m seqlock|mutex] [-n max_readers] "
+			"[-r rate_hz] [-o oss] [-t seconds]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode = "seqlock";
+	uint32_t max = 64, rate = 50, seconds = 1;
+	uint8_t oss = BMP180_RES_LOW;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "m:n:r:o:t:")) != -1) {
+		switch (opt) {
+			case 'm':
+				mode = optarg;
+				break;
+			case 'n':
+				max = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				rate = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				oss = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				seconds = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (strcmp(mode, "seqlock") && strcmp(mode, "mutex"))
+		usage(argv[0]);
+
+	printf("# mode readers reads_per_s ns_per_read retries torn "
+			"samples put_max_us\n");
+
+	for (uint32_t n = 1; n <= max; n <<= 1)
+		if (!strcmp(mode, "seqlock"))
+			ret |= bench<SharedSensor<BMP180, Seqlock> >(mode, n,
+					rate, oss, seconds);
+		else
+			ret |= bench<SharedSensor<BMP180, Locked> >(mode, n,
+					rate, oss, seconds);
+
+	return(ret ? EXIT_FAILURE : EXIT_SUCCESS);
+}
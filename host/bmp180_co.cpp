@@ -0,0 +1,152 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include "bmp180_co.h"
+
+TimerWheel::TimerWheel() : tick{0}, pending{0}, running{false}
+{
+	for (uint16_t i = 0; i < slots; i++)
+		slot[i] = nullptr;
+
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+}
+
+/*! Sleep at least ms.
+ *
+ * The current tick is already partly elapsed, one more is added.
+ */
+TimerWheel::Sleep TimerWheel::sleep_for(uint32_t ms)
+{
+	return(Sleep(*this, tick + ms + 1));
+}
+
+void TimerWheel::add(Timer *t)
+{
+	Timer **s;
+
+	s = &slot[t->tick & (slots - 1)];
+	t->next = *s;
+	*s = t;
+	pending++;
+}
+
+/* a timer of this slot expires at tick t */
+bool TimerWheel::due(uint64_t t) const
+{
+	for (Timer *r = slot[t & (slots - 1)]; r; r = r->next)
+		if (r->tick <= t)
+			return(true);
+
+	return(false);
+}
+
+/* resume the timers of this tick */
+void TimerWheel::expire()
+{
+	Timer **t, *ready, *r;
+
+	ready = nullptr;
+	t = &slot[tick & (slots - 1)];
+
+	/* unlink first, a resumed coroutine can add to this slot */
+	while (*t) {
+		if ((*t)->tick <= tick) {
+			r = *t;
+			*t = r->next;
+			r->next = ready;
+			ready = r;
+			pending--;
+		} else {
+			t = &(*t)->next;
+		}
+	}
+
+	while (ready) {
+		r = ready;
+		ready = r->next;
+		r->h.resume();
+	}
+}
+
+/*! Run the timers until there are none or stop().
+ *
+ * The thread sleeps until the next tick with a timer, if it falls
+ * behind the ticks are run back to back until it is on time again.
+ */
+void TimerWheel::run()
+{
+	struct timespec ts;
+	uint64_t ns;
+
+	running = true;
+
+	while (running && pending) {
+		tick++;
+
+		/* skip the empty ticks, up to a round */
+		for (uint16_t i = 1; (i < slots) && !due(tick); i++)
+			tick++;
+
+		ns = (uint64_t)epoch.tv_nsec + tick * 1000000ULL;
+		ts.tv_sec = epoch.tv_sec + ns / 1000000000ULL;
+		ts.tv_nsec = ns % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		expire();
+	}
+}
+
+Task<uint8_t> BMP180Co::read_temperature()
+{
+	uint8_t err;
+
+	err = sensor.start_temperature();
+
+	if (!err) {
+		co_await wheel.sleep_for(sensor.conversion_ms(false));
+		err = sensor.fetch_temperature();
+	}
+
+	co_return(err);
+}
+
+Task<uint8_t> BMP180Co::read_pressure()
+{
+	uint8_t err;
+
+	err = sensor.start_pressure();
+
+	if (!err) {
+		co_await wheel.sleep_for(sensor.conversion_ms(true));
+		err = sensor.fetch_pressure();
+	}
+
+	co_return(err);
+}
+
+Task<uint8_t> BMP180Co::read_all()
+{
+	uint8_t err;
+
+	err = co_await read_temperature();
+
+	if (!err)
+		err = co_await read_pressure();
+
+	co_return(err);
+}
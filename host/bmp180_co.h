@@ -0,0 +1,175 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_co.h
+ * \brief C++20 coroutines over the BMP180 driver, host only.
+ *
+ * co_await sensor.read_all() runs the same register sequences of
+ * the blocking read_all(), through start_*() and fetch_*(), but the
+ * conversion time suspends the coroutine on a TimerWheel instead of
+ * sleeping. One thread running TimerWheel::run() drives any number
+ * of sensors, on any number of buses.
+ *
+ * The i2c transactions are still blocking, a few hundred us each on
+ * a real 400Khz bus, the waits are the ms long part.
+ */
+
+#ifndef _BMP180_CO_H_
+#define _BMP180_CO_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <coroutine>
+#include <exception>
+#include "bmp180.h"
+
+/*! A lazy coroutine returning T, started when awaited. */
+template <class T>
+class Task {
+	public:
+		struct promise_type;
+		using handle = std::coroutine_handle<promise_type>;
+
+		struct promise_type {
+			T value;
+			std::coroutine_handle<> next;
+
+			Task get_return_object()
+			{
+				return(Task(handle::from_promise(*this)));
+			}
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			// resume the awaiting coroutine
+			struct Final {
+				bool await_ready() noexcept { return(false); }
+				std::coroutine_handle<> await_suspend(handle h)
+					noexcept
+				{
+					if (h.promise().next)
+						return(h.promise().next);
+
+					return(std::noop_coroutine());
+				}
+				void await_resume() noexcept {}
+			};
+
+			Final final_suspend() noexcept { return {}; }
+			void return_value(T v) { value = v; }
+			void unhandled_exception() { std::terminate(); }
+		};
+
+		Task(Task &&t) : h{t.h} { t.h = nullptr; }
+		Task(const Task &) = delete;
+		~Task() { if (h) h.destroy(); }
+
+		bool await_ready() { return(false); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> c)
+		{
+			h.promise().next = c;
+			return(h);
+		}
+
+		T await_resume() { return(h.promise().value); }
+	private:
+		explicit Task(handle c) : h{c} {}
+		handle h;
+};
+
+/*! A coroutine started at once, nobody waits for it. */
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/*! Hashed timer wheel, 1 ms tick.
+ *
+ * The timers are in the awaiting coroutine frames, adding and
+ * expiring a timer is O(1) and allocates nothing.
+ */
+class TimerWheel {
+	public:
+		/*! Slots, power of 2, a timer farther away takes rounds. */
+		static const uint16_t slots = 256;
+
+		struct Timer {
+			std::coroutine_handle<> h;
+			uint64_t tick;
+			Timer *next;
+		};
+
+		/*! The awaitable of sleep_until(). */
+		class Sleep {
+			public:
+				Sleep(TimerWheel &w, uint64_t tick) :
+					wheel{w}, timer{nullptr, tick, nullptr} {}
+				bool await_ready() const
+				{
+					return(timer.tick <= wheel.now());
+				}
+				void await_suspend(std::coroutine_handle<> h)
+				{
+					timer.h = h;
+					wheel.add(&timer);
+				}
+				void await_resume() const {}
+			private:
+				TimerWheel &wheel;
+				Timer timer;
+		};
+
+		TimerWheel();
+		/*! ms since the start. */
+		uint64_t now() const { return(tick); }
+		Sleep sleep_until(uint64_t t) { return(Sleep(*this, t)); }
+		Sleep sleep_for(uint32_t ms);
+		void run();
+		void stop() { running = false; }
+	private:
+		Timer *slot[slots];
+		uint64_t tick;
+		uint32_t pending;
+		bool running;
+		struct timespec epoch;
+		void add(Timer *);
+		bool due(uint64_t) const;
+		void expire();
+};
+
+/*! Coroutine interface of a BMP180. */
+class BMP180Co {
+	public:
+		BMP180Co(BMP180 &s, TimerWheel &w) : sensor{s}, wheel{w} {}
+		BMP180 &sensor;
+		Task<uint8_t> read_temperature();
+		Task<uint8_t> read_pressure();
+		Task<uint8_t> read_all();
+	private:
+		TimerWheel &wheel;
+};
+
+#endif
@@ -0,0 +1,190 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_mt.h
+ * \brief A sensor shared by many threads, host only.
+ *
+ * SharedSensor owns the sensor and its bus: its sampling thread is
+ * the only one doing transactions and touching the driver's T and
+ * p. Every sample is published as a whole in a Seqlock, the
+ * readers copy the latest one without a lock and without a syscall,
+ * they never make the sampler wait and a reader racing a write
+ * retries its copy, it never sees a torn sample.
+ *
+ * The sampler runs on an absolute CLOCK_MONOTONIC schedule as
+ * bmp180d does. Box is the publication, Seqlock or anything with
+ * its put(), try_get() and version(), see bench_readers.cpp.
+ */
+
+#ifndef _BMP180_MT_H_
+#define _BMP180_MT_H_
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include "bmp180.h"
+#include "bmp180_shm.h"
+#include "seqlock.h"
+
+template <class S = BMP180, template <class> class Box = Seqlock>
+class SharedSensor {
+	public:
+		typedef bmp180_shm_sample_t sample_t;
+
+		/*! The bus must not be used by anybody else. */
+		SharedSensor(struct i2c_bus_t *bus, uint8_t addr = BMP180_ADDR) :
+			sensor{addr, bus}, running{false}, errs{0},
+			put_max{0} {}
+
+		~SharedSensor()
+		{
+			stop();
+		}
+
+		bool present() const
+		{
+			return(sensor.present());
+		}
+
+		/*! Start the sampler.
+		 *
+		 * @return 0 - OK, 1 invalid args or running, or the
+		 * pthread_create() error.
+		 */
+		int start(const uint8_t oss, const uint32_t rate_hz,
+				const int32_t p0 = BMP180_SEALEVEL)
+		{
+			int err;
+
+			if (running || !rate_hz || sensor.resolution(oss))
+				return(1);
+
+			sensor.p0 = p0;
+			period = 1000000000ULL / rate_hz;
+			running = true;
+			err = pthread_create(&thread, NULL, run, this);
+
+			if (err)
+				running = false;
+
+			return(err);
+		}
+
+		/*! Stop the sampler, at most a period and a read later. */
+		void stop()
+		{
+			if (running.exchange(false))
+				pthread_join(thread, NULL);
+		}
+
+		/*! The latest sample.
+		 *
+		 * @param s the copy.
+		 * @param retries if not NULL incremented on each retry.
+		 * @return false if nothing is published yet.
+		 */
+		bool latest(sample_t &s, uint64_t *retries = nullptr) const
+		{
+			if (!last.version())
+				return(false);
+
+			while (!last.try_get(s))
+				if (retries)
+					(*retries)++;
+
+			return(true);
+		}
+
+		/*! Samples published. */
+		uint32_t samples() const
+		{
+			return(last.version());
+		}
+
+		/*! Failed reads. */
+		uint64_t errors() const
+		{
+			return(errs.load(std::memory_order_relaxed));
+		}
+
+		/*! The longest put() of a sample, ns. */
+		int64_t put_max_ns() const
+		{
+			return(put_max.load(std::memory_order_relaxed));
+		}
+	private:
+		S sensor;
+		Box<sample_t> last;
+		pthread_t thread;
+		uint64_t period;
+		std::atomic<bool> running;
+		std::atomic<uint64_t> errs;
+		std::atomic<int64_t> put_max;
+
+		static int64_t ns(const clockid_t id)
+		{
+			struct timespec ts;
+
+			clock_gettime(id, &ts);
+			return((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+		}
+
+		static void *run(void *arg)
+		{
+			SharedSensor *self = (SharedSensor *)arg;
+			struct timespec next;
+			sample_t s = {};
+			int64_t t0, t;
+
+			clock_gettime(CLOCK_MONOTONIC, &next);
+
+			while (self->running) {
+				if (self->sensor.read_all()) {
+					self->errs++;
+				} else {
+					s.time = ns(CLOCK_REALTIME);
+					s.T = self->sensor.T;
+					s.p = self->sensor.p;
+					s.altitude = bmp180_math_altitude(
+							self->sensor.p,
+							self->sensor.p0);
+					t0 = ns(CLOCK_MONOTONIC);
+					self->last.put(s);
+					t = ns(CLOCK_MONOTONIC) - t0;
+					s.n++;
+
+					if (t > self->put_max)
+						self->put_max = t;
+				}
+
+				next.tv_nsec += self->period % 1000000000ULL;
+				next.tv_sec += self->period / 1000000000ULL +
+					next.tv_nsec / 1000000000L;
+				next.tv_nsec %= 1000000000L;
+
+				while (clock_nanosleep(CLOCK_MONOTONIC,
+							TIMER_ABSTIME, &next,
+							NULL) == EINTR);
+			}
+
+			return(NULL);
+		}
+};
+
+#endif
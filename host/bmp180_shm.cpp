@@ -0,0 +1,158 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bmp180_shm.h"
+
+/*! Create (or replace) the segment, writer side.
+ *
+ * \return the mapped segment or NULL, see errno.
+ */
+struct bmp180_shm_t *bmp180_shm_create(const char *name, uint32_t size,
+		uint32_t rate)
+{
+	struct bmp180_shm_t *shm;
+	void *mem;
+	int fd;
+
+	fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+	if (fd < 0)
+		return(NULL);
+
+	if (ftruncate(fd, BMP180_SHM_BYTES(size))) {
+		close(fd);
+		return(NULL);
+	}
+
+	mem = mmap(NULL, BMP180_SHM_BYTES(size), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mem == MAP_FAILED)
+		return(NULL);
+
+	shm = new (mem) bmp180_shm_t;
+	shm->size = size;
+	shm->rate = rate;
+	shm->head.store(0);
+
+	for (uint32_t i = 1; i < size; i++)
+		new (&shm->ring[i]) Seqlock<bmp180_shm_sample_t>;
+
+	shm->version = BMP180_SHM_VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	/* the readers check it last */
+	shm->magic = BMP180_SHM_MAGIC;
+	return(shm);
+}
+
+/*! Map the segment read only, reader side.
+ *
+ * \return the segment or NULL if missing or not valid.
+ */
+struct bmp180_shm_t *bmp180_shm_attach(const char *name)
+{
+	struct bmp180_shm_t *shm;
+	struct stat st;
+	void *mem;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+
+	if (fd < 0)
+		return(NULL);
+
+	if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(bmp180_shm_t))) {
+		close(fd);
+		return(NULL);
+	}
+
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mem == MAP_FAILED)
+		return(NULL);
+
+	shm = (struct bmp180_shm_t *)mem;
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if ((shm->magic != BMP180_SHM_MAGIC) ||
+			(shm->version != BMP180_SHM_VERSION) ||
+			((off_t)BMP180_SHM_BYTES(shm->size) > st.st_size)) {
+		munmap(mem, st.st_size);
+		return(NULL);
+	}
+
+	return(shm);
+}
+
+/*! Publish a sample, writer side.
+ *
+ * The sample number is assigned here.
+ */
+void bmp180_shm_publish(struct bmp180_shm_t *shm, bmp180_shm_sample_t *s)
+{
+	uint64_t head;
+
+	head = shm->head.load(std::memory_order_relaxed);
+	s->n = head;
+	shm->ring[head % shm->size].put(*s);
+	shm->latest.put(*s);
+	shm->head.store(head + 1, std::memory_order_release);
+}
+
+/*! Read the next sample of the ring, reader side.
+ *
+ * \param cursor the next sample number to read, updated.
+ * \return 1 - a sample, 0 - none yet, -n - n samples lost,
+ * the cursor has been moved to the oldest one still there.
+ */
+int bmp180_shm_read(const struct bmp180_shm_t *shm, uint64_t *cursor,
+		bmp180_shm_sample_t *s)
+{
+	uint64_t head, lost;
+
+	head = shm->head.load(std::memory_order_acquire);
+
+	if (*cursor >= head)
+		return(0);
+
+	/* the slot has been overwritten already */
+	if (head - *cursor > shm->size) {
+		lost = head - shm->size - *cursor;
+		*cursor = head - shm->size;
+		return(-(int)lost);
+	}
+
+	*s = shm->ring[*cursor % shm->size].get();
+
+	/* overwritten while reading */
+	if (s->n != *cursor) {
+		lost = s->n - shm->size + 1 - *cursor;
+		*cursor += lost;
+		return(-(int)lost);
+	}
+
+	(*cursor)++;
+	return(1);
+}
@@ -0,0 +1,79 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_shm.h
+ * \brief POSIX shared memory ring of samples.
+ *
+ * One writer (bmp180d) and any number of reader processes. The
+ * readers map the segment read only and never make a syscall to
+ * get a sample: the latest one is behind a seqlock and every slot
+ * of the ring has its own seqlock, a slot overwritten while being
+ * read is detected by its sample number.
+ */
+
+#ifndef _BMP180_SHM_H_
+#define _BMP180_SHM_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "seqlock.h"
+
+#define BMP180_SHM_NAME "/bmp180"
+#define BMP180_SHM_MAGIC 0x42503138
+#define BMP180_SHM_VERSION 1
+
+/*! A published sample. */
+struct bmp180_shm_sample_t {
+	/*! sample number, from 0. */
+	uint64_t n;
+	/*! CLOCK_REALTIME in ns. */
+	int64_t time;
+	/*! 0.1 C. */
+	int32_t T;
+	/*! Pa. */
+	int32_t p;
+	/*! m. */
+	float altitude;
+};
+
+/*! The shared segment. */
+struct bmp180_shm_t {
+	uint32_t magic;
+	uint32_t version;
+	/*! ring slots. */
+	uint32_t size;
+	/*! sampling rate. */
+	uint32_t rate;
+	/*! samples written. */
+	std::atomic<uint64_t> head;
+	Seqlock<bmp180_shm_sample_t> latest;
+	/*! size slots. */
+	Seqlock<bmp180_shm_sample_t> ring[1];
+};
+
+/*! Segment size for a ring of n slots. */
+#define BMP180_SHM_BYTES(n) (sizeof(struct bmp180_shm_t) + \
+		((n) - 1) * sizeof(Seqlock<bmp180_shm_sample_t>))
+
+struct bmp180_shm_t *bmp180_shm_create(const char *name, uint32_t size,
+		uint32_t rate);
+struct bmp180_shm_t *bmp180_shm_attach(const char *name);
+void bmp180_shm_publish(struct bmp180_shm_t *shm, bmp180_shm_sample_t *s);
+int bmp180_shm_read(const struct bmp180_shm_t *shm, uint64_t *cursor,
+		bmp180_shm_sample_t *s);
+
+#endif
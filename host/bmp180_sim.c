@@ -0,0 +1,416 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "bmp180.h"
+#include "bmp180_sim.h"
+
+/* datasheet example calibration */
+static const uint8_t datasheet_cal[BMP180_CAL_SIZE] = {
+	0x01, 0x98, 0xff, 0xb8, 0xc7, 0xd1, 0x7f, 0xe5, 0x7f, 0xf5,
+	0x5a, 0x71, 0x18, 0x2e, 0x00, 0x04, 0x80, 0x00, 0xdd, 0xf9,
+	0x0b, 0x34
+};
+
+/* BMP280 registers, as bmpx.h */
+#define BMP280_REG_CAL 0x88
+#define BMP280_REG_STATUS 0xf3
+#define BMP280_REG_CTRL_MEAS 0xf4
+#define BMP280_REG_CONFIG 0xf5
+#define BMP280_REG_PRESS 0xf7
+#define BMP280_REG_TEMP 0xfa
+
+/* BMP280 datasheet 3.12 example calibration, T1 .. P9 */
+static const int32_t datasheet_cal280[12] = {
+	27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7,
+	15500, -14600, 6000
+};
+
+/* and its adc_T, adc_P, 25.08 C and 100653.27 Pa */
+#define DATASHEET_UT280 519888
+#define DATASHEET_UP280 415148
+
+/* BMP280 t_sb standby (us) */
+static const uint32_t standby_us[8] = {
+	500, 62500, 125000, 250000, 500000, 1000000, 2000000, 4000000
+};
+
+/* BMP280 pressure RMS noise (Pa) for osrs_p x1 .. x16 */
+static const uint8_t noise280_pa[5] = { 3, 2, 2, 1, 1 };
+
+/* conversion time (us), temperature then oss 0..3 */
+static const uint16_t conv_us[5] = { 4500, 4500, 7500, 13500, 25500 };
+
+/* pressure RMS noise (Pa) for oss 0..3 */
+static const uint8_t noise_pa[4] = { 6, 5, 4, 3 };
+
+static uint64_t monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static uint64_t now(struct bmp180_sim_t *sim)
+{
+	return(sim->clock ? sim->clock() : monotonic_us());
+}
+
+/* xorshift32, sum of two uniform draws scaled to RMS ~n */
+static int32_t noise(struct bmp180_sim_t *sim, uint8_t n)
+{
+	int32_t a, b;
+
+	sim->seed ^= sim->seed << 13;
+	sim->seed ^= sim->seed >> 17;
+	sim->seed ^= sim->seed << 5;
+	a = (int32_t)(sim->seed % (2 * n + 1)) - n;
+	sim->seed ^= sim->seed << 13;
+	sim->seed ^= sim->seed >> 17;
+	sim->seed ^= sim->seed << 5;
+	b = (int32_t)(sim->seed % (2 * n + 1)) - n;
+	return((a + b) * 6 / 5);
+}
+
+/* The smallest UT compensated to T or more, T grows with UT. */
+static uint16_t inverse_ut(struct bmp180_sim_t *sim, int32_t T)
+{
+	uint32_t lo, hi, mid;
+
+	lo = 0;
+	hi = 0xffff;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+
+		if (bmp180_math_temperature(bmp180_math_b5(&sim->cal,
+						(int32_t)mid)) < T)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return((uint16_t)lo);
+}
+
+/* The smallest UP compensated to p or more, p grows with UP. */
+static int32_t inverse_up(struct bmp180_sim_t *sim, int32_t p, uint8_t oss)
+{
+	int32_t lo, hi, mid;
+
+	lo = 0;
+	hi = (1L << (16 + oss)) - 1;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+
+		if (bmp180_math_pressure(&sim->cal, sim->B5, mid, oss) < p)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return(lo);
+}
+
+/* The smallest BMP280 UT compensated to T or more. */
+static int32_t inverse_ut280(struct bmp180_sim_t *sim, int32_t T)
+{
+	int32_t lo, hi, mid;
+
+	lo = 0;
+	hi = 0xfffff;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+
+		if (bmp280_math_temperature(bmp280_math_t_fine(&sim->cal280,
+						mid)) < T)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return(lo);
+}
+
+/* The smallest BMP280 UP compensated to p or less, p falls as UP
+ * grows.
+ */
+static int32_t inverse_up280(struct bmp180_sim_t *sim, int32_t p)
+{
+	int32_t lo, hi, mid, fine;
+
+	fine = bmp280_math_t_fine(&sim->cal280, sim->ut);
+	lo = 0;
+	hi = 0xfffff;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+
+		if (bmp280_math_pressure(&sim->cal280, fine, mid) > p)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return(lo);
+}
+
+/* x1 .. x16 of an osrs_ field, 0 skipped */
+static uint8_t samples280(uint8_t osrs)
+{
+	return(osrs ? 1 << ((osrs > 5 ? 5 : osrs) - 1) : 0);
+}
+
+/* datasheet max measurement time (us) of a ctrl_meas */
+static uint32_t measure_us(uint8_t ctrl)
+{
+	uint8_t osrs_p;
+
+	osrs_p = (ctrl >> 2) & 7;
+	return(1250 + 2300 * (samples280(ctrl >> 5) + samples280(osrs_p)) +
+			(osrs_p ? 575 : 0));
+}
+
+/* A 20 bit sample in the msb, lsb, xlsb[7:4] registers. */
+static void put20(uint8_t *reg, uint32_t v)
+{
+	v <<= 4;
+	reg[0] = v >> 16;
+	reg[1] = (v >> 8) & 0xff;
+	reg[2] = v & 0xff;
+}
+
+/* The end of a BMP280 measurement, skipped ones read 0x80000. */
+static void latch280(struct bmp180_sim_t *sim)
+{
+	uint8_t ctrl, osrs_p;
+
+	ctrl = sim->reg[BMP280_REG_CTRL_MEAS];
+	osrs_p = (ctrl >> 2) & 7;
+
+	if (sim->noise && osrs_p)
+		sim->up = inverse_up280(sim, sim->p + noise(sim,
+				noise280_pa[(osrs_p > 5 ? 5 : osrs_p) - 1]));
+
+	put20(&sim->reg[BMP280_REG_TEMP], (ctrl >> 5) ? sim->ut : 0x80000);
+	put20(&sim->reg[BMP280_REG_PRESS], osrs_p ? sim->up : 0x80000);
+}
+
+/* A BMP280 ctrl_meas write, mode 01 and 10 forced, 11 normal. */
+static void convert280(struct bmp180_sim_t *sim, uint8_t cmd)
+{
+	sim->reg[BMP280_REG_CTRL_MEAS] = cmd;
+
+	if (!(cmd & 3)) {
+		sim->reg[BMP280_REG_STATUS] = 0;
+		return;
+	}
+
+	sim->ready = now(sim) + measure_us(cmd);
+	sim->period = measure_us(cmd) +
+		standby_us[sim->reg[BMP280_REG_CONFIG] >> 5];
+	sim->reg[BMP280_REG_STATUS] = 0x08;
+}
+
+/* The finished BMP280 measurements. */
+static void update280(struct bmp180_sim_t *sim)
+{
+	uint64_t t;
+	uint8_t ctrl;
+
+	ctrl = sim->reg[BMP280_REG_CTRL_MEAS];
+	t = now(sim);
+
+	if (!(ctrl & 3) || (t < sim->ready))
+		return;
+
+	latch280(sim);
+
+	/* forced, back to sleep */
+	if ((ctrl & 3) != 3) {
+		sim->reg[BMP280_REG_CTRL_MEAS] &= ~3;
+		sim->reg[BMP280_REG_STATUS] = 0;
+		return;
+	}
+
+	/* normal, the next one, measuring only in its measurement time */
+	sim->ready += ((t - sim->ready) / sim->period + 1) * sim->period;
+	sim->reg[BMP280_REG_STATUS] = ((sim->ready - t) <= measure_us(ctrl)) ?
+		0x08 : 0;
+}
+
+static void convert(struct bmp180_sim_t *sim, uint8_t cmd)
+{
+	uint32_t up;
+	uint16_t ut;
+	uint8_t oss;
+
+	if (cmd == 0x2e) {
+		ut = inverse_ut(sim, sim->T);
+		sim->B5 = bmp180_math_b5(&sim->cal, ut);
+		sim->adc[0] = ut >> 8;
+		sim->adc[1] = ut & 0xff;
+		sim->adc[2] = 0;
+		sim->ready = now(sim) + conv_us[0];
+	} else if ((cmd & 0x3f) == 0x34) {
+		oss = cmd >> 6;
+		up = (uint32_t)inverse_up(sim, sim->p + (sim->noise ?
+					noise(sim, noise_pa[oss]) : 0), oss);
+		up <<= 8 - oss;
+		sim->adc[0] = up >> 16;
+		sim->adc[1] = (up >> 8) & 0xff;
+		sim->adc[2] = up & 0xff;
+		sim->ready = now(sim) + conv_us[oss + 1];
+	} else {
+		return;
+	}
+
+	/* Sco, start of conversion, set while running */
+	sim->reg[BMP180_REG_CTRL] = cmd | 0x20;
+}
+
+/* end of a running conversion */
+static void update(struct bmp180_sim_t *sim)
+{
+	if (sim->bmp280) {
+		update280(sim);
+		return;
+	}
+
+	if (!(sim->reg[BMP180_REG_CTRL] & 0x20) || (now(sim) < sim->ready))
+		return;
+
+	sim->reg[BMP180_REG_CTRL] &= ~0x20;
+	memcpy(&sim->reg[BMP180_REG_ADC], sim->adc, 3);
+}
+
+/*! Power on state with the datasheet calibration, 25.0 C, 1013.25 hPa. */
+void bmp180_sim_init(struct bmp180_sim_t *sim)
+{
+	memset(sim, 0, sizeof(*sim));
+	memcpy(&sim->reg[BMP180_REG_AC1], datasheet_cal, BMP180_CAL_SIZE);
+	bmp180_math_cal(&sim->cal, datasheet_cal);
+	sim->reg[BMP180_REG_ID] = 0x55;
+	sim->reg[BMP180_REG_ADCMSB] = 0x80;
+	sim->T = 250;
+	sim->p = BMP180_SEALEVEL;
+	sim->noise = 1;
+	sim->seed = 0x18051805;
+}
+
+/*! Power on state of a BMP280, the datasheet example calibration
+ * and adc_T, adc_P, no noise.
+ */
+void bmp180_sim_init_bmp280(struct bmp180_sim_t *sim)
+{
+	uint8_t i;
+
+	memset(sim, 0, sizeof(*sim));
+
+	/* little endian */
+	for (i = 0; i < 12; i++) {
+		sim->reg[BMP280_REG_CAL + 2 * i] = datasheet_cal280[i] & 0xff;
+		sim->reg[BMP280_REG_CAL + 2 * i + 1] =
+			(datasheet_cal280[i] >> 8) & 0xff;
+	}
+
+	sim->cal280.T1 = datasheet_cal280[0];
+	sim->cal280.T2 = datasheet_cal280[1];
+	sim->cal280.T3 = datasheet_cal280[2];
+	sim->cal280.P1 = datasheet_cal280[3];
+	sim->cal280.P2 = datasheet_cal280[4];
+	sim->cal280.P3 = datasheet_cal280[5];
+	sim->cal280.P4 = datasheet_cal280[6];
+	sim->cal280.P5 = datasheet_cal280[7];
+	sim->cal280.P6 = datasheet_cal280[8];
+	sim->cal280.P7 = datasheet_cal280[9];
+	sim->cal280.P8 = datasheet_cal280[10];
+	sim->cal280.P9 = datasheet_cal280[11];
+
+	sim->bmp280 = 1;
+	sim->reg[BMP180_REG_ID] = 0x58;
+	put20(&sim->reg[BMP280_REG_PRESS], 0x80000);
+	put20(&sim->reg[BMP280_REG_TEMP], 0x80000);
+	sim->ut = DATASHEET_UT280;
+	sim->up = DATASHEET_UP280;
+	sim->T = bmp280_math_temperature(bmp280_math_t_fine(&sim->cal280,
+				sim->ut));
+	sim->p = bmp280_math_pressure(&sim->cal280,
+			bmp280_math_t_fine(&sim->cal280, sim->ut), sim->up);
+	sim->seed = 0x18051805;
+}
+
+/*! Set the simulated environment, the next conversions see it. */
+void bmp180_sim_set(struct bmp180_sim_t *sim, int32_t T, int32_t p)
+{
+	sim->T = T;
+	sim->p = p;
+
+	if (sim->bmp280) {
+		sim->ut = inverse_ut280(sim, T);
+		sim->up = inverse_up280(sim, p);
+	}
+}
+
+/*! An i2c write transaction to the chip. */
+void bmp180_sim_write(struct bmp180_sim_t *sim, const uint8_t *data,
+		uint16_t len)
+{
+	if (!len)
+		return;
+
+	update(sim);
+	sim->ptr = *data++;
+	len--;
+
+	while (len--) {
+		/* soft reset */
+		if ((sim->ptr == 0xe0) && (*data == 0xb6)) {
+			sim->reg[BMP180_REG_CTRL] = 0;
+
+			if (sim->bmp280) {
+				sim->reg[BMP280_REG_CONFIG] = 0;
+				sim->reg[BMP280_REG_STATUS] = 0;
+			}
+		} else if (sim->bmp280 && (sim->ptr == BMP280_REG_CTRL_MEAS)) {
+			convert280(sim, *data);
+		} else if (sim->bmp280 && (sim->ptr == BMP280_REG_CONFIG)) {
+			/* t_sb, filter, spi3w_en, taken in sleep mode only */
+			if (!(sim->reg[BMP280_REG_CTRL_MEAS] & 3))
+				sim->reg[BMP280_REG_CONFIG] = *data;
+		} else if (sim->ptr == BMP180_REG_CTRL) {
+			convert(sim, *data);
+		}
+
+		sim->ptr++;
+		data++;
+	}
+}
+
+/*! An i2c read transaction from the chip. */
+void bmp180_sim_read(struct bmp180_sim_t *sim, uint8_t *data, uint16_t len)
+{
+	update(sim);
+
+	while (len--)
+		*data++ = sim->reg[sim->ptr++];
+}
@@ -0,0 +1,88 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180_sim.h
+ * \brief Register level model of a BMP180.
+ *
+ * The model answers i2c writes and reads as the chip does: the
+ * first written byte is the register pointer, the pointer
+ * auto-increments. A conversion started by writing the control
+ * register produces the UT or UP the compensation turns back into
+ * the simulated T and p, plus the datasheet RMS noise of the oss.
+ * The result is in the ADC registers only after the datasheet
+ * conversion time.
+ *
+ * bmp180_sim_init_bmp280() turns the model into a BMP280 with the
+ * datasheet calibration example: forced and normal mode, the
+ * conversion time of osrs_t and osrs_p, t_sb between the normal
+ * mode conversions. Until bmp180_sim_set() the conversions give the
+ * datasheet adc_T and adc_P.
+ */
+
+#ifndef _BMP180_SIM_H_
+#define _BMP180_SIM_H_
+
+#include <stdint.h>
+#include "bmp180_math.h"
+#include "bmp280_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! 7 bit address. */
+#define BMP180_SIM_ADDR 0x77
+
+struct bmp180_sim_t {
+	uint8_t reg[256];
+	uint8_t ptr;
+	struct bmp180_cal_t cal;
+	/*! simulated temperature (0.1 C) and pressure (Pa). */
+	int32_t T;
+	int32_t p;
+	/*! pressure noise, 0 to disable. */
+	uint8_t noise;
+	uint32_t seed;
+	/*! end of the running conversion (us) and its result. */
+	uint64_t ready;
+	uint8_t adc[3];
+	int32_t B5;
+	/*! BMP280 model, see bmp180_sim_init_bmp280(). */
+	uint8_t bmp280;
+	struct bmp280_cal_t cal280;
+	/*! BMP280: the 20 bit UT and UP of the conversions. */
+	int32_t ut;
+	int32_t up;
+	/*! BMP280 normal mode: measurement plus standby (us). */
+	uint32_t period;
+	/*! clock in us, CLOCK_MONOTONIC if NULL. */
+	uint64_t (*clock)(void);
+};
+
+void bmp180_sim_init(struct bmp180_sim_t *sim);
+void bmp180_sim_init_bmp280(struct bmp180_sim_t *sim);
+void bmp180_sim_set(struct bmp180_sim_t *sim, int32_t T, int32_t p);
+void bmp180_sim_write(struct bmp180_sim_t *sim, const uint8_t *data,
+		uint16_t len);
+void bmp180_sim_read(struct bmp180_sim_t *sim, uint8_t *data,
+		uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
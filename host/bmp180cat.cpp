@@ -0,0 +1,101 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180cat.cpp
+ * \brief Print the samples published by bmp180d.
+ *
+ * bmp180cat [-n /bmp180] [-f]
+ *
+ * Without -f print the latest sample, with -f follow the ring from
+ * the oldest sample still there, lost samples are reported.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bmp180_shm.h"
+
+static void print(const bmp180_shm_sample_t *s)
+{
+	printf("%llu %lld.%09lld %s%ld.%ld %ld %.2f\n",
+			(unsigned long long)s->n,
+			(long long)(s->time / 1000000000),
+			(long long)(s->time % 1000000000),
+			(s->T < 0) ? "-" : "",
+			(long)(labs(s->T) / 10), (long)(labs(s->T) % 10),
+			(long)s->p, s->altitude);
+}
+
+int main(int argc, char **argv)
+{
+	const struct bmp180_shm_t *shm;
+	bmp180_shm_sample_t sample;
+	const char *name = BMP180_SHM_NAME;
+	uint64_t cursor, head;
+	bool follow = false;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "n:f")) != -1) {
+		switch (opt) {
+			case 'n':
+				name = optarg;
+				break;
+			case 'f':
+				follow = true;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-n shm_name] [-f]\n",
+						argv[0]);
+				return(EXIT_FAILURE);
+		}
+	}
+
+	shm = bmp180_shm_attach(name);
+
+	if (!shm) {
+		fprintf(stderr, "%s: no bmp180d segment\n", name);
+		return(EXIT_FAILURE);
+	}
+
+	if (!follow) {
+		if (!shm->head.load(std::memory_order_acquire))
+			return(EXIT_FAILURE);
+
+		sample = shm->latest.get();
+		print(&sample);
+		return(EXIT_SUCCESS);
+	}
+
+	head = shm->head.load(std::memory_order_acquire);
+	cursor = (head > shm->size) ? head - shm->size : 0;
+
+	for (;;) {
+		ret = bmp180_shm_read(shm, &cursor, &sample);
+
+		if (ret > 0) {
+			print(&sample);
+			fflush(stdout);
+		} else if (ret < 0) {
+			fprintf(stderr, "lost %d samples\n", -ret);
+		} else {
+			/* poll at 10x the sampling rate */
+			usleep(100000 / shm->rate);
+		}
+	}
+
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,172 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bmp180d.cpp
+ * \brief Sample a BMP180 on /dev/i2c-N and publish it in shared memory.
+ *
+ * bmp180d [-d /dev/i2c-1] [-r rate_hz] [-o oss] [-n /bmp180]
+ *	[-s ring_size] [-c count] [-p sealevel_pa]
+ *
+ * The samples are taken on an absolute CLOCK_MONOTONIC schedule,
+ * a late sample does not shift the next ones. The readers see the
+ * segment through bmp180_shm.h, see bmp180cat.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "bmp180.h"
+#include "i2c_linux.h"
+#include "bmp180_shm.h"
+#include "i2c_rec.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void quit(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static int64_t realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-d dev] [-r rate_hz] [-o oss] "
+			"[-n shm_name] [-s ring_size] [-c count] "
+			"[-p sealevel_pa]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct i2c_bus_t bus;
+	struct bmp180_shm_t *shm;
+	struct timespec next;
+	bmp180_shm_sample_t sample;
+	const char *dev = "/dev/i2c-1";
+	const char *name = BMP180_SHM_NAME;
+	uint64_t period, count = 0, n = 0, errors = 0;
+	uint32_t rate = 1, size = 256;
+	int32_t p0 = BMP180_SEALEVEL;
+	uint8_t oss = BMP180_RES_STD;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:r:o:n:s:c:p:")) != -1) {
+		switch (opt) {
+			case 'd':
+				dev = optarg;
+				break;
+			case 'r':
+				rate = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				oss = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				name = optarg;
+				break;
+			case 's':
+				size = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				count = strtoull(optarg, NULL, 0);
+				break;
+			case 'p':
+				p0 = strtol(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (!rate || (rate > 100) || !size || (oss > BMP180_RES_ULTRAHIGH))
+		usage(argv[0]);
+
+	if (i2c_linux_open(&bus, dev)) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return(EXIT_FAILURE);
+	}
+
+	/* make RECORD=1, the i2c record on stdout */
+	i2c_rec_init();
+	BMP180 sensor(BMP180_ADDR, &bus);
+
+	if (sensor.id != 0x55) {
+		fprintf(stderr, "%s: no BMP180 (id 0x%02x)\n", dev, sensor.id);
+		i2c_linux_close(&bus);
+		return(EXIT_FAILURE);
+	}
+
+	sensor.resolution(oss);
+	sensor.p0 = p0;
+	shm = bmp180_shm_create(name, size, rate);
+
+	if (!shm) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		i2c_linux_close(&bus);
+		return(EXIT_FAILURE);
+	}
+
+	signal(SIGINT, quit);
+	signal(SIGTERM, quit);
+	period = 1000000000ULL / rate;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (running && (!count || (n < count))) {
+		if (sensor.read_all()) {
+			errors++;
+			fprintf(stderr, "read error %llu\n",
+					(unsigned long long)errors);
+		} else {
+			sample.time = realtime_ns();
+			sample.T = sensor.T;
+			sample.p = sensor.p;
+			sample.altitude = bmp180_math_altitude(sensor.p,
+					sensor.p0);
+			bmp180_shm_publish(shm, &sample);
+			n++;
+		}
+
+		i2c_rec_flush();
+
+		next.tv_nsec += period % 1000000000ULL;
+		next.tv_sec += period / 1000000000ULL + next.tv_nsec / 1000000000L;
+		next.tv_nsec %= 1000000000L;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&next, NULL) == EINTR)
+			if (!running)
+				break;
+	}
+
+	shm_unlink(name);
+	munmap(shm, BMP180_SHM_BYTES(size));
+	i2c_linux_close(&bus);
+	return(errors ? EXIT_FAILURE : EXIT_SUCCESS);
+}
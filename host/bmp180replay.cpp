@@ -0,0 +1,210 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*! \file bmp180replay.cpp
+ * \brief Replay a recorded i2c trace into the unchanged driver.
+ *
+ * bmp180replay [-c batch] [-o oss] [-v] trace.bin
+ *
+ * The driver runs on the trace (i2c_replay.cpp) instead of the bus,
+ * the delays do not sleep, so the run is deterministic and as fast
+ * as the host. Without -c every sample is a read_all(), with -c the
+ * samples are captured in batches and averaged, as main.c does.
+ *
+ * At the end it prints the driver host CPU time per sample and the
+ * recorded bus time per kind of transaction, the slow and the
+ * failed transactions of the trace are listed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <util/delay.h>
+#include "bmp180.h"
+#include "i2c_replay.h"
+
+/* slow, more than SLOW times the median of its kind */
+#define SLOW 4
+/* max slow or failed records listed */
+#define LIST 10
+
+struct rec_info_t {
+	uint32_t n;
+	uint32_t dur;
+	uint8_t status;
+};
+
+/* by (addr << 16 | lenght) */
+static std::map<uint32_t, std::vector<rec_info_t> > kinds;
+static double delay_us;
+
+static void hook(struct i2c_bus_t *bus, const struct i2c_rec_t *rec)
+{
+	kinds[(uint32_t)rec->addr << 16 | rec->lenght].push_back(
+			{bus->records, rec->dur, rec->status});
+}
+
+static void delay(double us)
+{
+	delay_us += us;
+}
+
+static double cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return(ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static void report(void)
+{
+	std::vector<uint32_t> d;
+	uint32_t median, listed;
+
+	printf("# kind len n dur_p50_us dur_p99_us dur_max_us\n");
+
+	for (auto &k : kinds) {
+		d.clear();
+
+		for (auto &r : k.second)
+			d.push_back(r.dur);
+
+		std::sort(d.begin(), d.end());
+		printf("# %s 0x%02x %u %zu %.1f %.1f %.1f\n",
+				(k.first >> 16) & 1 ? "R" : "W",
+				(k.first >> 16) & 0xfe, k.first & 0xffff,
+				d.size(), d[d.size() / 2] / 16.0,
+				d[d.size() * 99 / 100] / 16.0,
+				d.back() / 16.0);
+	}
+
+	listed = 0;
+
+	for (auto &k : kinds) {
+		d.clear();
+
+		for (auto &r : k.second)
+			d.push_back(r.dur);
+
+		std::nth_element(d.begin(), d.begin() + d.size() / 2, d.end());
+		median = d[d.size() / 2];
+
+		for (auto &r : k.second)
+			if ((r.status || (r.dur > SLOW * median)) &&
+					(listed++ < LIST))
+				printf("# record %u %s 0x%02x dur %.1f us "
+						"status 0x%02x\n", r.n,
+						(k.first >> 16) & 1 ? "R" : "W",
+						(k.first >> 16) & 0xfe,
+						r.dur / 16.0, r.status);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct i2c_bus_t bus;
+	struct bmp180_raw_t raw[255];
+	double t0, cpu;
+	uint32_t samples;
+	int opt, oss = -1, batch = 0, verbose = 0, ret;
+	uint8_t err;
+
+	while ((opt = getopt(argc, argv, "c:o:v")) != -1) {
+		switch (opt) {
+			case 'c':
+				batch = atoi(optarg);
+				break;
+			case 'o':
+				oss = atoi(optarg);
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				optind = argc;
+		}
+	}
+
+	if ((optind != argc - 1) || (batch > 255)) {
+		fprintf(stderr, "Usage: %s [-c batch] [-o oss] [-v] "
+				"trace.bin\n", argv[0]);
+		return(EXIT_FAILURE);
+	}
+
+	ret = i2c_replay_open(&bus, argv[optind]);
+
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", argv[optind],
+				(ret == -2) ? "not a trace" : "cannot read");
+		return(EXIT_FAILURE);
+	}
+
+	bus.verbose = verbose;
+	bus.hook = hook;
+	host_delay_hook = delay;
+
+	BMP180 sensor(BMP180_ADDR, &bus);
+
+	if (oss >= 0)
+		sensor.resolution(oss);
+
+	samples = 0;
+	cpu = 0;
+
+	while (!bus.end) {
+		t0 = cpu_ns();
+
+		if (batch) {
+			err = sensor.capture(raw, batch);
+
+			if (!err)
+				sensor.compensate(raw, batch);
+		} else {
+			err = sensor.read_all();
+		}
+
+		cpu += cpu_ns() - t0;
+
+		if (err) {
+			if (!bus.end)
+				printf("# error 0x%02x at record %u\n", err,
+						bus.records);
+
+			continue;
+		}
+
+		samples++;
+		printf("%u %.6f %ld %ld\n", samples, bus.now / 16e6,
+				(long)sensor.T, (long)sensor.p);
+	}
+
+	printf("# records %u lost %u skipped %u mismatch %u\n",
+			bus.records, bus.lost, bus.skipped, bus.mismatch);
+	printf("# samples %u, driver+replay %.0f ns/sample host cpu, "
+			"%.1f ms/sample delays\n", samples,
+			samples ? cpu / samples : 0.0,
+			samples ? delay_us / samples / 1000 : 0.0);
+	report();
+	i2c_replay_close(&bus);
+	return(bus.mismatch ? EXIT_FAILURE : EXIT_SUCCESS);
+}
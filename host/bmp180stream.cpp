@@ -0,0 +1,191 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*! \file bmp180stream.cpp
+ * \brief Stream a BMP180 or BMP280 on /dev/i2c-N, see bmpx_stream.cpp.
+ *
+ * bmp180stream [-d /dev/i2c-1] [-r rate_hz] [-o oss] [-t t_every]
+ *	[-c count] [-q]
+ *
+ * Prints "time_s p T" per sample and the achieved samples per
+ * second at the end, rate 0 (the default) is the sensor's max.
+ * With -q the stream runs in a thread delivering to a queue.h
+ * queue, the main thread prints.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <type_traits>
+#include "bmp180.h"
+#include "i2c_linux.h"
+#include "queue.h"
+#include "timer.h"
+
+static volatile sig_atomic_t running = 1;
+static volatile int done;
+
+static void quit(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static void print(const struct bmp180_sample_t *s)
+{
+	printf("%.6f %ld %d\n", s->time / (double)BMPX_TIMER_HZ,
+			(long)s->p, s->T);
+}
+
+static uint8_t print_cb(void *ctx, const struct bmp180_sample_t *s)
+{
+	(void)ctx;
+	print(s);
+	return(!running);
+}
+
+static uint8_t queue_cb(void *ctx, const struct bmp180_sample_t *s)
+{
+	bmpx_stream_queue(ctx, s);
+	return(!running);
+}
+
+template <class S> struct Producer {
+	S *sensor;
+	struct bmpx_stream_t *stream;
+	uint8_t err;
+};
+
+template <class S> static void *produce(void *arg)
+{
+	Producer<S> *p = (Producer<S> *)arg;
+
+	p->err = p->sensor->stream_run(p->stream);
+	done = 1;
+	return(NULL);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-d dev] [-r rate_hz] [-o oss] "
+			"[-t t_every] [-c count] [-q]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct i2c_bus_t bus;
+	struct bmpx_stream_t stream;
+	struct queue_t queue;
+	const char *dev = "/dev/i2c-1";
+	int opt, threaded = 0, ret = EXIT_FAILURE;
+	uint8_t id;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.oss = BMP180_RES_STD;
+	stream.t_every = 16;
+
+	while ((opt = getopt(argc, argv, "d:r:o:t:c:q")) != -1) {
+		switch (opt) {
+			case 'd':
+				dev = optarg;
+				break;
+			case 'r':
+				stream.rate = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				stream.oss = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				stream.t_every = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				stream.count = strtoul(optarg, NULL, 0);
+				break;
+			case 'q':
+				threaded = 1;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (optind != argc)
+		usage(argv[0]);
+
+	if (i2c_linux_open(&bus, dev)) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return(EXIT_FAILURE);
+	}
+
+	signal(SIGINT, quit);
+	signal(SIGTERM, quit);
+	timer_init();
+	queue_init(&queue);
+
+	id = bmpx_detect(BMP180_ADDR, &bus, [&](auto &sensor) {
+		typedef typename std::remove_reference<decltype(sensor)>::type S;
+		Producer<S> producer;
+		struct bmp180_sample_t sample;
+		pthread_t thread;
+
+		if (sensor.start_stream(&stream, threaded ? queue_cb : print_cb,
+					&queue)) {
+			fprintf(stderr, "invalid oss %u\n", stream.oss);
+			return;
+		}
+
+		if (!threaded) {
+			ret = sensor.stream_run(&stream);
+		} else {
+			producer.sensor = &sensor;
+			producer.stream = &stream;
+			pthread_create(&thread, NULL, produce<S>, &producer);
+
+			// the last samples are in the queue at the end
+			while (!done || queue_count(&queue)) {
+				if (queue_pop(&queue, &sample))
+					usleep(1000);
+				else
+					print(&sample);
+			}
+
+			pthread_join(thread, NULL);
+			ret = producer.err;
+		}
+
+		if (ret)
+			fprintf(stderr, "%s: error 0x%02x\n", dev, ret);
+
+		fprintf(stderr, "# %u samples, %.3f sps, %u T, %u errors, "
+				"%u late, %u dropped\n", stream.samples,
+				bmpx_stream_sps(&stream), stream.temperatures,
+				stream.errors, stream.late, queue_overrun(&queue));
+		ret = ret ? EXIT_FAILURE : EXIT_SUCCESS;
+	});
+
+	if (!id)
+		fprintf(stderr, "%s: no BMP180 or BMP280\n", dev);
+
+	i2c_linux_close(&bus);
+	return(ret);
+}
@@ -0,0 +1,230 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*! \file cic_noise.c
+ * \brief Noise of the CIC decimation against the chip oversampling.
+ *
+ * cic_noise [-n outputs] [-f file]
+ *
+ * Without -f the samples come from the register model of
+ * bmp180_sim.c, with the datasheet RMS noise of each oss, at a
+ * constant pressure. With -f the oss 0 "UT UP" lines of the file,
+ * ex. a capture of a sensor at rest, are filtered instead and only
+ * the oss 0 rows are printed.
+ *
+ * For every mode: ms per output, as the driver waits the
+ * conversions, group delay in ms and the RMS of p around its mean
+ * in Pa.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "bmp180.h"
+#include "bmp180_sim.h"
+#include "cic.h"
+
+/* driver waits, UT then oss 0..3 */
+static const uint8_t conv_ms[5] = { 5, 5, 8, 14, 26 };
+
+static struct bmp180_sim_t sim;
+static uint64_t now_us;
+static FILE *fp;
+
+static uint64_t sim_clock(void)
+{
+	return(now_us);
+}
+
+/* a conversion of the model, as the driver does it */
+static int32_t convert(const uint8_t cmd, const uint8_t oss)
+{
+	uint8_t buf[3];
+
+	buf[0] = BMP180_REG_CTRL;
+	buf[1] = cmd;
+	bmp180_sim_write(&sim, buf, 2);
+	now_us += conv_ms[(cmd == 0x2e) ? 0 : oss + 1] * 1000;
+	buf[0] = BMP180_REG_ADC;
+	bmp180_sim_write(&sim, buf, 1);
+	bmp180_sim_read(&sim, buf, 3);
+
+	if (cmd == 0x2e)
+		return((buf[0] << 8) | buf[1]);
+
+	return((((int32_t)buf[0] << 16) | (buf[1] << 8) | buf[2]) >>
+			(8 - oss));
+}
+
+/* next UP, and a new UT if ut is not NULL */
+static int get(const uint8_t oss, int32_t *ut, int32_t *up)
+{
+	long a, b;
+
+	if (fp) {
+		if (fscanf(fp, "%ld %ld", &a, &b) != 2)
+			return(0);
+
+		if (ut)
+			*ut = a;
+
+		*up = b;
+		return(1);
+	}
+
+	if (ut)
+		*ut = convert(0x2e, 0);
+
+	*up = convert(0x34 | (oss << 6), oss);
+	return(1);
+}
+
+/* rms of p around its mean */
+static double rms(const int32_t *p, const uint32_t n)
+{
+	double m = 0, s = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++)
+		m += p[i];
+
+	m /= n;
+
+	for (i = 0; i < n; i++)
+		s += (p[i] - m) * (p[i] - m);
+
+	return(sqrt(s / n));
+}
+
+/* One mode, as the driver samples it: UT once per output, then
+ * 2^avg UP at oss averaged (bmp180_capture() and compensate_avg()),
+ * or with rate >= 0 the oss 0 UP decimated 2^rate by the CIC
+ * (bmp180_capture_cic()).
+ */
+static void mode(const char *name, const uint8_t oss, const uint8_t avg,
+		const int8_t rate, const uint32_t n)
+{
+	struct cic_t cic;
+	int32_t *p, ut, up, sum, B5;
+	uint32_t i, k, got;
+	double period, delay, conv;
+
+	p = (int32_t *)malloc(n * sizeof(int32_t));
+	got = 0;
+
+	if (rate >= 0)
+		cic_init(&cic, rate);
+
+	if (fp)
+		rewind(fp);
+
+	for (i = 0; i < n; i++) {
+		if (!get(oss, &ut, &up))
+			break;
+
+		B5 = bmp180_math_b5(&sim.cal, ut);
+
+		if (rate >= 0) {
+			while (!cic_put(&cic, up))
+				if (!get(oss, NULL, &up))
+					goto end;
+
+			p[got++] = bmp180_math_pressure(&sim.cal, B5, cic.out,
+					CIC_OSS);
+		} else {
+			sum = up;
+
+			for (k = 1; k < (1U << avg); k++) {
+				if (!get(oss, NULL, &up))
+					goto end;
+
+				sum += up;
+			}
+
+			up = (sum + (1 << avg >> 1)) >> avg;
+			p[got++] = bmp180_math_pressure(&sim.cal, B5, up, oss);
+		}
+	}
+
+end:
+	conv = conv_ms[oss + 1];
+
+	if (rate >= 0) {
+		period = conv_ms[0] + conv * (1 << rate);
+		delay = CIC_ORDER * ((1 << rate) - 1) / 2.0 * conv;
+	} else {
+		period = conv_ms[0] + conv * (1 << avg);
+		delay = ((1 << avg) - 1) / 2.0 * conv;
+	}
+
+	printf("%-16s %8.1f %8.1f %8.2f %u\n", name, period, delay,
+			(got > 1) ? rms(p, got) : 0.0, got);
+	free(p);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t n = 2000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:f:")) != -1) {
+		switch (opt) {
+			case 'n':
+				n = strtoul(optarg, NULL, 0);
+				break;
+			case 'f':
+				fp = fopen(optarg, "r");
+
+				if (!fp) {
+					perror(optarg);
+					return(EXIT_FAILURE);
+				}
+
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-n outputs] "
+						"[-f ut_up_file]\n", argv[0]);
+				return(EXIT_FAILURE);
+		}
+	}
+
+	bmp180_sim_init(&sim);
+	sim.clock = sim_clock;
+	printf("%-16s %8s %8s %8s %s\n", "# mode", "ms/out", "delay_ms",
+			"rms_Pa", "n");
+	mode("oss0", 0, 0, -1, n);
+
+	if (!fp) {
+		mode("oss1", 1, 0, -1, n);
+		mode("oss2", 2, 0, -1, n);
+		mode("oss3", 3, 0, -1, n);
+		mode("oss3_avg32", 3, 5, -1, n);
+	}
+
+	mode("oss0_avg32", 0, 5, -1, n);
+
+	for (int8_t r = 1; r <= CIC_RATE_MAX; r++) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "oss0_cic%u", 1U << r);
+		mode(name, 0, 0, r, n);
+	}
+
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,173 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file fake_i2cdev.c
+ * \brief i2c-dev stand-in with a simulated BMP180 at 0x77.
+ *
+ * LD_PRELOAD=./fake_i2cdev.so ./bmp180d -d /dev/i2c-fake
+ *
+ * Every open of a /dev/i2c-* path gets an fd of /dev/null, the
+ * I2C_RDWR ioctl on it is answered by the model in bmp180_sim.c.
+ * The environment BMP180_SIM_T (0.1 C) and BMP180_SIM_P (Pa) set
+ * the simulated weather.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "bmp180_sim.h"
+
+#define FAKE_FDS 1024
+
+static uint8_t fake[FAKE_FDS];
+static struct bmp180_sim_t sim;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void sim_init(void)
+{
+	char *env;
+
+	bmp180_sim_init(&sim);
+	env = getenv("BMP180_SIM_T");
+
+	if (env)
+		sim.T = atol(env);
+
+	env = getenv("BMP180_SIM_P");
+
+	if (env)
+		sim.p = atol(env);
+}
+
+static int fake_open(const char *path, int flags, mode_t mode,
+		const char *sym)
+{
+	int (*real)(const char *, int, ...);
+	int fd;
+
+	real = (int (*)(const char *, int, ...))dlsym(RTLD_NEXT, sym);
+
+	if (strncmp(path, "/dev/i2c-", 9))
+		return(real(path, flags, mode));
+
+	pthread_once(&once, sim_init);
+	fd = real("/dev/null", O_RDWR, 0);
+
+	if ((fd >= 0) && (fd < FAKE_FDS))
+		fake[fd] = 1;
+
+	return(fd);
+}
+
+int open(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode;
+
+	va_start(ap, flags);
+	mode = (flags & O_CREAT) ? va_arg(ap, mode_t) : 0;
+	va_end(ap);
+	return(fake_open(path, flags, mode, "open"));
+}
+
+int open64(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode;
+
+	va_start(ap, flags);
+	mode = (flags & O_CREAT) ? va_arg(ap, mode_t) : 0;
+	va_end(ap);
+	return(fake_open(path, flags, mode, "open64"));
+}
+
+int close(int fd)
+{
+	int (*real)(int);
+
+	real = (int (*)(int))dlsym(RTLD_NEXT, "close");
+
+	if ((fd >= 0) && (fd < FAKE_FDS))
+		fake[fd] = 0;
+
+	return(real(fd));
+}
+
+static int rdwr(struct i2c_rdwr_ioctl_data *rdwr)
+{
+	uint32_t i;
+
+	/* the whole combined message or nothing */
+	for (i = 0; i < rdwr->nmsgs; i++)
+		if (rdwr->msgs[i].addr != BMP180_SIM_ADDR) {
+			errno = ENXIO;
+			return(-1);
+		}
+
+	pthread_mutex_lock(&lock);
+
+	for (i = 0; i < rdwr->nmsgs; i++)
+		if (rdwr->msgs[i].flags & I2C_M_RD)
+			bmp180_sim_read(&sim, rdwr->msgs[i].buf,
+					rdwr->msgs[i].len);
+		else
+			bmp180_sim_write(&sim, rdwr->msgs[i].buf,
+					rdwr->msgs[i].len);
+
+	pthread_mutex_unlock(&lock);
+	return((int)rdwr->nmsgs);
+}
+
+int ioctl(int fd, unsigned long req, ...)
+{
+	int (*real)(int, unsigned long, ...);
+	va_list ap;
+	void *arg;
+
+	va_start(ap, req);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	if ((fd < 0) || (fd >= FAKE_FDS) || !fake[fd]) {
+		real = (int (*)(int, unsigned long, ...))dlsym(RTLD_NEXT,
+				"ioctl");
+		return(real(fd, req, arg));
+	}
+
+	switch (req) {
+		case I2C_RDWR:
+			return(rdwr((struct i2c_rdwr_ioctl_data *)arg));
+		case I2C_FUNCS:
+			*(unsigned long *)arg = I2C_FUNC_I2C;
+			return(0);
+		case I2C_SLAVE:
+		case I2C_SLAVE_FORCE:
+			return(0);
+		default:
+			errno = ENOTTY;
+			return(-1);
+	}
+}
@@ -0,0 +1,329 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*! \file fusion_noise.c
+ * \brief Noise of the fused pressure against the single sensors.
+ *
+ * fusion_noise [-n outputs] [-s sensors] [-o oss] [-k spike_pct]
+ *              [-f file]
+ *
+ * Without -f every sensor is a register model of bmp180_sim.c with
+ * the datasheet RMS noise of the oss, its own offset and seed. The
+ * pressure moves 100 Pa in a 2 minutes sine, the sensors are read
+ * one after the other and fused every 50 ms. Sensor 1 spikes
+ * 200 .. 1000 Pa on spike_pct % of its samples (1).
+ *
+ * With -f the "t p0 p1 ..." lines of the file are fused instead,
+ * t in ms and p in Pa, ex. sensors at rest read by the application.
+ *
+ * The noise is the RMS of the error from the simulated pressure,
+ * its mean removed, or of a file the RMS of the difference of two
+ * samples over sqrt(2). The first 256 outputs are skipped, the
+ * offsets are learning. Rows: every sensor, the plain mean and the
+ * median of the sensors and the fusion.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "bmp180.h"
+#include "bmp180_sim.h"
+#include "fusion.h"
+
+#define WARM 256
+#define PERIOD_MS 50
+#define ROWS (FUSION_SIZE + 3)
+
+/* driver waits, UT then oss 0..3 */
+static const uint8_t conv_ms[5] = { 5, 5, 8, 14, 26 };
+/* sensor offsets, Pa */
+static const int16_t bias[FUSION_SIZE] = { 40, -25, 10, -30 };
+
+static struct bmp180_sim_t sim[FUSION_SIZE];
+static uint64_t now_us;
+
+/* error statistics of a row */
+struct err_t {
+	double sum;
+	double sum2;
+	double last;
+	uint32_t n;
+};
+
+static struct err_t err[ROWS];
+static const char *names[ROWS];
+
+static uint64_t sim_clock(void)
+{
+	return(now_us);
+}
+
+/* the simulated pressure at now_us */
+static int32_t truth(void)
+{
+	return(BMP180_SEALEVEL + (int32_t)lround(50 *
+				sin(2 * M_PI * now_us / 120e6)));
+}
+
+/* a conversion of the model, as the driver does it */
+static int32_t convert(struct bmp180_sim_t *s, const uint8_t cmd,
+		const uint8_t oss)
+{
+	uint8_t buf[3];
+
+	buf[0] = BMP180_REG_CTRL;
+	buf[1] = cmd;
+	bmp180_sim_write(s, buf, 2);
+	now_us += conv_ms[(cmd == 0x2e) ? 0 : oss + 1] * 1000;
+	buf[0] = BMP180_REG_ADC;
+	bmp180_sim_write(s, buf, 1);
+	bmp180_sim_read(s, buf, 3);
+
+	if (cmd == 0x2e)
+		return((buf[0] << 8) | buf[1]);
+
+	return((((int32_t)buf[0] << 16) | (buf[1] << 8) | buf[2]) >>
+			(8 - oss));
+}
+
+/* x is the error, or with diff the value */
+static void put(struct err_t *e, const double x, const uint8_t diff)
+{
+	double d = x;
+
+	if (diff) {
+		d = (x - e->last) / M_SQRT2;
+		e->last = x;
+
+		if (!e->n++)
+			return;
+	} else {
+		e->n++;
+	}
+
+	e->sum += d;
+	e->sum2 += d * d;
+}
+
+static double rms(const struct err_t *e)
+{
+	uint32_t n = e->n;
+	double m;
+
+	if (n < 2)
+		return(0);
+
+	m = e->sum / n;
+	return(sqrt(e->sum2 / n - m * m));
+}
+
+static int cmp(const void *a, const void *b)
+{
+	return((*(const int32_t *)a > *(const int32_t *)b) -
+			(*(const int32_t *)a < *(const int32_t *)b));
+}
+
+/* one output: the sensors p[], the fusion, the statistics */
+static void output(struct fusion_t *fusion, const uint8_t n,
+		const uint16_t *t, const int32_t *p, const uint16_t t_out,
+		const int32_t ref, const uint8_t diff, const uint32_t k)
+{
+	int32_t s[FUSION_SIZE], out;
+	double mean = 0;
+	uint8_t i;
+
+	for (i = 0; i < n; i++) {
+		fusion_put(fusion, i, t[i], p[i]);
+		s[i] = p[i];
+		mean += p[i];
+	}
+
+	fusion_get(fusion, t_out, &out);
+
+	if (k < WARM)
+		return;
+
+	qsort(s, n, sizeof(int32_t), cmp);
+
+	for (i = 0; i < n; i++)
+		put(&err[i], p[i] - (diff ? 0 : ref + bias[i]), diff);
+
+	put(&err[FUSION_SIZE], mean / n - ref, diff);
+	put(&err[FUSION_SIZE + 1], ((n & 1) ? s[n >> 1] :
+				(s[(n >> 1) - 1] + s[n >> 1]) / 2.0) - ref, diff);
+	put(&err[FUSION_SIZE + 2], (double)fusion->out / (1 << FUSION_FRAC) -
+			ref, diff);
+}
+
+static uint32_t simulate(struct fusion_t *fusion, const uint8_t n,
+		const uint8_t oss, const uint32_t spike, const uint32_t outputs)
+{
+	uint16_t t[FUSION_SIZE];
+	int32_t p[FUSION_SIZE], ut, up, B5;
+	uint64_t start;
+	uint32_t k;
+	uint8_t i;
+
+	for (i = 0; i < n; i++) {
+		bmp180_sim_init(&sim[i]);
+		sim[i].clock = sim_clock;
+		sim[i].seed = 0x18051805 + 7919 * i;
+	}
+
+	for (k = 0; k < outputs; k++) {
+		start = now_us;
+
+		for (i = 0; i < n; i++) {
+			bmp180_sim_set(&sim[i], 250, truth() + bias[i]);
+			ut = convert(&sim[i], 0x2e, 0);
+			up = convert(&sim[i], 0x34 | (oss << 6), oss);
+			B5 = bmp180_math_b5(&sim[i].cal, ut);
+			p[i] = bmp180_math_pressure(&sim[i].cal, B5, up, oss);
+			t[i] = now_us / 1000;
+
+			if ((i == 1) && ((uint32_t)rand() % 10000 < spike))
+				p[i] += ((rand() & 1) ? 1 : -1) *
+					(200 + rand() % 801);
+		}
+
+		output(fusion, n, t, p, now_us / 1000, truth(), 0, k);
+		now_us = start + PERIOD_MS * 1000;
+	}
+
+	return(k);
+}
+
+static uint32_t replay(struct fusion_t *fusion, FILE *fp, uint8_t *n)
+{
+	uint16_t t[FUSION_SIZE];
+	int32_t p[FUSION_SIZE];
+	char line[256], *s, *e;
+	unsigned long ms;
+	uint32_t k = 0;
+	uint8_t i;
+
+	while (fgets(line, sizeof(line), fp)) {
+		ms = strtoul(line, &s, 0);
+
+		if (s == line)
+			continue;
+
+		for (i = 0; i < FUSION_SIZE; i++) {
+			p[i] = strtol(s, &e, 0);
+
+			if (e == s)
+				break;
+
+			t[i] = ms;
+			s = e;
+		}
+
+		if (i < 2)
+			continue;
+
+		if (!k) {
+			*n = i;
+			fusion_init(fusion, i);
+		} else if (i != *n) {
+			continue;
+		}
+
+		output(fusion, *n, t, p, ms, 0, 1, k++);
+	}
+
+	return(k);
+}
+
+int main(int argc, char **argv)
+{
+	struct fusion_t fusion;
+	uint32_t outputs = 20000, spike = 100, got;
+	uint8_t n = FUSION_SIZE, oss = 1, i;
+	char name[FUSION_SIZE][8];
+	FILE *fp = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:o:k:f:")) != -1) {
+		switch (opt) {
+			case 'n':
+				outputs = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				n = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				oss = strtoul(optarg, NULL, 0);
+				break;
+			case 'k':
+				spike = (uint32_t)(atof(optarg) * 100);
+				break;
+			case 'f':
+				fp = fopen(optarg, "r");
+
+				if (!fp) {
+					perror(optarg);
+					return(EXIT_FAILURE);
+				}
+
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-n outputs] "
+						"[-s sensors] [-o oss] [-k spike_pct] "
+						"[-f file]\n", argv[0]);
+				return(EXIT_FAILURE);
+		}
+	}
+
+	if ((n < 2) || (n > FUSION_SIZE) || (oss > BMP180_RES_ULTRAHIGH)) {
+		fprintf(stderr, "2 .. %u sensors, oss 0 .. 3\n", FUSION_SIZE);
+		return(EXIT_FAILURE);
+	}
+
+	if (fp) {
+		got = replay(&fusion, fp, &n);
+	} else {
+		fusion_init(&fusion, n);
+		got = simulate(&fusion, n, oss, spike, outputs);
+	}
+
+	if (got <= WARM) {
+		fprintf(stderr, "%u outputs, the first %u are skipped\n", got,
+				WARM);
+		return(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < n; i++) {
+		snprintf(name[i], sizeof(name[i]), "sensor%u", i);
+		names[i] = name[i];
+	}
+
+	names[FUSION_SIZE] = "mean";
+	names[FUSION_SIZE + 1] = "median";
+	names[FUSION_SIZE + 2] = "fusion";
+	printf("%-8s %8s %s\n", "# row", "rms_Pa", "outliers");
+
+	for (i = 0; i < ROWS; i++)
+		if (names[i])
+			printf("%-8s %8.2f %u\n", names[i], rms(&err[i]),
+					(i < n) ? fusion.outliers[i] : 0);
+
+	printf("# %u outputs, %u sensors\n", got, n);
+	return(EXIT_SUCCESS);
+}
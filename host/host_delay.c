@@ -0,0 +1,40 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <stddef.h>
+#include "util/delay.h"
+
+/*! If set, called instead of sleeping. */
+void (*host_delay_hook)(double us) = NULL;
+
+/*! Sleep for us microseconds. */
+void host_delay_us(double us)
+{
+	struct timespec ts;
+
+	if (host_delay_hook) {
+		host_delay_hook(us);
+		return;
+	}
+
+	ts.tv_sec = (time_t)(us / 1e6);
+	ts.tv_nsec = (long)((us - ts.tv_sec * 1e6) * 1e3);
+
+	while (nanosleep(&ts, &ts) && (errno == EINTR));
+}
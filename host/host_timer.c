@@ -0,0 +1,58 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host_timer.c
+ * \brief Host replacement of timer.c and of the UART output.
+ *
+ * timer_cycles() counts 16Mhz cycles of CLOCK_MONOTONIC, as the
+ * Timer1 counter of the AVR, uart_putchar() writes on stdout.
+ * Used to record the i2c transactions on the host, see i2c_rec.h.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "timer.h"
+#include "uart.h"
+
+static struct timespec epoch;
+
+void timer_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+}
+
+void timer_shut(void)
+{
+}
+
+uint32_t timer_cycles(void)
+{
+	struct timespec ts;
+	int64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ns = (int64_t)(ts.tv_sec - epoch.tv_sec) * 1000000000 +
+		ts.tv_nsec - epoch.tv_nsec;
+	return((uint32_t)(ns * 16 / 1000));
+}
+
+void uart_putchar(const uint8_t port, const char c)
+{
+	(void)port;
+	putchar(c);
+}
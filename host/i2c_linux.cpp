@@ -0,0 +1,162 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <util/twi.h>
+/* the i2c.h one, not the ioctl */
+#undef I2C_TIMEOUT
+#include "i2c_linux.h"
+#include "i2c_rec.h"
+
+bool I2C::initialized = false;
+
+/*! Open the adapter.
+ *
+ * \param dev ex. /dev/i2c-1.
+ * \return 0 - OK, -1 - error, see errno.
+ */
+int i2c_linux_open(struct i2c_bus_t *bus, const char *dev)
+{
+	bus->wlen = 0;
+	bus->fd = open(dev, O_RDWR);
+	return((bus->fd < 0) ? -1 : 0);
+}
+
+void i2c_linux_close(struct i2c_bus_t *bus)
+{
+	if (bus->fd >= 0)
+		close(bus->fd);
+
+	bus->fd = -1;
+}
+
+// Nothing to do, the kernel owns the adapter.
+void I2C::Init()
+{
+	initialized = true;
+}
+
+void I2C::Shut()
+{
+	initialized = false;
+}
+
+I2C::I2C(uint8_t addr, struct i2c_bus_t *sbus) :
+	status{0}, address{addr}, bus{sbus}
+{
+	initialized = true;
+}
+
+/*! i2c Master Trasmitter/Receive Mode.
+ *
+ * Same as the TWI one, the errors are the TWI NACK codes.
+ */
+uint8_t I2C::tx(const bool rw, const uint16_t lenght,
+		uint8_t *data, bool stop)
+{
+	struct i2c_msg msg[2];
+	struct i2c_rdwr_ioctl_data rdwr;
+	uint8_t n;
+
+	I2C_REC_BEGIN();
+
+	if (!bus || (bus->fd < 0)) {
+		status = TW_NO_INFO;
+		I2C_REC_END(address | rw, lenght, data, stop, status);
+		return(status);
+	}
+
+	/* keep it for the combined transaction */
+	if (!rw && !stop && !bus->wlen && (lenght <= I2C_LINUX_WMAX)) {
+		bus->waddr = address >> 1;
+		bus->wlen = lenght;
+		memcpy(bus->wbuf, data, lenght);
+		status = 0;
+		I2C_REC_END(address | rw, lenght, data, stop, status);
+		return(status);
+	}
+
+	n = 0;
+
+	if (bus->wlen) {
+		msg[n].addr = bus->waddr;
+		msg[n].flags = 0;
+		msg[n].len = bus->wlen;
+		msg[n].buf = bus->wbuf;
+		n++;
+	}
+
+	msg[n].addr = address >> 1;
+	msg[n].flags = rw ? I2C_M_RD : 0;
+	msg[n].len = lenght;
+	msg[n].buf = data;
+	n++;
+
+	rdwr.msgs = msg;
+	rdwr.nmsgs = n;
+	bus->wlen = 0;
+
+	if (ioctl(bus->fd, I2C_RDWR, &rdwr) < 0)
+		status = rw ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+	else
+		status = 0;
+
+	I2C_REC_END(address | rw, lenght, data, stop, status);
+	return(status);
+}
+
+/*! I2C General Call */
+uint8_t I2C::gc(const uint8_t call)
+{
+	struct i2c_msg msg;
+	struct i2c_rdwr_ioctl_data rdwr;
+	uint8_t i;
+
+	switch(call) {
+		case I2C_GC_RESET:
+		default:
+			/* Send the General Call reset */
+			i = 0x06;
+	}
+
+	if (!bus || (bus->fd < 0)) {
+		status = TW_NO_INFO;
+		return(status);
+	}
+
+	msg.addr = 0;
+	msg.flags = 0;
+	msg.len = 1;
+	msg.buf = &i;
+	rdwr.msgs = &msg;
+	rdwr.nmsgs = 1;
+	status = (ioctl(bus->fd, I2C_RDWR, &rdwr) < 0) ? TW_MT_SLA_NACK : 0;
+	return(status);
+}
+
+/*! The adapter driver of the kernel does the bus recovery. */
+uint8_t I2C::recover()
+{
+	status = 0;
+	return(status);
+}
@@ -0,0 +1,51 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_linux.h
+ * \brief The I2C class on a Linux /dev/i2c-N adapter.
+ *
+ * A write without the stop is kept in the bus and sent together
+ * with the next transaction in a single I2C_RDWR ioctl, so the
+ * register address write and the read are one combined message
+ * with a repeated start, as on the TWI.
+ *
+ * The address is the 8 bit one used by the AVR code (0xee), the
+ * 7 bit address is sent to the kernel.
+ */
+
+#ifndef I2C_LINUX_DEF
+#define I2C_LINUX_DEF
+
+#include <stdint.h>
+#include "i2c.h"
+
+/*! Max bytes of a pending write. */
+#define I2C_LINUX_WMAX 32
+
+/*! A Linux i2c adapter. */
+struct i2c_bus_t {
+	int fd;
+	/* pending write without stop */
+	uint8_t waddr;
+	uint8_t wlen;
+	uint8_t wbuf[I2C_LINUX_WMAX];
+};
+
+int i2c_linux_open(struct i2c_bus_t *bus, const char *dev);
+void i2c_linux_close(struct i2c_bus_t *bus);
+
+#endif
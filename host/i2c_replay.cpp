@@ -0,0 +1,266 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/twi.h>
+#include "i2c_replay.h"
+
+bool I2C::initialized = false;
+
+/*! Load a trace.
+ *
+ * \return 0 - OK, -1 - error, see errno, -2 - not a trace.
+ */
+int i2c_replay_open(struct i2c_bus_t *bus, const char *file)
+{
+	FILE *fp;
+	long size;
+
+	memset(bus, 0, sizeof(*bus));
+	fp = fopen(file, "rb");
+
+	if (!fp)
+		return(-1);
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	bus->buf = (uint8_t *)malloc(size > 0 ? size : 1);
+
+	if (!bus->buf || (fread(bus->buf, 1, size, fp) != (size_t)size)) {
+		fclose(fp);
+		free(bus->buf);
+		bus->buf = NULL;
+		return(-1);
+	}
+
+	fclose(fp);
+	bus->size = size;
+
+	if ((size < 4) || memcmp(bus->buf, "I2R", 3) ||
+			(bus->buf[3] != I2C_REC_VERSION)) {
+		i2c_replay_close(bus);
+		return(-2);
+	}
+
+	bus->pos = 4;
+	return(0);
+}
+
+void i2c_replay_close(struct i2c_bus_t *bus)
+{
+	free(bus->buf);
+	bus->buf = NULL;
+	bus->end = true;
+}
+
+static bool get(struct i2c_bus_t *bus, size_t *pos, uint8_t *c,
+		uint8_t *sum)
+{
+	if (*pos >= bus->size)
+		return(false);
+
+	*c = bus->buf[(*pos)++];
+	*sum += *c;
+	return(true);
+}
+
+static bool get_varint(struct i2c_bus_t *bus, size_t *pos, uint32_t *n,
+		uint8_t *sum)
+{
+	uint8_t c, shift;
+
+	*n = 0;
+
+	for (shift = 0; shift < 35; shift += 7) {
+		if (!get(bus, pos, &c, sum))
+			return(false);
+
+		*n |= (uint32_t)(c & 0x7f) << shift;
+
+		if (!(c & 0x80))
+			return(true);
+	}
+
+	return(false);
+}
+
+/* decode the record at pos, false if truncated or corrupted */
+static bool decode(struct i2c_bus_t *bus, size_t *pos,
+		struct i2c_rec_t *rec)
+{
+	uint32_t n;
+	uint16_t i;
+	uint8_t sum, c, dummy;
+
+	sum = 0;
+	memset(rec, 0, sizeof(*rec));
+
+	if (!get(bus, pos, &rec->hdr, &sum) ||
+			((rec->hdr & I2C_REC_HDR_MASK) != I2C_REC_HDR))
+		return(false);
+
+	if (rec->hdr & I2C_REC_LOST) {
+		/* the records lost */
+		if (!get(bus, pos, &rec->status, &sum))
+			return(false);
+	} else {
+		if (!get(bus, pos, &rec->addr, &sum))
+			return(false);
+
+		if ((rec->hdr & I2C_REC_ERR) &&
+				!get(bus, pos, &rec->status, &sum))
+			return(false);
+
+		if (!get_varint(bus, pos, &rec->dt, &sum) ||
+				!get_varint(bus, pos, &rec->dur, &sum) ||
+				!get_varint(bus, pos, &n, &sum) ||
+				(n > sizeof(rec->data)))
+			return(false);
+
+		rec->lenght = n;
+
+		for (i = 0; i < rec->lenght; i++)
+			if (!get(bus, pos, &rec->data[i], &sum))
+				return(false);
+	}
+
+	return(get(bus, pos, &c, &dummy) && (c == sum));
+}
+
+/*! The next record.
+ *
+ * The bytes not forming a valid record, a corrupted record or the
+ * text printed on the same UART, are skipped. The lost records are
+ * counted.
+ *
+ * \return 1 - a record, 0 - end of the trace.
+ */
+int i2c_replay_next(struct i2c_bus_t *bus, struct i2c_rec_t *rec)
+{
+	size_t pos;
+
+	while (bus->buf && (bus->pos < bus->size)) {
+		pos = bus->pos;
+
+		if (!decode(bus, &pos, rec)) {
+			/* resync on the next byte */
+			bus->skipped++;
+			bus->pos++;
+			continue;
+		}
+
+		bus->pos = pos;
+
+		if (rec->hdr & I2C_REC_LOST) {
+			bus->lost += rec->status;
+			continue;
+		}
+
+		bus->now += rec->dt;
+		bus->records++;
+		return(1);
+	}
+
+	bus->end = true;
+	return(0);
+}
+
+// Nothing to do, there is no bus.
+void I2C::Init()
+{
+	initialized = true;
+}
+
+void I2C::Shut()
+{
+	initialized = false;
+}
+
+I2C::I2C(uint8_t addr, struct i2c_bus_t *sbus) :
+	status{0}, address{addr}, bus{sbus}
+{
+	initialized = true;
+}
+
+/*! i2c Master Trasmitter/Receive Mode from the trace. */
+uint8_t I2C::tx(const bool rw, const uint16_t lenght,
+		uint8_t *data, bool stop)
+{
+	struct i2c_rec_t rec;
+
+	(void)stop;
+
+	if (!bus || !i2c_replay_next(bus, &rec)) {
+		status = TW_NO_INFO;
+		return(status);
+	}
+
+	if (bus->verbose)
+		fprintf(stderr, "%u %s 0x%02x len %u dur %u status 0x%02x\n",
+				bus->records, (rec.addr & 1) ? "R" : "W",
+				rec.addr & 0xfe, rec.lenght, rec.dur,
+				rec.status);
+
+	if (bus->hook)
+		bus->hook(bus, &rec);
+
+	if ((rec.addr != (address | rw)) || (rec.lenght != lenght) ||
+			(!rw && memcmp(rec.data, data, lenght))) {
+		bus->mismatch++;
+
+		if (bus->verbose)
+			fprintf(stderr, "%u mismatch, driver %s 0x%02x "
+					"len %u\n", bus->records,
+					rw ? "R" : "W", address, lenght);
+
+		status = TW_NO_INFO;
+		return(status);
+	}
+
+	if (rw)
+		memcpy(data, rec.data, lenght);
+
+	status = rec.status;
+	return(status);
+}
+
+/*! I2C General Call */
+uint8_t I2C::gc(const uint8_t call)
+{
+	uint8_t i;
+
+	switch(call) {
+		case I2C_GC_RESET:
+		default:
+			/* Send the General Call reset */
+			i = 0x06;
+			tx(WRITE, 1, &i);
+	}
+
+	return(status);
+}
+
+/*! Not recorded, nothing to replay. */
+uint8_t I2C::recover()
+{
+	status = 0;
+	return(status);
+}
@@ -0,0 +1,71 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_replay.h
+ * \brief The I2C class replaying a recorded trace, see i2c_rec.h.
+ *
+ * Each I2C::tx() of the driver consumes the next record: the
+ * address, the direction, the lenght and the bytes written must
+ * match, a read gets the recorded bytes and every transaction the
+ * recorded status. A transaction not matching is counted and gets
+ * TW_NO_INFO, as the end of the trace.
+ */
+
+#ifndef I2C_REPLAY_DEF
+#define I2C_REPLAY_DEF
+
+#include <stdint.h>
+#include <stddef.h>
+#include "i2c.h"
+#include "i2c_rec.h"
+
+/*! A decoded record. */
+struct i2c_rec_t {
+	uint8_t hdr;
+	uint8_t addr;
+	uint8_t status;
+	uint32_t dt;
+	uint32_t dur;
+	uint16_t lenght;
+	uint8_t data[256];
+};
+
+/*! A recorded trace. */
+struct i2c_bus_t {
+	uint8_t *buf;
+	size_t size;
+	size_t pos;
+	/*! recorded time of the current record, cycles. */
+	uint64_t now;
+	uint32_t records;
+	uint32_t lost;
+	/*! bytes not part of a record, ex. text on the same UART. */
+	uint32_t skipped;
+	uint32_t mismatch;
+	/*! the trace is over. */
+	bool end;
+	/*! print every record on stderr. */
+	bool verbose;
+	/*! called on every replayed record, can be NULL. */
+	void (*hook)(struct i2c_bus_t *bus, const struct i2c_rec_t *rec);
+};
+
+int i2c_replay_open(struct i2c_bus_t *bus, const char *file);
+void i2c_replay_close(struct i2c_bus_t *bus);
+int i2c_replay_next(struct i2c_bus_t *bus, struct i2c_rec_t *rec);
+
+#endif
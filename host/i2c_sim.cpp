@@ -0,0 +1,221 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <util/twi.h>
+#include <util/delay.h>
+#include "i2c_sim.h"
+
+/*! A byte and its ACK on the bus, us. */
+#define BYTE_US (9 * 1e6 / I2C_SIM_HZ)
+
+bool I2C::initialized = false;
+
+/*! A bus with the chip at power on, no faults. */
+void i2c_sim_init(struct i2c_bus_t *bus)
+{
+	bmp180_sim_init(&bus->sim);
+	bus->fault = NULL;
+	bus->seed = 1;
+	bus->stuck = false;
+	memset(&bus->stat, 0, sizeof(bus->stat));
+}
+
+/** Inject faults.
+ *
+ * @param f the faults, NULL none, it must last as the bus.
+ * @param seed the random sequence, not 0.
+ */
+void i2c_sim_faults(struct i2c_bus_t *bus, const struct i2c_sim_fault_t *f,
+		uint32_t seed)
+{
+	bus->fault = f;
+	bus->seed = seed ? seed : 1;
+	bus->stuck = false;
+	memset(&bus->stat, 0, sizeof(bus->stat));
+}
+
+/*! xorshift32, true with probability ppm. */
+static bool roll(struct i2c_bus_t *bus, const uint32_t ppm)
+{
+	if (!ppm)
+		return(false);
+
+	bus->seed ^= bus->seed << 13;
+	bus->seed ^= bus->seed >> 17;
+	bus->seed ^= bus->seed << 5;
+	return((bus->seed % 1000000) < ppm);
+}
+
+/*! The bus time of a byte, stretched or not.
+ *
+ * @return 0 or TW_NO_INFO, the stretch is longer than the timeout.
+ */
+static uint8_t byte_time(struct i2c_bus_t *bus)
+{
+	const struct i2c_sim_fault_t *f = bus->fault;
+
+	host_delay_us(BYTE_US);
+
+	if (!roll(bus, f->stretch))
+		return(0);
+
+	bus->stat.stretch++;
+
+	if (f->timeout_us && (f->stretch_us > f->timeout_us)) {
+		bus->stat.timeout++;
+		host_delay_us(f->timeout_us);
+		return(TW_NO_INFO);
+	}
+
+	host_delay_us(f->stretch_us);
+	return(0);
+}
+
+/*! A transaction with faults, see i2c_sim.h. */
+static uint8_t faulty_tx(struct i2c_bus_t *bus, const bool rw,
+		const uint16_t lenght, uint8_t *data)
+{
+	const struct i2c_sim_fault_t *f = bus->fault;
+	uint16_t i;
+	uint8_t err;
+
+	// START and the address
+	host_delay_us(BYTE_US);
+
+	if (bus->stuck)
+		return(TW_MT_ARB_LOST);
+
+	if (roll(bus, f->stuck)) {
+		bus->stat.stuck++;
+		bus->stuck = true;
+		return(TW_MT_ARB_LOST);
+	}
+
+	if (roll(bus, f->arb_lost)) {
+		bus->stat.arb_lost++;
+		return(TW_MT_ARB_LOST);
+	}
+
+	if (roll(bus, f->nack_addr)) {
+		bus->stat.nack_addr++;
+		return(rw ? TW_MR_SLA_NACK : TW_MT_SLA_NACK);
+	}
+
+	if (rw) {
+		for (i = 0; i < lenght; i++) {
+			err = byte_time(bus);
+
+			if (err)
+				return(err);
+		}
+
+		bmp180_sim_read(&bus->sim, data, lenght);
+
+		for (i = 0; i < lenght; i++)
+			if (roll(bus, f->corrupt)) {
+				bus->stat.corrupt++;
+				data[i] ^= 1 << (bus->seed & 7);
+			}
+	} else {
+		for (i = 0; i < lenght; i++) {
+			err = byte_time(bus);
+
+			if (!err && roll(bus, f->nack_data)) {
+				bus->stat.nack_data++;
+				err = TW_MT_DATA_NACK;
+			}
+
+			if (err) {
+				// the chip got the bytes before
+				bmp180_sim_write(&bus->sim, data, i);
+				return(err);
+			}
+		}
+
+		bmp180_sim_write(&bus->sim, data, lenght);
+	}
+
+	return(0);
+}
+
+// Nothing to do, there is no bus.
+void I2C::Init()
+{
+	initialized = true;
+}
+
+void I2C::Shut()
+{
+	initialized = false;
+}
+
+I2C::I2C(uint8_t addr, struct i2c_bus_t *sbus) :
+	status{0}, address{addr}, bus{sbus}
+{
+	initialized = true;
+}
+
+/*! i2c Master Trasmitter/Receive Mode on the model.
+ *
+ * Same as the TWI one, the errors are the TWI NACK codes.
+ */
+uint8_t I2C::tx(const bool rw, const uint16_t lenght,
+		uint8_t *data, bool stop)
+{
+	(void)stop;
+
+	if (!bus || ((address >> 1) != BMP180_SIM_ADDR)) {
+		status = rw ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+		return(status);
+	}
+
+	if (bus->fault) {
+		status = faulty_tx(bus, rw, lenght, data);
+		return(status);
+	}
+
+	if (rw)
+		bmp180_sim_read(&bus->sim, data, lenght);
+	else
+		bmp180_sim_write(&bus->sim, data, lenght);
+
+	status = 0;
+	return(status);
+}
+
+/*! Free SDA, 9 SCL pulses clock out the chip, then a STOP. */
+uint8_t I2C::recover()
+{
+	if (bus && bus->fault) {
+		host_delay_us(10 * 1e6 / I2C_SIM_HZ);
+		bus->stuck = false;
+		bus->stat.recover++;
+	}
+
+	status = 0;
+	return(status);
+}
+
+/*! I2C General Call, the model has no reset. */
+uint8_t I2C::gc(const uint8_t call)
+{
+	(void)call;
+	status = 0;
+	return(status);
+}
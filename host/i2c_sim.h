@@ -0,0 +1,89 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_sim.h
+ * \brief The I2C class on a simulated BMP180, in process.
+ *
+ * Same model as fake_i2cdev.so without the kernel interface: each
+ * bus has its own chip at 0x77, many sensors can run in a single
+ * process.
+ *
+ * With i2c_sim_faults() the bus injects the faults of a real one,
+ * each with its probability in ppm, and takes the time of a 400Khz
+ * bus through host_delay_us(), a virtual clock with host_delay_hook:
+ *
+ * nack_addr: the address is NACKed, per transaction.
+ * nack_data: a written byte is NACKed, the rest is not written.
+ * arb_lost: another master wins the bus, per transaction.
+ * stuck: the chip holds SDA low, per transaction. Every transaction
+ *   fails with TW_MT_ARB_LOST, as a START on a busy bus, until
+ *   I2C::recover() clocks the chip out.
+ * stretch: the chip holds SCL low for stretch_us, per byte. Longer
+ *   than timeout_us (0 no timeout) the master gives up, TW_NO_INFO.
+ * corrupt: a bit of a read byte is flipped, nothing detects it.
+ */
+
+#ifndef I2C_SIM_DEF
+#define I2C_SIM_DEF
+
+#include <stdint.h>
+#include "i2c.h"
+#include "bmp180_sim.h"
+
+/*! SCL rate of the bus time, Hz */
+#define I2C_SIM_HZ 400000
+
+/*! Faults to inject, probabilities in ppm. */
+struct i2c_sim_fault_t {
+	uint32_t nack_addr;
+	uint32_t nack_data;
+	uint32_t arb_lost;
+	uint32_t stuck;
+	uint32_t stretch;
+	uint32_t corrupt;
+	uint16_t stretch_us;
+	uint16_t timeout_us;
+};
+
+/*! Faults injected and recoveries done. */
+struct i2c_sim_stat_t {
+	uint32_t nack_addr;
+	uint32_t nack_data;
+	uint32_t arb_lost;
+	uint32_t stuck;
+	uint32_t stretch;
+	uint32_t timeout;
+	uint32_t corrupt;
+	uint32_t recover;
+};
+
+/*! A bus with one simulated BMP180. */
+struct i2c_bus_t {
+	struct bmp180_sim_t sim;
+	/*! NULL a perfect bus taking no time. */
+	const struct i2c_sim_fault_t *fault;
+	uint32_t seed;
+	/*! SDA held low by the chip. */
+	bool stuck;
+	struct i2c_sim_stat_t stat;
+};
+
+void i2c_sim_init(struct i2c_bus_t *bus);
+void i2c_sim_faults(struct i2c_bus_t *bus, const struct i2c_sim_fault_t *f,
+		uint32_t seed);
+
+#endif
@@ -0,0 +1,42 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file delay.h
+ * \brief Host replacement of the avr-libc busy wait.
+ *
+ * The delay sleeps, unless host_delay_hook is set, ex. by a
+ * simulator running on a virtual clock.
+ */
+
+#ifndef _HOST_DELAY_H_
+#define _HOST_DELAY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void (*host_delay_hook)(double us);
+void host_delay_us(double us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define _delay_ms(ms) host_delay_us((ms) * 1000.0)
+#define _delay_us(us) host_delay_us(us)
+
+#endif
@@ -0,0 +1,238 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file logger_ram.c
+ * \brief Round trip of logger.c through tools/log2csv.py.
+ *
+ * logger_ram [-t log2csv.py]
+ *
+ * logger.c runs on a RAM device with the EEPROM and the NOR
+ * geometry, NOR semantics: a write only clears bits. The samples
+ * are a 10 s log of a pressure with +-2 Pa noise, time jitter and
+ * T steps. A power loss restarts the logger on the same memory
+ * with the time from 0, as main.c after a reset. logger_dump()
+ * goes to a file decoded by log2csv.py (../tools/log2csv.py).
+ *
+ * The decoded samples must be the last ones logged, all of them
+ * if the ring did not wrap, the last one always: the write through
+ * loses nothing. Prints every failed check, exit status 1 if any.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "logger.h"
+
+#define MAX_MEM 16384
+#define MAX_SAMPLES 6000
+
+struct sample_t {
+	uint32_t t;
+	int32_t p;
+	int16_t T;
+};
+
+static uint8_t mem[MAX_MEM];
+static uint32_t erased;
+static FILE *dump;
+static const char *tool = "../tools/log2csv.py";
+static int failed;
+
+/* the logged samples and the decoded ones */
+static struct sample_t logged[MAX_SAMPLES];
+static struct sample_t decoded[MAX_SAMPLES];
+
+static void ram_read(const uint32_t addr, uint8_t *buf, const uint16_t len)
+{
+	memcpy(buf, &mem[addr], len);
+}
+
+/* NOR, only 1 to 0 */
+static void ram_write(const uint32_t addr, const uint8_t *buf,
+		const uint16_t len)
+{
+	uint16_t i;
+
+	for (i = 0; i < len; i++)
+		mem[addr + i] &= buf[i];
+}
+
+static void ram_erase(const uint32_t addr);
+
+static struct logger_dev_t ram = { 0, 0, ram_read, ram_write, ram_erase };
+
+static void ram_erase(const uint32_t addr)
+{
+	memset(&mem[addr], 0xff, ram.block_size);
+	erased++;
+}
+
+/* logger_dump() output */
+void uart_printstr(const uint8_t port, const char *s)
+{
+	fputs(s, dump);
+}
+
+/* xorshift32 */
+static uint32_t rnd(void)
+{
+	static uint32_t seed = 0x18051805;
+
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return(seed);
+}
+
+/* dump, decode, the samples decoded */
+static int decode(struct logger_t *log)
+{
+	char name[] = "/tmp/logger_ramXXXXXX";
+	char cmd[256], line[64];
+	struct sample_t *s;
+	FILE *csv;
+	long t, p, T;
+	int fd, n;
+
+	fd = mkstemp(name);
+	dump = fdopen(fd, "w");
+	logger_dump(log, line);
+	fclose(dump);
+
+	snprintf(cmd, sizeof(cmd), "python3 %s %s 2>/dev/null", tool, name);
+	csv = popen(cmd, "r");
+	n = 0;
+
+	while (csv && fgets(line, sizeof(line), csv) && (n < MAX_SAMPLES))
+		if (sscanf(line, "%ld,%ld,%ld", &t, &p, &T) == 3) {
+			s = &decoded[n++];
+			s->t = t;
+			s->p = p;
+			s->T = T;
+		}
+
+	if (!csv || pclose(csv))
+		n = -1;
+
+	unlink(name);
+	return(n);
+}
+
+/* n samples on blocks x block_size, a power loss before sample loss */
+static void run(const char *name, const uint16_t block_size,
+		const uint16_t blocks, const int n, const int loss)
+{
+	struct logger_t log;
+	struct sample_t *s;
+	uint32_t t;
+	int32_t p;
+	int16_t T;
+	int i, k;
+
+	ram.block_size = block_size;
+	ram.blocks = blocks;
+	memset(mem, 0xff, sizeof(mem));
+	logger_init(&log, &ram);
+	erased = 0;
+	t = 0;
+	p = 101325;
+	T = 250;
+
+	for (i = 0; i < n; i++) {
+		if (i == loss) {
+			logger_init(&log, &ram);
+			t = 0;
+		}
+
+		t += 100;
+
+		if (!(rnd() % 16))
+			t += (int32_t)(rnd() % 3) - 1;
+
+		p += (int32_t)(rnd() % 5) - 2;
+
+		if (!(rnd() % 50))
+			T += (int16_t)(rnd() % 3) - 1;
+
+		/* a weather front */
+		if (!(rnd() % 500))
+			p += (int32_t)(rnd() % 400) - 200;
+
+		logged[i].t = t;
+		logged[i].p = p;
+		logged[i].T = T;
+		logger_put(&log, t, p, T);
+	}
+
+	k = decode(&log);
+
+	if (k < 0) {
+		printf("FAIL %s: %s did not run\n", name, tool);
+		failed = 1;
+		return;
+	}
+
+	/* no wrap, every block erased once */
+	if (((erased <= blocks) && (k != n)) || (!k && n) || (k > n)) {
+		printf("FAIL %s: %d samples decoded of %d\n", name, k, n);
+		failed = 1;
+		return;
+	}
+
+	for (i = 0; i < k; i++) {
+		s = &logged[n - k + i];
+
+		if ((decoded[i].t != s->t) || (decoded[i].p != s->p) ||
+				(decoded[i].T != s->T)) {
+			printf("FAIL %s: sample %d\n", name, n - k + i);
+			failed = 1;
+			return;
+		}
+	}
+
+	/* since the last init */
+	printf("ok   %s: %d samples, %d decoded, %.2f bytes per sample\n",
+			name, n, k, (float)log.bytes / log.samples);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:")) != -1) {
+		switch (opt) {
+			case 't':
+				tool = optarg;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-t log2csv.py]\n", argv[0]);
+				return(2);
+		}
+	}
+
+	run("eeprom 1", 128, 8, 1, -1);
+	run("eeprom 2", 128, 8, 2, -1);
+	run("eeprom 100", 128, 8, 100, -1);
+	run("eeprom wrap", 128, 8, 5000, -1);
+	run("eeprom loss", 128, 8, 300, 150);
+	run("eeprom loss wrap", 128, 8, 5000, 2500);
+	run("nor", 4096, 4, 5000, -1);
+	run("nor loss", 4096, 4, 5000, 1234);
+	return(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
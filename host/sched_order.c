@@ -0,0 +1,152 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file sched_order.c
+ * \brief Check of the i2c_sched.c transaction order.
+ *
+ * The queue of the TWI scheduler, i2c_queue.c, run on the PC:
+ * priority first, the earliest deadline within a priority, no
+ * deadline last, submission order for the same key, the deadline
+ * compare across the timer wrap and the drop of the expired ones.
+ *
+ * Prints every failed check, exit status 1 if any.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_queue.h"
+
+#define MAX_XFER 8
+
+static struct i2c_xfer_t xfer[MAX_XFER];
+static struct i2c_xfer_t *queue;
+static int failed;
+/* the order of the expired callbacks */
+static char dropped[MAX_XFER + 1];
+
+static void expired(struct i2c_xfer_t *x)
+{
+	size_t n = strlen(dropped);
+
+	x->status = I2C_XFER_EXPIRED;
+	dropped[n] = 'a' + (x - xfer);
+	dropped[n + 1] = 0;
+}
+
+/* put the transactions as "prio deadline" pairs, a, b, c ... */
+static void put(const uint8_t n, const uint8_t *prio,
+		const uint32_t *deadline)
+{
+	uint8_t i;
+
+	queue = NULL;
+	dropped[0] = 0;
+	memset(xfer, 0, sizeof(xfer));
+
+	for (i = 0; i < n; i++) {
+		xfer[i].prio = prio[i];
+		xfer[i].deadline = deadline[i];
+		i2c_queue_put(&queue, &xfer[i]);
+	}
+}
+
+/* the letters of the queue emptied at now */
+static void check(const char *name, const uint32_t now, const char *order,
+		const char *drop)
+{
+	struct i2c_xfer_t *x;
+	char got[MAX_XFER + 1];
+	size_t n = 0;
+
+	while ((x = i2c_queue_get(&queue, now, expired)))
+		got[n++] = 'a' + (x - xfer);
+
+	got[n] = 0;
+
+	if (strcmp(got, order) || strcmp(dropped, drop)) {
+		printf("FAIL %s: order %s dropped %s, expected %s %s\n", name,
+				got, dropped, order, drop);
+		failed = 1;
+	} else {
+		printf("ok   %s: %s\n", name, got);
+	}
+}
+
+int main(void)
+{
+	/* priority beats the deadline */
+	{
+		const uint8_t prio[] = { I2C_SCHED_PRIO_BULK,
+			I2C_SCHED_PRIO_NORMAL, I2C_SCHED_PRIO_RT,
+			I2C_SCHED_PRIO_NORMAL };
+		const uint32_t deadline[] = { 100, 0, 900, 200 };
+
+		put(4, prio, deadline);
+		check("priority", 0, "cdba", "");
+	}
+
+	/* earliest deadline first, none last, FIFO for the same key */
+	{
+		const uint8_t prio[] = { 1, 1, 1, 1, 1, 1 };
+		const uint32_t deadline[] = { 0, 500, 300, 0, 300, 400 };
+
+		put(6, prio, deadline);
+		check("deadline", 0, "cefbad", "");
+	}
+
+	/* deadlines across the wrap of timer_cycles() */
+	{
+		const uint8_t prio[] = { 0, 0, 0 };
+		const uint32_t deadline[] = { 0x10, 0xfffffff0, 0x100 };
+
+		put(3, prio, deadline);
+		check("wrap", 0xffffff00, "bac", "");
+	}
+
+	/* past the deadline dropped, at the deadline still run */
+	{
+		const uint8_t prio[] = { 0, 1, 0, 2 };
+		const uint32_t deadline[] = { 1000, 999, 1001, 0 };
+
+		put(4, prio, deadline);
+		check("expired", 1000, "acd", "b");
+		put(4, prio, deadline);
+		check("expired", 1001, "cd", "ab");
+
+		if (xfer[0].status != I2C_XFER_EXPIRED) {
+			printf("FAIL expired: status %u\n", xfer[0].status);
+			failed = 1;
+		}
+	}
+
+	/* a transaction put back, as a bulk chunk, behind its equals */
+	{
+		const uint8_t prio[] = { 2, 2, 0 };
+		const uint32_t deadline[] = { 0, 0, 0 };
+		struct i2c_xfer_t *x;
+
+		put(3, prio, deadline);
+		i2c_queue_get(&queue, 0, expired);
+		x = i2c_queue_get(&queue, 0, expired);
+		i2c_queue_put(&queue, x);
+		check("requeue", 0, "ba", "");
+	}
+
+	return(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
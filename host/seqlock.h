@@ -0,0 +1,107 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file seqlock.h
+ * \brief Single writer, many readers sequence lock.
+ *
+ * The host twin of latest_put()/latest_get() in queue.c. The
+ * payload is kept in atomic words so the readers racing with the
+ * writer are well defined, and the whole object is address free:
+ * it works between threads and between processes in shared memory.
+ * The writer never waits, a reader retries while it overlaps with
+ * a write.
+ */
+
+#ifndef _SEQLOCK_H_
+#define _SEQLOCK_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+template <class T>
+class Seqlock {
+	static_assert(std::is_trivially_copyable<T>::value,
+			"the payload is copied word by word");
+	static const size_t words = (sizeof(T) + 7) / 8;
+	std::atomic<uint32_t> seq;
+	std::atomic<uint64_t> data[words];
+	public:
+		Seqlock() : seq{0} {}
+
+		/*! Writer side, only one writer at a time. */
+		void put(const T &value)
+		{
+			uint64_t w[words] = {};
+			uint32_t s = seq.load(std::memory_order_relaxed);
+
+			memcpy(w, &value, sizeof(T));
+			seq.store(s + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (size_t i = 0; i < words; i++)
+				data[i].store(w[i], std::memory_order_relaxed);
+
+			seq.store(s + 2, std::memory_order_release);
+		}
+
+		/*! One attempt to read.
+		 *
+		 * \return false if a write was in progress.
+		 */
+		bool try_get(T &value) const
+		{
+			uint64_t w[words];
+			uint32_t s1, s2;
+
+			s1 = seq.load(std::memory_order_acquire);
+
+			if (s1 & 1)
+				return(false);
+
+			for (size_t i = 0; i < words; i++)
+				w[i] = data[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s2 = seq.load(std::memory_order_relaxed);
+
+			if (s1 != s2)
+				return(false);
+
+			memcpy(&value, w, sizeof(T));
+			return(true);
+		}
+
+		/*! Reader side, retries until a consistent copy. */
+		T get() const
+		{
+			T value;
+
+			while (!try_get(value));
+
+			return(value);
+		}
+
+		/*! Number of writes done. */
+		uint32_t version() const
+		{
+			return(seq.load(std::memory_order_acquire) >> 1);
+		}
+};
+
+#endif
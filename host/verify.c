@@ -0,0 +1,470 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file verify.c
+ * \brief Exhaustive check of the integer compensation.
+ *
+ * For every calibration block and oss the whole UT x UP space is
+ * computed with:
+ * - legacy, the original int32 code of bmp180.c, verbatim.
+ * - core, bmp180_math.h, the code the drivers use.
+ * - ref64, the datasheet algorithm in 64 bit, no overflow.
+ *
+ * core must match legacy exactly, legacy vs ref64 shows where the
+ * int32 math overflows. Every intermediate of the int32 code is
+ * also checked and the overflow sites are counted.
+ *
+ * Built with -fwrapv, the signed overflow wraps as it does on
+ * the AVR. The UT values are split across the threads.
+ *
+ * Then the BMP280 driver is checked on the datasheet example, see
+ * verify_bmp280.cpp.
+ *
+ * verify [-j threads] [-u UT step] [-p UP step] [-o oss] [-f calfile]
+ * calfile: one block per line, the 11 coefficients AC1..MD.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bmp180_math.h"
+
+#define MAX_CAL 64
+
+int verify_bmp280(void);
+
+/* the overflow sites of the int32 code */
+enum {
+	SITE_UT_AC5,	/* (UT - AC6) * AC5 */
+	SITE_T_DIV0,	/* x1 + MD == 0 */
+	SITE_B6_SQ,	/* b6 * b6 */
+	SITE_B2,	/* B2 * (b6 * b6 >> 12) */
+	SITE_AC2,	/* AC2 * b6 */
+	SITE_B3,	/* (AC1 * 4 + x3) << oss */
+	SITE_AC3,	/* AC3 * b6 */
+	SITE_B1,	/* B1 * (b6 * b6 >> 12) */
+	SITE_B4,	/* AC4 * (uint32_t)(x3 + 32768) */
+	SITE_B4_DIV0,	/* b4 == 0 */
+	SITE_B7_NEG,	/* (uint32_t)(UP - b3), UP < b3 */
+	SITE_B7,	/* (UP - b3) * (50000 >> oss) */
+	SITE_P_SQ,	/* (p >> 8) * (p >> 8) */
+	SITE_P_3038,	/* x1 * 3038 */
+	SITE_P_7357,	/* -7357 * p */
+	SITE_MAX
+};
+
+static const char *site_name[SITE_MAX] = {
+	"(UT - AC6) * AC5",
+	"x1 + MD == 0 (T division by 0)",
+	"b6 * b6",
+	"B2 * (b6 * b6 >> 12)",
+	"AC2 * b6",
+	"(AC1 * 4 + x3) << oss",
+	"AC3 * b6",
+	"B1 * (b6 * b6 >> 12)",
+	"AC4 * (x3 + 32768)",
+	"b4 == 0 (p division by 0)",
+	"UP - b3 < 0, wraps to uint32",
+	"(UP - b3) * (50000 >> oss)",
+	"(p >> 8) * (p >> 8)",
+	"x1 * 3038",
+	"-7357 * p"
+};
+
+/*! The datasheet example */
+static struct bmp180_cal_t cal[MAX_CAL] = {
+	{ 408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868 }
+};
+static int ncal = 1;
+
+/* the job */
+static struct bmp180_cal_t *job_cal;
+static uint8_t job_oss;
+static uint32_t ut_step = 1, up_step = 1;
+static uint32_t next_ut;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! Per thread and total results. */
+struct result_t {
+	uint64_t points;
+	uint64_t core_t, core_p;	/* core != legacy */
+	uint64_t ref_t, ref_p;		/* legacy != ref64 */
+	uint64_t site[SITE_MAX];
+	/* first legacy != ref64 */
+	int32_t ut, up, p_legacy;
+	int64_t p_ref;
+};
+
+static struct result_t total;
+
+/*! The original bmp180.c math, do not touch. */
+static int32_t legacy_b5(const struct bmp180_cal_t *c, int32_t UT)
+{
+	int32_t x1, x2;
+
+	x1 = (UT - c->AC6) * c->AC5 >> 15;
+	x2 = ((int32_t)c->MC << 11) / (x1 + c->MD);
+	return(x1 + x2);
+}
+
+static int32_t legacy_pressure(const struct bmp180_cal_t *c, int32_t B5,
+		int32_t UP, uint8_t oss)
+{
+	uint32_t b4, b7;
+	int32_t x1, x2, x3, b3, b6, p;
+
+	b6 = B5 - 4000;
+	x1 = (c->B2 * (b6 * b6 >> 12)) >> 11;
+	x2 = c->AC2 * b6 >> 11;
+	x3 = x1 + x2;
+
+	b3 = ((((int32_t)c->AC1 * 4 + x3) << oss) + 2) >> 2;
+	x1 = c->AC3 * b6 >> 13;
+	x2 = (c->B1 * (b6 * b6 >> 12)) >> 16;
+	x3 = (x1 + x2 + 2) >> 2;
+	b4 = (c->AC4 * (uint32_t)(x3 + 32768)) >> 15;
+	b7 = (uint32_t)(UP - b3) * (50000 >> oss);
+
+	if (b7 < 0x80000000)
+		p = (b7 << 1) / b4;
+	else
+		p = (b7 / b4) << 1;
+
+	x1 = (p >> 8) * (p >> 8);
+	x1 = (x1 * 3038) >> 16;
+	x2 = (-7357 * p) >> 16;
+	p += ((x1 + x2 + 3791) >> 4);
+	return(p);
+}
+
+/*! The b4 of legacy_pressure(). */
+static uint32_t legacy_b4(const struct bmp180_cal_t *c, int32_t B5)
+{
+	int32_t x1, x2, x3, b6;
+
+	b6 = B5 - 4000;
+	x1 = c->AC3 * b6 >> 13;
+	x2 = (c->B1 * (b6 * b6 >> 12)) >> 16;
+	x3 = (x1 + x2 + 2) >> 2;
+	return((c->AC4 * (uint32_t)(x3 + 32768)) >> 15);
+}
+
+#define OVF32(x) (((x) > INT32_MAX) || ((x) < INT32_MIN))
+#define OVFU32(x) (((x) > UINT32_MAX) || ((x) < 0))
+
+/*! The 64 bit B5, counting the int32 sites. */
+static int64_t ref_b5(const struct bmp180_cal_t *c, int64_t UT,
+		uint64_t *site, uint64_t w, int *div0)
+{
+	int64_t x1, x2, t;
+
+	t = (UT - c->AC6) * c->AC5;
+	site[SITE_UT_AC5] += OVF32(t) * w;
+	x1 = t >> 15;
+	/* either the wrapped int32 or the 64 bit divisor is 0 */
+	*div0 = (((int32_t)(uint32_t)t >> 15) + c->MD == 0) ||
+		(x1 + c->MD == 0);
+
+	if (*div0) {
+		site[SITE_T_DIV0] += w;
+		return(0);
+	}
+
+	x2 = ((int64_t)c->MC * 2048) / (x1 + c->MD);
+	return(x1 + x2);
+}
+
+/*! The 64 bit head of the pressure, B5 only dependent. */
+struct head_t {
+	int64_t b3, b4;
+	uint32_t sites[SITE_MAX];
+};
+
+static void ref_head(const struct bmp180_cal_t *c, int64_t b5, uint8_t oss,
+		struct head_t *h)
+{
+	int64_t b6, x1, x2, x3, t;
+
+	memset(h->sites, 0, sizeof(h->sites));
+	b6 = b5 - 4000;
+	t = b6 * b6;
+	h->sites[SITE_B6_SQ] = OVF32(t);
+	t = c->B2 * (t >> 12);
+	h->sites[SITE_B2] = OVF32(t);
+	x1 = t >> 11;
+	t = c->AC2 * b6;
+	h->sites[SITE_AC2] = OVF32(t);
+	x2 = t >> 11;
+	x3 = x1 + x2;
+	t = ((int64_t)c->AC1 * 4 + x3) * (1 << oss);
+	h->sites[SITE_B3] = OVF32(t);
+	h->b3 = (t + 2) >> 2;
+	t = c->AC3 * b6;
+	h->sites[SITE_AC3] = OVF32(t);
+	x1 = t >> 13;
+	t = c->B1 * ((b6 * b6) >> 12);
+	h->sites[SITE_B1] = OVF32(t);
+	x2 = t >> 16;
+	x3 = (x1 + x2 + 2) >> 2;
+	t = c->AC4 * (x3 + 32768);
+	h->sites[SITE_B4] = OVFU32(t);
+	h->b4 = t >> 15;
+	h->sites[SITE_B4_DIV0] = (h->b4 == 0);
+}
+
+/*! The 64 bit tail of the pressure. */
+static int64_t ref_tail(const struct head_t *h, int64_t UP, uint8_t oss,
+		uint64_t *site)
+{
+	int64_t b7, p, x1, x2;
+
+	b7 = (UP - h->b3) * (50000 >> oss);
+	site[SITE_B7_NEG] += (UP < h->b3);
+	site[SITE_B7] += OVFU32(b7);
+	p = (b7 * 2) / h->b4;
+	x1 = (p >> 8) * (p >> 8);
+	site[SITE_P_SQ] += OVF32(x1);
+	site[SITE_P_3038] += OVF32(x1 * 3038);
+	x1 = (x1 * 3038) >> 16;
+	site[SITE_P_7357] += OVF32(-7357 * p);
+	x2 = (-7357 * p) >> 16;
+	return(p + ((x1 + x2 + 3791) >> 4));
+}
+
+static void *worker(void *arg)
+{
+	struct result_t r;
+	struct head_t h;
+	struct bmp180_cal_t *c;
+	uint32_t ut, ut_end, up, up_max, n_up;
+	int32_t b5_legacy, b5_core, p_legacy, p_core;
+	int64_t b5_ref, p_ref;
+	uint8_t oss;
+	int div0, i;
+
+	(void)arg;
+	memset(&r, 0, sizeof(r));
+	c = job_cal;
+	oss = job_oss;
+	up_max = 1UL << (16 + oss);
+	n_up = (up_max + up_step - 1) / up_step;
+
+	while (1) {
+		pthread_mutex_lock(&lock);
+		ut = next_ut;
+		next_ut += 256 * ut_step;
+		pthread_mutex_unlock(&lock);
+
+		if (ut > 0xffff)
+			break;
+
+		ut_end = ut + 256 * ut_step;
+
+		for (; (ut < ut_end) && (ut <= 0xffff); ut += ut_step) {
+			b5_ref = ref_b5(c, ut, r.site, n_up, &div0);
+			r.points += n_up;
+
+			/* the int32 code would divide by 0 */
+			if (div0)
+				continue;
+
+			b5_legacy = legacy_b5(c, ut);
+			b5_core = bmp180_math_b5(c, ut);
+
+			if (bmp180_math_temperature(b5_core) !=
+					bmp180_math_temperature(b5_legacy))
+				r.core_t += n_up;
+
+			if (b5_ref != b5_legacy)
+				r.ref_t += n_up;
+
+			ref_head(c, b5_ref, oss, &h);
+
+			for (i = 0; i < SITE_MAX; i++)
+				r.site[i] += h.sites[i] * (uint64_t)n_up;
+
+			/* skip the UP loop, nothing to compare */
+			if (h.sites[SITE_B4_DIV0])
+				continue;
+
+			/* the int32 b4 may be 0 when the 64 bit one is
+			 * not, skip those too.
+			 */
+			if (!legacy_b4(c, b5_legacy)) {
+				r.site[SITE_B4_DIV0] += n_up;
+				continue;
+			}
+
+			for (up = 0; up < up_max; up += up_step) {
+				p_legacy = legacy_pressure(c, b5_legacy, up, oss);
+				p_core = bmp180_math_pressure(c, b5_core, up, oss);
+				p_ref = ref_tail(&h, up, oss, r.site);
+
+				if (p_core != p_legacy)
+					r.core_p++;
+
+				if (p_ref != p_legacy) {
+					if (!r.ref_p) {
+						r.ut = ut;
+						r.up = up;
+						r.p_legacy = p_legacy;
+						r.p_ref = p_ref;
+					}
+
+					r.ref_p++;
+				}
+			}
+		}
+	}
+
+	pthread_mutex_lock(&lock);
+	total.points += r.points;
+	total.core_t += r.core_t;
+	total.core_p += r.core_p;
+	total.ref_t += r.ref_t;
+
+	if (r.ref_p && !total.ref_p) {
+		total.ut = r.ut;
+		total.up = r.up;
+		total.p_legacy = r.p_legacy;
+		total.p_ref = r.p_ref;
+	}
+
+	total.ref_p += r.ref_p;
+
+	for (i = 0; i < SITE_MAX; i++)
+		total.site[i] += r.site[i];
+
+	pthread_mutex_unlock(&lock);
+	return(NULL);
+}
+
+static void load(const char *name)
+{
+	FILE *f;
+	int v[11];
+
+	f = fopen(name, "r");
+
+	if (!f) {
+		perror(name);
+		exit(1);
+	}
+
+	ncal = 0;
+
+	while ((ncal < MAX_CAL) && (fscanf(f, "%d %d %d %d %d %d %d %d %d %d %d",
+					v, v + 1, v + 2, v + 3, v + 4, v + 5, v + 6,
+					v + 7, v + 8, v + 9, v + 10) == 11)) {
+		cal[ncal].AC1 = v[0];
+		cal[ncal].AC2 = v[1];
+		cal[ncal].AC3 = v[2];
+		cal[ncal].AC4 = v[3];
+		cal[ncal].AC5 = v[4];
+		cal[ncal].AC6 = v[5];
+		cal[ncal].B1 = v[6];
+		cal[ncal].B2 = v[7];
+		cal[ncal].MB = v[8];
+		cal[ncal].MC = v[9];
+		cal[ncal].MD = v[10];
+		ncal++;
+	}
+
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t *th;
+	int opt, i, j, nthreads, oss_first, oss_last, fail;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	oss_first = 0;
+	oss_last = 3;
+
+	while ((opt = getopt(argc, argv, "j:u:p:o:f:")) != -1) {
+		switch (opt) {
+			case 'j':
+				nthreads = atoi(optarg);
+				break;
+			case 'u':
+				ut_step = atoi(optarg);
+				break;
+			case 'p':
+				up_step = atoi(optarg);
+				break;
+			case 'o':
+				oss_first = oss_last = atoi(optarg) & 3;
+				break;
+			case 'f':
+				load(optarg);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-j threads] [-u UT step] "
+						"[-p UP step] [-o oss] [-f calfile]\n",
+						argv[0]);
+				return(2);
+		}
+	}
+
+	if ((nthreads < 1) || !ut_step || !up_step)
+		return(2);
+
+	th = malloc(nthreads * sizeof(pthread_t));
+	fail = 0;
+
+	for (i = 0; i < ncal; i++) {
+		for (job_oss = oss_first; job_oss <= oss_last; job_oss++) {
+			job_cal = &cal[i];
+			next_ut = 0;
+			memset(&total, 0, sizeof(total));
+
+			for (j = 0; j < nthreads; j++)
+				pthread_create(&th[j], NULL, worker, NULL);
+
+			for (j = 0; j < nthreads; j++)
+				pthread_join(th[j], NULL);
+
+			printf("cal %d oss %d: %llu points, core != legacy T %llu p %llu, "
+					"legacy != ref64 T %llu p %llu\n", i, job_oss,
+					(unsigned long long)total.points,
+					(unsigned long long)total.core_t,
+					(unsigned long long)total.core_p,
+					(unsigned long long)total.ref_t,
+					(unsigned long long)total.ref_p);
+
+			if (total.ref_p)
+				printf("  first p mismatch UT %ld UP %ld: legacy %ld ref64 %lld\n",
+						(long)total.ut, (long)total.up,
+						(long)total.p_legacy, (long long)total.p_ref);
+
+			for (j = 0; j < SITE_MAX; j++)
+				if (total.site[j])
+					printf("  %-32s %llu\n", site_name[j],
+							(unsigned long long)total.site[j]);
+
+			fail |= (total.core_t || total.core_p);
+		}
+	}
+
+	free(th);
+	fail |= verify_bmp280();
+	return(fail);
+}
@@ -0,0 +1,93 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file verify_bmp280.cpp
+ * \brief BMPx<BMP280Chip>::read_all() on the datasheet example.
+ *
+ * The simulated BMP280 has the datasheet 3.12 calibration and
+ * gives its adc_T 519888 and adc_P 415148: 25.08 C and 100653.27 Pa
+ * in double. The 32 bit integer code is expected at 25.1 C and
+ * within 3 Pa. Forced then normal mode, on a virtual clock.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <util/delay.h>
+#include "bmp180.h"
+#include "i2c_sim.h"
+
+/* datasheet T (0.1 C), p (Pa) and the p tolerance of the int32 code */
+#define DATASHEET_T 251
+#define DATASHEET_P 100653
+#define TOLERANCE_P 3
+
+/* the virtual clock, us */
+static double vnow;
+
+static void advance(double us)
+{
+	vnow += us;
+}
+
+static uint64_t vclock(void)
+{
+	return((uint64_t)vnow);
+}
+
+/*! 0 - T and p are the datasheet ones. */
+static int check(const char *mode, uint8_t err, const BMP280 &sensor)
+{
+	int fail;
+
+	fail = err || (sensor.T != DATASHEET_T) ||
+		(labs(sensor.p - DATASHEET_P) > TOLERANCE_P);
+	printf("bmp280 %s: err %u T %ld p %ld, %s\n", mode, err,
+			(long)sensor.T, (long)sensor.p, fail ? "FAIL" : "OK");
+	return(fail);
+}
+
+/*! The BMP280 checks, 0 - OK. */
+extern "C" int verify_bmp280(void)
+{
+	struct i2c_bus_t bus;
+	int fail;
+
+	i2c_sim_init(&bus);
+	bmp180_sim_init_bmp280(&bus.sim);
+	bus.sim.clock = vclock;
+	host_delay_hook = advance;
+
+	BMP280 sensor(BMP180_ADDR, &bus);
+
+	if (!sensor.present()) {
+		printf("bmp280: id 0x%02x, FAIL\n", sensor.id);
+		host_delay_hook = NULL;
+		return(1);
+	}
+
+	fail = check("forced", sensor.read_all(), sensor);
+
+	// the first conversion done before the read
+	fail |= sensor.normal(0) ? 1 : 0;
+	host_delay_us(1000.0 * sensor.conversion_ms(true));
+	fail |= check("normal", sensor.read_all(), sensor);
+	fail |= sensor.forced() ? 1 : 0;
+
+	host_delay_hook = NULL;
+	return(fail);
+}
@@ -16,8 +16,11 @@
  */
 
 #include <util/twi.h>
+#include <util/delay.h>
 #include <avr/io.h>
 #include "i2c.h"
+#include "i2c_soft.h"
+#include "i2c_rec.h"
 
 /* defines */
 #define START 1
@@ -27,6 +30,8 @@
 #define ACK 5
 #define NACK 6
 
+bool I2C::initialized = false;
+
 /*! Initialize the i2c bus.
  *
  * See the datasheet for SCL speed.
@@ -71,9 +76,13 @@ void I2C::Shut()
 
 // Contructor
 // C++11 set the const addr to address.
-I2C::I2C(uint8_t addr) : address{addr}
+// A not NULL bus selects the software i2c on the bus' pins.
+I2C::I2C(uint8_t addr, struct i2c_bus_t *sbus) :
+	status{0}, address{addr}, bus{sbus}
 {
-	if (!initialized)
+	if (bus)
+		i2c_soft_init(bus);
+	else if (!initialized)
 		I2C::Init();
 }
 
@@ -111,7 +120,7 @@ void I2C::send(const uint8_t code, const uint8_t data)
 			break;
 	}
 
-	bus_status = TW_STATUS;
+	status = TW_STATUS;
 }
 
 /*! i2c Master Trasmitter/Receive Mode.
@@ -131,72 +140,81 @@ void I2C::send(const uint8_t code, const uint8_t data)
 uint8_t I2C::tx(const bool rw, const uint16_t lenght,
 		uint8_t *data, bool stop)
 {
+	I2C_REC_BEGIN();
+
+	if (bus) {
+		status = i2c_soft_mXm(bus, address | rw, lenght, data, stop);
+		I2C_REC_END(address | rw, lenght, data, stop, status);
+		return(status);
+	}
+
 	/* START */
 	send(START, 0);
 
 	/* if start acknoledge */
-	if ((bus_status == TW_START) || (bus_status == TW_REP_START))
-		/* Send address */
-		send(SLA, address);
+	if ((status == TW_START) || (status == TW_REP_START))
+		/* Send address, LSB = read */
+		send(SLA, address | rw);
 
 	/* if read operation */
 	if (rw) {
 		/* if the address is ACK */
-		if (bus_status == TW_MR_SLA_ACK)
+		if (status == TW_MR_SLA_ACK)
 			/* Receive data */
 			for (uint16_t i=0; i<lenght; i++) {
 				/* send ACK */
 				send(ACK, 0);
 
 				/* if data is not ACK */
-				if (bus_status == TW_MR_DATA_ACK)
+				if (status == TW_MR_DATA_ACK)
 					*(data+i) = TWDR;
 				else
 					i = lenght; // exit
 			}
 
 		/* Error NACK on ADDR-R or Last DATA */
-		if ((bus_status == TW_MR_SLA_NACK) ||
-				(bus_status == TW_MR_DATA_NACK))
+		if ((status == TW_MR_SLA_NACK) ||
+				(status == TW_MR_DATA_NACK))
 			/* send the stop */
 			stop = true;
 
-		if (bus_status == TW_MR_DATA_ACK) {
+		if (status == TW_MR_DATA_ACK) {
 			/* last byte, send NACK */
 			send(NACK, 0);
 
 			/* if data is NACK */
-			if (bus_status == TW_MR_DATA_NACK)
-				bus_status = 0; // Everything is ok
+			if (status == TW_MR_DATA_NACK)
+				status = 0; // Everything is ok
 		}
 	} else {
 		/* if the address is ACK */
-		if (bus_status == TW_MT_SLA_ACK)
+		if (status == TW_MT_SLA_ACK)
 			/* send data */
 			for (uint16_t i=0; i<lenght; i++) {
 				send(DATA, *(data+i));
 
 				/* if data is not ACK */
-				if (bus_status != TW_MT_DATA_ACK)
+				if (status != TW_MT_DATA_ACK)
 					i=lenght; // exit
 			}
 
 		/* if client NACK on ADDR or DATA */
-		if ((bus_status == TW_MT_SLA_NACK) ||
-				(bus_status == TW_MT_DATA_NACK))
+		if ((status == TW_MT_SLA_NACK) ||
+				(status == TW_MT_DATA_NACK))
 			/* send the stop */
 			stop = true;
 
 		/* if data is ACK */
-		if (bus_status == TW_MT_DATA_ACK)
-			bus_status = 0; // Everything is ok
+		if (status == TW_MT_DATA_ACK)
+			status = 0; // Everything is ok
 	}
 
 	/* send the STOP if required */
 	if (stop)
 		send(STOP, 0);
 
-	return(bus_status);
+	I2C_REC_END(address | rw, lenght, data, stop, status);
+	return(status);
 }
 
 /*! I2C General Call
@@ -215,5 +233,42 @@ uint8_t I2C::gc(const uint8_t call)
 			tx(WRITE, 1, &i);
 	}
 
-	return(bus_status);
+	return(status);
+}
+
+/*! Free a bus held by a slave.
+ *
+ * See i2c_soft_recover(), on the TWI the pins are driven as GPIO
+ * for the while, SDA on PC4 and SCL on PC5, the next transaction
+ * enables the TWI again.
+ *
+ * \return 0 - OK, TW_BUS_ERROR SDA is still low.
+ */
+uint8_t I2C::recover()
+{
+	uint8_t i;
+
+	if (bus) {
+		status = i2c_soft_recover(bus);
+		return(status);
+	}
+
+	TWCR = 0;
+	PORTC &= ~(_BV(PC4) | _BV(PC5));
+	DDRC &= ~(_BV(PC4) | _BV(PC5));
+
+	for (i = 0; (i < 9) && bit_is_clear(PINC, PC4); i++) {
+		_delay_us(5);
+		DDRC |= _BV(PC5);
+		_delay_us(5);
+		DDRC &= ~_BV(PC5);
+	}
+
+	/* STOP, SDA up while SCL is high */
+	DDRC |= _BV(PC4);
+	_delay_us(5);
+	DDRC &= ~_BV(PC4);
+	_delay_us(5);
+	status = bit_is_set(PINC, PC4) ? 0 : TW_BUS_ERROR;
+	return(status);
 }
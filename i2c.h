@@ -29,6 +29,11 @@
 #define READ 1
 #define WRITE 0
 
+/* bus descriptor, NULL is the hardware TWI,
+ * see i2c_soft.h for the software one.
+ */
+struct i2c_bus_t;
+
 // C++ compiler
 #ifdef __cplusplus
 
@@ -36,16 +41,17 @@ class I2C {
 	private:
 		// I2C bus should be initialized only once
 		static bool initialized; // class attribute
-		static uint8_t bus_status;
-		uint8_t error;
+		uint8_t status; // last transaction of this device
 		const uint8_t address; // device's address
+		struct i2c_bus_t *bus; // NULL = TWI
 		void send(const uint8_t, const uint8_t);
 	public:
-		I2C(uint8_t); // set the device address
+		I2C(uint8_t, struct i2c_bus_t * = nullptr); // set the device address
 		static void Init(); // Initialize bus
 		static void Shut(); // De-initialize bus
 		uint8_t tx(bool, const uint16_t, uint8_t*, bool = true);
 		uint8_t gc(const uint8_t);
+		uint8_t recover(); // free a bus held by a slave
 };
 
 #else /* __cplusplus */
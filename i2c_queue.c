@@ -0,0 +1,76 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "i2c_queue.h"
+
+/*! a runs before b. */
+static uint8_t before(struct i2c_xfer_t *a, struct i2c_xfer_t *b)
+{
+	if (a->prio != b->prio)
+		return(a->prio < b->prio);
+
+	/* no deadline goes last */
+	if (!b->deadline)
+		return(a->deadline != 0);
+
+	if (!a->deadline)
+		return(0);
+
+	return((int32_t)(a->deadline - b->deadline) < 0);
+}
+
+/*! Sorted insert. */
+void i2c_queue_put(struct i2c_xfer_t **queue, struct i2c_xfer_t *xfer)
+{
+	struct i2c_xfer_t **p;
+
+	p = queue;
+
+	/* same key keeps the FIFO order */
+	while (*p && !before(xfer, *p))
+		p = &(*p)->next;
+
+	xfer->next = *p;
+	*p = xfer;
+}
+
+/*! Remove the first transaction, drop the expired ones.
+ *
+ * \param now timer_cycles().
+ * \param expired called for every transaction dropped.
+ * \return the transaction, NULL if none.
+ */
+struct i2c_xfer_t *i2c_queue_get(struct i2c_xfer_t **queue,
+		const uint32_t now, i2c_queue_expired_t expired)
+{
+	struct i2c_xfer_t *xfer;
+
+	while ((xfer = *queue)) {
+		*queue = xfer->next;
+
+		if (xfer->deadline && ((int32_t)(now - xfer->deadline) > 0)) {
+			expired(xfer);
+			continue;
+		}
+
+		return(xfer);
+	}
+
+	return(NULL);
+}
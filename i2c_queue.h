@@ -0,0 +1,40 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_queue.h
+ * \brief The transaction queue of i2c_sched.c.
+ *
+ * Priority order, earliest deadline first within a priority,
+ * submission order for the same key. No hardware in here: the
+ * scheduler calls it with the interrupts off, host/sched_order
+ * checks the order on the PC.
+ */
+
+#ifndef I2C_QUEUE_DEF
+#define I2C_QUEUE_DEF
+
+#include <stdint.h>
+#include "i2c_sched.h"
+
+/*! Called for a transaction dropped past its deadline. */
+typedef void (*i2c_queue_expired_t)(struct i2c_xfer_t *xfer);
+
+void i2c_queue_put(struct i2c_xfer_t **queue, struct i2c_xfer_t *xfer);
+struct i2c_xfer_t *i2c_queue_get(struct i2c_xfer_t **queue,
+		const uint32_t now, i2c_queue_expired_t expired);
+
+#endif
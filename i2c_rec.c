@@ -0,0 +1,168 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "timer.h"
+#include "uart.h"
+#include "i2c_rec.h"
+
+#ifdef I2C_RECORD
+
+static uint8_t buffer[I2C_REC_SIZE];
+/* next free byte and first byte to send */
+static uint8_t head;
+static uint8_t tail;
+/* records dropped, saturated */
+static uint8_t lost;
+/* start of the last record in the buffer */
+static uint32_t last;
+/* the stream header is still to send */
+static uint8_t fresh;
+
+static uint8_t space(void)
+{
+	return((uint8_t)(I2C_REC_MASK - ((head - tail) & I2C_REC_MASK)));
+}
+
+static void put(const uint8_t c, uint8_t *sum)
+{
+	*sum += c;
+	buffer[head] = c;
+	head = (head + 1) & I2C_REC_MASK;
+}
+
+static void put_varint(uint32_t n, uint8_t *sum)
+{
+	while (n > 0x7f) {
+		put((n & 0x7f) | 0x80, sum);
+		n >>= 7;
+	}
+
+	put(n, sum);
+}
+
+static uint8_t varint_size(uint32_t n)
+{
+	uint8_t i;
+
+	for (i = 1; n > 0x7f; i++)
+		n >>= 7;
+
+	return(i);
+}
+
+/* send up to n bytes */
+static void drain(uint16_t n)
+{
+	if (fresh) {
+		uart_putchar(0, 'I');
+		uart_putchar(0, '2');
+		uart_putchar(0, 'R');
+		uart_putchar(0, I2C_REC_VERSION);
+		fresh = 0;
+	}
+
+	while (n-- && (tail != head)) {
+		uart_putchar(0, buffer[tail]);
+		tail = (tail + 1) & I2C_REC_MASK;
+	}
+}
+
+/*! Start the cycle counter and clear the buffer.
+ *
+ * \note interrupts must be enabled.
+ */
+void i2c_rec_init(void)
+{
+	head = 0;
+	tail = 0;
+	lost = 0;
+	fresh = 1;
+	timer_init();
+	last = timer_cycles();
+}
+
+/*! Record a transaction, call it when the transaction ends.
+ *
+ * \param addr the 8 bit address with the read bit.
+ * \param lenght the bytes.
+ * \param data the bytes written or read.
+ * \param stop the stop has been sent.
+ * \param status the transaction result, 0 - OK.
+ * \param start the timer_cycles() at the start.
+ */
+void i2c_rec_put(const uint8_t addr, const uint16_t lenght,
+		const uint8_t *data, const uint8_t stop,
+		const uint8_t status, const uint32_t start)
+{
+	uint32_t dur;
+	uint16_t size, i;
+	uint8_t sum;
+
+	dur = timer_cycles() - start;
+	size = 4 + (status ? 1 : 0) + varint_size(start - last) +
+		varint_size(dur) + varint_size(lenght) + lenght;
+
+	if (lost)
+		size += 3;
+
+	/* too big for the buffer */
+	if (size > I2C_REC_MASK) {
+		if (lost < 0xff)
+			lost++;
+
+		return;
+	}
+
+	/* the transaction is over, wait for the UART here */
+	if (size > space())
+		drain(size - space());
+
+	if (lost) {
+		sum = 0;
+		put(I2C_REC_HDR | I2C_REC_LOST, &sum);
+		put(lost, &sum);
+		put(sum, &sum);
+		lost = 0;
+	}
+
+	sum = 0;
+	put(I2C_REC_HDR | (stop ? I2C_REC_STOP : 0) |
+			(status ? I2C_REC_ERR : 0), &sum);
+	put(addr, &sum);
+
+	if (status)
+		put(status, &sum);
+
+	put_varint(start - last, &sum);
+	put_varint(dur, &sum);
+	put_varint(lenght, &sum);
+
+	for (i = 0; i < lenght; i++)
+		put(data[i], &sum);
+
+	put(sum, &sum);
+	last = start;
+}
+
+/*! Send the recorded transactions, call it from the main loop. */
+void i2c_rec_flush(void)
+{
+	drain(I2C_REC_SIZE);
+}
+
+#endif
@@ -0,0 +1,103 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_rec.h
+ * \brief Record of the i2c transactions for the host replay.
+ *
+ * Enabled with -D I2C_RECORD (make RECORD=1), otherwise every
+ * macro compiles to nothing. Each transaction is encoded in a RAM
+ * ring buffer when it ends, i2c_rec_flush() sends it out of the
+ * UART from the main loop. If the buffer is full the oldest bytes
+ * are sent before returning from the transaction: the recorded
+ * durations stay exact, only the gap to the next transaction
+ * grows. At the 115200 baud of uart_init() a sample at oss 3
+ * (5 transactions, ~45 byte) is sent in 4 ms, well within its 31 ms
+ * of conversions. A transaction too big for the buffer is dropped
+ * and a lost record is sent in its place.
+ *
+ * The stream starts with 'I' '2' 'R' <version>, then:
+ *
+ * <hdr> <addr> [<status>] <dt> <dur> <len> <len bytes> <sum>
+ *
+ * hdr: 0xa0 | I2C_REC_STOP | I2C_REC_ERR, status only if ERR.
+ * addr: 8 bit address, the LSB is the read bit.
+ * dt: cycles from the start of the previous record, varint.
+ * dur: cycles of the transaction, varint.
+ * len: bytes, varint, followed by the data written or read.
+ * sum: 8 bit sum of all the previous bytes of the record.
+ *
+ * <0xa0 | I2C_REC_LOST> <n> <sum> n records have been dropped.
+ *
+ * varint: 7 bit per byte LSB first, the MSB set if more follow.
+ * host/bmp180replay decodes it.
+ */
+
+#ifndef _I2C_REC_H_
+#define _I2C_REC_H_
+
+#include <stdint.h>
+
+/*! Encoded bytes in the buffer, power of 2 */
+#ifndef I2C_REC_SIZE
+#define I2C_REC_SIZE 128
+#endif
+/*! Buffer mask */
+#define I2C_REC_MASK ( I2C_REC_SIZE - 1 )
+/*! Check if something is wrong in the definitions */
+#if ( I2C_REC_SIZE & I2C_REC_MASK ) || ( I2C_REC_SIZE > 256 )
+#error I2C_REC_SIZE is not a power of 2 or is bigger than 256
+#endif
+
+#define I2C_REC_VERSION 1
+#define I2C_REC_HDR 0xa0
+#define I2C_REC_HDR_MASK 0xf0
+#define I2C_REC_STOP 1
+#define I2C_REC_ERR 2
+#define I2C_REC_LOST 8
+
+#ifdef I2C_RECORD
+
+#include "timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void i2c_rec_init(void);
+void i2c_rec_put(const uint8_t addr, const uint16_t lenght,
+		const uint8_t *data, const uint8_t stop,
+		const uint8_t status, const uint32_t start);
+void i2c_rec_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* the start of the transaction, a declaration */
+#define I2C_REC_BEGIN() uint32_t i2c_rec_start = timer_cycles()
+#define I2C_REC_END(addr, lenght, data, stop, status) \
+	i2c_rec_put(addr, lenght, data, stop, status, i2c_rec_start)
+
+#else /* I2C_RECORD */
+
+#define i2c_rec_init() do {} while (0)
+#define i2c_rec_flush() do {} while (0)
+#define I2C_REC_BEGIN() do {} while (0)
+#define I2C_REC_END(addr, lenght, data, stop, status) do {} while (0)
+
+#endif /* I2C_RECORD */
+#endif
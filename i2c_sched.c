@@ -0,0 +1,252 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+#include "timer.h"
+#include "i2c_sched.h"
+#include "i2c_queue.h"
+
+/* TWCR commands, interrupt enabled */
+#define TWCR_START (_BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_STOP (_BV(TWINT) | _BV(TWSTO) | _BV(TWEN))
+#define TWCR_STOP_START (TWCR_STOP | TWCR_START)
+#define TWCR_ACK (_BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_NACK (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_IDLE (_BV(TWINT) | _BV(TWEN))
+
+/* pending transactions, sorted */
+static struct i2c_xfer_t *queue;
+/* running transaction */
+static struct i2c_xfer_t *volatile current;
+/* bytes of the current piece and index */
+static uint8_t piece, idx;
+/* the data of the current piece */
+static uint8_t *buf;
+
+/*! End of a transaction or of a piece of it. */
+static void complete(struct i2c_xfer_t *xfer, const uint8_t status)
+{
+	xfer->dev->status = status;
+	xfer->status = status;
+
+	if (xfer->done)
+		xfer->done(xfer);
+}
+
+/*! A transaction dropped by the queue. */
+static void expired(struct i2c_xfer_t *xfer)
+{
+	complete(xfer, I2C_XFER_EXPIRED);
+}
+
+/*! Pick the next transaction to run, drop the expired ones.
+ *
+ * \return the TWCR value to start it or just the stop.
+ */
+static uint8_t next(void)
+{
+	struct i2c_xfer_t *xfer;
+
+	xfer = i2c_queue_get(&queue, timer_cycles(), expired);
+
+	if (xfer) {
+		xfer->status = I2C_XFER_RUNNING;
+		current = xfer;
+		idx = 0;
+		buf = xfer->data + xfer->offset;
+		piece = xfer->lenght - xfer->offset;
+
+		if ((xfer->flags & I2C_XFER_BULK) && (piece > I2C_SCHED_CHUNK))
+			piece = I2C_SCHED_CHUNK;
+
+		return(TWCR_START);
+	}
+
+	current = NULL;
+	return(0);
+}
+
+/*! End of the current piece, either the whole transaction or
+ * a chunk of a bulk one which is queued again.
+ */
+static void finish(const uint8_t status)
+{
+	struct i2c_xfer_t *xfer;
+	uint8_t cmd;
+
+	xfer = current;
+
+	if (!status && (xfer->offset + piece < xfer->lenght)) {
+		xfer->offset += piece;
+		xfer->status = I2C_XFER_QUEUED;
+		i2c_queue_put(&queue, xfer);
+	} else {
+		complete(xfer, status);
+	}
+
+	cmd = next();
+
+	/* stop and start again in one go */
+	if (cmd)
+		TWCR = TWCR_STOP_START;
+	else
+		TWCR = TWCR_STOP;
+}
+
+ISR(TWI_vect)
+{
+	struct i2c_xfer_t *xfer;
+	uint8_t status, cmd;
+
+	xfer = current;
+	status = TW_STATUS;
+
+	switch (status) {
+		case TW_START:
+			TWDR = xfer->dev->addr;
+			TWCR = TWCR_NACK;
+			break;
+		case TW_REP_START:
+			TWDR = xfer->dev->addr | TW_READ;
+			TWCR = TWCR_NACK;
+			break;
+		case TW_MT_SLA_ACK:
+			TWDR = xfer->reg + xfer->offset;
+			TWCR = TWCR_NACK;
+			break;
+		case TW_MT_DATA_ACK:
+			if (xfer->flags & I2C_XFER_READ)
+				/* register sent, repeated start */
+				TWCR = TWCR_START;
+			else if (idx < piece) {
+				TWDR = buf[idx++];
+				TWCR = TWCR_NACK;
+			} else {
+				finish(I2C_XFER_OK);
+			}
+
+			break;
+		case TW_MR_SLA_ACK:
+			/* NACK the last byte */
+			TWCR = (piece > 1) ? TWCR_ACK : TWCR_NACK;
+			break;
+		case TW_MR_DATA_ACK:
+			buf[idx++] = TWDR;
+			TWCR = (idx < (piece - 1)) ? TWCR_ACK : TWCR_NACK;
+			break;
+		case TW_MR_DATA_NACK:
+			buf[idx] = TWDR;
+			finish(I2C_XFER_OK);
+			break;
+		case TW_MT_ARB_LOST:
+			/* the bus will be free again, retry the piece */
+			xfer->status = I2C_XFER_QUEUED;
+			i2c_queue_put(&queue, xfer);
+			cmd = next();
+
+			/* the START waits for the bus, none left: idle */
+			if (cmd)
+				TWCR = cmd;
+			else
+				TWCR = TWCR_IDLE;
+
+			break;
+		case TW_BUS_ERROR:
+			/* the STOP of finish() releases the TWI */
+			finish(I2C_XFER_BUS_ERROR);
+			break;
+		default:
+			/* NACK on address or data */
+			finish(status);
+			break;
+	}
+}
+
+/*! Initialize the TWI clock and the scheduler.
+ *
+ * Every driver on the TWI may call it, only the first call does it.
+ * \note interrupts must be enabled.
+ */
+void i2c_sched_init(void)
+{
+	static uint8_t ready;
+
+	if (ready)
+		return;
+
+	i2c_init();
+	queue = NULL;
+	current = NULL;
+	ready = 1;
+}
+
+/*! Queue a transaction.
+ *
+ * The status of a new transaction must be I2C_XFER_OK, reads
+ * must be at least 1 byte long. The transaction and its data
+ * must not be touched until its status is no more QUEUED or
+ * RUNNING.
+ *
+ * \return 0 - queued, 1 - already in the queue.
+ */
+uint8_t i2c_sched_submit(struct i2c_xfer_t *xfer)
+{
+	uint8_t cmd;
+
+	if ((xfer->status == I2C_XFER_QUEUED) ||
+			(xfer->status == I2C_XFER_RUNNING))
+		return(1);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		xfer->status = I2C_XFER_QUEUED;
+		xfer->offset = 0;
+		i2c_queue_put(&queue, xfer);
+
+		/* bus idle, start it */
+		if (!current) {
+			cmd = next();
+
+			if (cmd)
+				TWCR = cmd;
+		}
+	}
+
+	return(0);
+}
+
+/*! Wait for the end of a transaction.
+ *
+ * \return the transaction status.
+ */
+uint8_t i2c_sched_wait(struct i2c_xfer_t *xfer)
+{
+	while ((xfer->status == I2C_XFER_QUEUED) ||
+			(xfer->status == I2C_XFER_RUNNING));
+
+	return(xfer->status);
+}
+
+/*! The bus is running a transaction. */
+uint8_t i2c_sched_busy(void)
+{
+	return(current != NULL);
+}
@@ -0,0 +1,111 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_sched.h
+ * \brief Interrupt driven TWI with a transaction scheduler.
+ *
+ * Several device drivers queue register transactions (register
+ * address write followed by a write or a repeated start read),
+ * the TWI interrupt runs them back to back in priority order,
+ * earliest deadline first within the same priority.
+ *
+ * Bulk transactions are split in I2C_SCHED_CHUNK byte pieces at
+ * consecutive register addresses and queued again after each
+ * piece, so an urgent read waits at most one chunk. The progress
+ * is kept apart, the fields set by the caller are never changed
+ * and a finished transaction can be submitted again as it is.
+ *
+ * ex. the BMP180 ADC read:
+ * xfer.dev = &bmp180_dev; xfer.reg = BMP180_REG_ADC;
+ * xfer.data = buf; xfer.lenght = 3; xfer.flags = I2C_XFER_READ;
+ * xfer.prio = I2C_SCHED_PRIO_RT; i2c_sched_submit(&xfer);
+ *
+ * \note once i2c_sched_init() is called the polled TWI
+ * functions in i2c.c must not be used.
+ */
+
+#ifndef I2C_SCHED_DEF
+#define I2C_SCHED_DEF
+
+#include <stdint.h>
+#include "i2c.h"
+
+/*! Max bytes of a bulk transaction done in one go. */
+#ifndef I2C_SCHED_CHUNK
+#define I2C_SCHED_CHUNK 8
+#endif
+
+/* priorities, lower is more urgent */
+#define I2C_SCHED_PRIO_RT 0
+#define I2C_SCHED_PRIO_NORMAL 1
+#define I2C_SCHED_PRIO_BULK 2
+
+/* transaction flags */
+#define I2C_XFER_READ 1
+#define I2C_XFER_BULK 2
+
+/* transaction status, the errors are the TWI status codes but
+ * the bus error, TW_BUS_ERROR is 0 as I2C_XFER_OK.
+ */
+#define I2C_XFER_OK 0
+#define I2C_XFER_QUEUED 1
+#define I2C_XFER_RUNNING 2
+#define I2C_XFER_EXPIRED 3
+#define I2C_XFER_BUS_ERROR 4
+
+/*! A device on the bus.
+ *
+ * status is the result of the last transaction of this
+ * device only.
+ */
+struct i2c_dev_t {
+	uint8_t addr;
+	volatile uint8_t status;
+};
+
+/*! A register transaction. */
+struct i2c_xfer_t {
+	/*! the device. */
+	struct i2c_dev_t *dev;
+	/*! the first register address. */
+	uint8_t reg;
+	/*! data to write or buffer for the read. */
+	uint8_t *data;
+	/*! number of bytes. */
+	uint8_t lenght;
+	/*! I2C_XFER_READ, I2C_XFER_BULK. */
+	uint8_t flags;
+	/*! priority. */
+	uint8_t prio;
+	/*! timer_cycles() limit to start it, 0 = none. */
+	uint32_t deadline;
+	/*! I2C_XFER_* or the TWI error. */
+	volatile uint8_t status;
+	/*! called from the ISR at the end, may be NULL. */
+	void (*done)(struct i2c_xfer_t *xfer);
+	/*! queue link, private. */
+	struct i2c_xfer_t *next;
+	/*! bytes done by the previous pieces, private. */
+	uint8_t offset;
+};
+
+void i2c_sched_init(void);
+uint8_t i2c_sched_submit(struct i2c_xfer_t *xfer);
+uint8_t i2c_sched_wait(struct i2c_xfer_t *xfer);
+uint8_t i2c_sched_busy(void);
+
+#endif
@@ -0,0 +1,247 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <util/twi.h>
+#include <util/delay.h>
+#include <avr/io.h>
+#include "i2c_soft.h"
+
+#define SCL_LOW(b) (*(b)->ddr |= (b)->scl)
+#define SDA_LOW(b) (*(b)->ddr |= (b)->sda)
+#define SDA_HIGH(b) (*(b)->ddr &= ~(b)->sda)
+#define SDA_IS_HIGH(b) (*(b)->pin & (b)->sda)
+#define DELAY() _delay_us(I2C_SOFT_DELAY_US)
+
+/*! Release SCL and wait for the slave to release it too.
+ *
+ * \return 0 - OK, 1 - clock stretched for too long.
+ */
+static uint8_t scl_high(struct i2c_bus_t *bus)
+{
+	uint16_t i;
+
+	*bus->ddr &= ~bus->scl;
+
+	for (i = 0; i < I2C_SOFT_STRETCH; i++)
+		if (*bus->pin & bus->scl)
+			return(0);
+
+	return(1);
+}
+
+/*! Start or repeated start.
+ *
+ * \return TW_START or TW_MT_ARB_LOST if someone holds SDA low.
+ */
+static uint8_t send_start(struct i2c_bus_t *bus)
+{
+	SDA_HIGH(bus);
+	DELAY();
+
+	if (scl_high(bus))
+		return(TW_NO_INFO);
+
+	DELAY();
+
+	if (!SDA_IS_HIGH(bus))
+		return(TW_MT_ARB_LOST);
+
+	SDA_LOW(bus);
+	DELAY();
+	SCL_LOW(bus);
+	return(TW_START);
+}
+
+static void send_stop(struct i2c_bus_t *bus)
+{
+	SDA_LOW(bus);
+	DELAY();
+	scl_high(bus);
+	DELAY();
+	SDA_HIGH(bus);
+	DELAY();
+}
+
+/*! Clock out a byte.
+ *
+ * \return 0 - ACK, 1 - NACK, TW_MT_ARB_LOST, TW_NO_INFO.
+ */
+static uint8_t write_byte(struct i2c_bus_t *bus, uint8_t byte)
+{
+	uint8_t i, nack;
+
+	for (i = 0; i < 8; i++) {
+		if (byte & 0x80)
+			SDA_HIGH(bus);
+		else
+			SDA_LOW(bus);
+
+		byte <<= 1;
+		DELAY();
+
+		if (scl_high(bus))
+			return(TW_NO_INFO);
+
+		DELAY();
+
+		/* released SDA but someone else is driving it */
+		if ((*bus->ddr & bus->sda) == 0 && !SDA_IS_HIGH(bus))
+			return(TW_MT_ARB_LOST);
+
+		SCL_LOW(bus);
+	}
+
+	/* ACK bit */
+	SDA_HIGH(bus);
+	DELAY();
+
+	if (scl_high(bus))
+		return(TW_NO_INFO);
+
+	DELAY();
+	nack = SDA_IS_HIGH(bus) ? 1 : 0;
+	SCL_LOW(bus);
+	return(nack);
+}
+
+/*! Clock in a byte and send ACK or NACK. */
+static uint8_t read_byte(struct i2c_bus_t *bus, uint8_t *byte,
+		const uint8_t ack)
+{
+	uint8_t i;
+
+	SDA_HIGH(bus);
+	*byte = 0;
+
+	for (i = 0; i < 8; i++) {
+		DELAY();
+
+		if (scl_high(bus))
+			return(TW_NO_INFO);
+
+		DELAY();
+		*byte <<= 1;
+
+		if (SDA_IS_HIGH(bus))
+			*byte |= 1;
+
+		SCL_LOW(bus);
+	}
+
+	if (ack)
+		SDA_LOW(bus);
+
+	DELAY();
+
+	if (scl_high(bus))
+		return(TW_NO_INFO);
+
+	DELAY();
+	SCL_LOW(bus);
+	SDA_HIGH(bus);
+	return(0);
+}
+
+/*! Initialize the software bus.
+ *
+ * Both lines released, the PORT bits are cleared once so that
+ * setting the DDR bit drives the line low.
+ */
+void i2c_soft_init(struct i2c_bus_t *bus)
+{
+	*bus->ddr &= ~(bus->scl | bus->sda);
+	*bus->port &= ~(bus->scl | bus->sda);
+}
+
+/*! i2c Master Trasmitter/Receive Mode.
+ *
+ * Same as i2c_mXm() on the software bus.
+ *
+ * \param bus the software bus.
+ * \param addr the i2c slave address, LSB = read.
+ * \param lenght the number of byte to send or receive.
+ * \param *data the pointer to the block of byte.
+ * \param stop the stop at the end of the communication.
+ * \return 0 - OK or the TWI status code of the error.
+ */
+uint8_t i2c_soft_mXm(struct i2c_bus_t *bus, const uint8_t addr,
+		const uint16_t lenght, uint8_t *data, uint8_t stop)
+{
+	uint16_t i;
+	uint8_t err;
+
+	err = send_start(bus);
+
+	if (err != TW_START)
+		return(err);
+
+	err = write_byte(bus, addr);
+
+	if (err == 1)
+		err = (addr & TW_READ) ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+
+	if (!err) {
+		if (addr & TW_READ) {
+			for (i = 0; (i < lenght) && !err; i++)
+				/* NACK the last byte */
+				err = read_byte(bus, data + i, (i < lenght - 1));
+		} else {
+			for (i = 0; (i < lenght) && !err; i++)
+				err = write_byte(bus, *(data + i));
+
+			if (err == 1)
+				err = TW_MT_DATA_NACK;
+		}
+	}
+
+	/* lost the bus, just release the lines */
+	if (err == TW_MT_ARB_LOST)
+		*bus->ddr &= ~(bus->scl | bus->sda);
+	/* on error always release the bus */
+	else if (stop || err)
+		send_stop(bus);
+
+	return(err);
+}
+
+/*! Free a bus held by a slave.
+ *
+ * A slave reset in the middle of a read keeps SDA low waiting for
+ * the clocks of its byte: up to 9 SCL pulses let it finish, then a
+ * STOP puts every slave back in idle.
+ *
+ * \param bus the software bus.
+ * \return 0 - OK, TW_BUS_ERROR SDA is still low.
+ */
+uint8_t i2c_soft_recover(struct i2c_bus_t *bus)
+{
+	uint8_t i;
+
+	SDA_HIGH(bus);
+
+	for (i = 0; (i < 9) && !SDA_IS_HIGH(bus); i++) {
+		DELAY();
+		SCL_LOW(bus);
+		DELAY();
+		scl_high(bus);
+	}
+
+	DELAY();
+	send_stop(bus);
+	return(SDA_IS_HIGH(bus) ? 0 : TW_BUS_ERROR);
+}
@@ -0,0 +1,72 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file i2c_soft.h
+ * \brief Bit-banged i2c master on any pair of GPIO pins.
+ *
+ * The pins are driven open drain, the low level is obtained
+ * setting the pin as output (PORT bit cleared), the high level
+ * setting it as input and letting the external pull-up raise
+ * the line. Return codes are the same of the TWI ones, so
+ * the caller can not tell the difference.
+ */
+
+#ifndef I2C_SOFT_DEF
+#define I2C_SOFT_DEF
+
+#include <stdint.h>
+#include "i2c.h"
+
+/*! Half SCL period in us, 5us is about 90Khz once the
+ * code overhead is added.
+ */
+#ifndef I2C_SOFT_DELAY_US
+#define I2C_SOFT_DELAY_US 5
+#endif
+
+/*! Max loops waiting for a slave stretching the clock. */
+#ifndef I2C_SOFT_STRETCH
+#define I2C_SOFT_STRETCH 1000
+#endif
+
+/*! The software bus, the GPIO port and the pin masks.
+ *
+ * ex. SCL on PD2 and SDA on PD3:
+ * struct i2c_bus_t bus = { &DDRD, &PORTD, &PIND, _BV(PD2), _BV(PD3) };
+ */
+struct i2c_bus_t {
+	volatile uint8_t *ddr;
+	volatile uint8_t *port;
+	volatile uint8_t *pin;
+	uint8_t scl;
+	uint8_t sda;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void i2c_soft_init(struct i2c_bus_t *bus);
+uint8_t i2c_soft_mXm(struct i2c_bus_t *bus, const uint8_t addr,
+		const uint16_t lenght, uint8_t *data, uint8_t stop);
+uint8_t i2c_soft_recover(struct i2c_bus_t *bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,310 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "uart.h"
+#include "fmt.h"
+#include "logger.h"
+
+/* the longest sample, 3 * (4 + 32) bit */
+#define SAMPLE_BYTES 14
+/* bytes per dump line */
+#define DUMP_LINE 16
+
+/* a sample being packed */
+struct bits_t {
+	uint8_t buf[SAMPLE_BYTES];
+	uint8_t n;
+};
+
+static void put_bits(struct bits_t *b, const uint32_t v, uint8_t n)
+{
+	while (n--) {
+		if ((v >> n) & 1)
+			b->buf[b->n >> 3] |= 0x80 >> (b->n & 7);
+
+		b->n++;
+	}
+}
+
+/* zig-zag and the prefix code, see logger.h */
+static void put_field(struct bits_t *b, const int32_t v)
+{
+	uint32_t z;
+
+	z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+
+	if (!z) {
+		put_bits(b, 0, 1);
+	} else if (z < 16) {
+		put_bits(b, 2, 2);
+		put_bits(b, z, 4);
+	} else if (z < 256) {
+		put_bits(b, 6, 3);
+		put_bits(b, z, 8);
+	} else if (z < 65536UL) {
+		put_bits(b, 14, 4);
+		put_bits(b, z, 16);
+	} else {
+		put_bits(b, 15, 4);
+		put_bits(b, z, 32);
+	}
+}
+
+static uint32_t block_addr(struct logger_t *log)
+{
+	return((uint32_t)log->block * log->dev->block_size);
+}
+
+/* erase the next block of the ring and write the header */
+static void open_block(struct logger_t *log, const uint32_t t,
+		const int32_t dt, const int32_t p, const int16_t T)
+{
+	uint8_t h[LOGGER_HEADER];
+
+	log->seq++;
+	log->block++;
+
+	if (log->block >= log->dev->blocks)
+		log->block = 0;
+
+	h[0] = LOGGER_MAGIC;
+	h[1] = log->seq;
+	h[2] = log->seq >> 8;
+	h[3] = t;
+	h[4] = t >> 8;
+	h[5] = t >> 16;
+	h[6] = t >> 24;
+	h[7] = dt;
+	h[8] = dt >> 8;
+	h[9] = p;
+	h[10] = p >> 8;
+	h[11] = p >> 16;
+	h[12] = p >> 24;
+	h[13] = T;
+	h[14] = T >> 8;
+
+	log->dev->erase(block_addr(log));
+	log->dev->write(block_addr(log), h, LOGGER_HEADER);
+	log->pos = LOGGER_HEADER;
+	log->byte = 0;
+	log->nbits = 0;
+	log->bytes += LOGGER_HEADER;
+}
+
+/* add the packed sample to the block, write the complete bytes */
+static void append(struct logger_t *log, const struct bits_t *b)
+{
+	uint8_t i;
+
+	for (i = 0; i < b->n; i++) {
+		log->byte = (log->byte << 1) |
+			((b->buf[i >> 3] >> (7 - (i & 7))) & 1);
+
+		if (++log->nbits == 8) {
+			log->dev->write(block_addr(log) + log->pos, &log->byte, 1);
+			log->pos++;
+			log->bytes++;
+			log->byte = 0;
+			log->nbits = 0;
+		}
+	}
+}
+
+/* write the pending bits, no more samples in this block */
+static void close_block(struct logger_t *log)
+{
+	logger_sync(log);
+	log->pos = 0;
+}
+
+/*! Find the end of the log on the device.
+ *
+ * The next sample starts a new block after the newest one.
+ */
+void logger_init(struct logger_t *log, const struct logger_dev_t *dev)
+{
+	uint8_t h[3];
+	uint16_t i, seq;
+	uint8_t found;
+
+	log->dev = dev;
+	found = 0;
+	/* no log, the first block is 0 with seq 0 */
+	log->block = dev->blocks - 1;
+	log->seq = 0xffff;
+
+	for (i = 0; i < dev->blocks; i++) {
+		dev->read((uint32_t)i * dev->block_size, h, 3);
+
+		if (h[0] != LOGGER_MAGIC)
+			continue;
+
+		seq = h[1] | (h[2] << 8);
+
+		/* serial number compare, the ring holds < 32768 blocks */
+		if (!found || (int16_t)(seq - log->seq) > 0) {
+			log->seq = seq;
+			log->block = i;
+			found = 1;
+		}
+	}
+
+	log->pos = 0;
+	log->samples = 0;
+	log->bytes = 0;
+}
+
+/*! Log a sample.
+ *
+ * \param t the time, any unit, increasing.
+ * \param p pressure, Pa.
+ * \param T temperature, 0.1 C.
+ */
+void logger_put(struct logger_t *log, const uint32_t t, const int32_t p,
+		const int16_t T)
+{
+	struct bits_t b;
+	int32_t dt;
+	uint8_t i;
+
+	dt = t - log->t;
+	log->samples++;
+
+	if (log->pos) {
+		for (i = 0; i < SAMPLE_BYTES; i++)
+			b.buf[i] = 0;
+
+		b.n = 0;
+		put_field(&b, dt - log->dt);
+		put_field(&b, p - log->p);
+		put_field(&b, T - log->T);
+
+		/* room left, the pending bits included, or close it */
+		if ((uint32_t)(log->dev->block_size - log->pos) * 8 -
+				log->nbits >= b.n)
+			append(log, &b);
+		else
+			close_block(log);
+	}
+
+	log->t = t;
+	log->dt = dt;
+	log->p = p;
+	log->T = T;
+
+	if (log->pos) {
+		logger_sync(log);
+		return;
+	}
+
+	/* the sample is the header of a new block, with the 16 bit dt
+	 * the decoder will see
+	 */
+	if (log->samples == 1)
+		log->dt = 0;
+
+	log->dt = (int16_t)log->dt;
+	open_block(log, t, log->dt, p, T);
+}
+
+/*! Write the pending bits, padded with 1. */
+void logger_sync(struct logger_t *log)
+{
+	uint8_t c;
+
+	if (!log->pos || !log->nbits)
+		return;
+
+	c = (log->byte << (8 - log->nbits)) | (0xff >> log->nbits);
+	log->dev->write(block_addr(log) + log->pos, &c, 1);
+}
+
+/*! Erase the whole log. */
+void logger_clear(struct logger_t *log)
+{
+	uint16_t i;
+
+	for (i = 0; i < log->dev->blocks; i++)
+		log->dev->erase((uint32_t)i * log->dev->block_size);
+
+	log->pos = 0;
+}
+
+/* two hex digits */
+static char *hex2(char *s, const uint8_t v)
+{
+	*s++ = "0123456789abcdef"[v >> 4];
+	*s++ = "0123456789abcdef"[v & 0xf];
+	*s = 0;
+	return(s);
+}
+
+/*! Dump the device on the uart, the input of tools/log2csv.py.
+ *
+ * "LOG block_size blocks samples bytes" then "L addr hex" lines of
+ * DUMP_LINE bytes, the erased ones skipped, and "LOG end".
+ * samples and bytes count since the init, their ratio is the
+ * bytes per sample of the current run.
+ *
+ * \param string a 48 bytes buffer.
+ */
+void logger_dump(struct logger_t *log, char *string)
+{
+	uint8_t buf[DUMP_LINE];
+	uint32_t addr, size;
+	uint8_t i, used;
+	char *e;
+
+	logger_sync(log);
+	e = fmt_str(string, "LOG ");
+	e = fmt_u32(e, log->dev->block_size);
+	e = fmt_str(e, " ");
+	e = fmt_u32(e, log->dev->blocks);
+	e = fmt_str(e, " ");
+	e = fmt_u32(e, log->samples);
+	e = fmt_str(e, " ");
+	e = fmt_u32(e, log->bytes);
+	fmt_str(e, "\n");
+	uart_printstr(0, string);
+
+	size = (uint32_t)log->dev->block_size * log->dev->blocks;
+
+	for (addr = 0; addr < size; addr += DUMP_LINE) {
+		log->dev->read(addr, buf, DUMP_LINE);
+		used = 0;
+
+		for (i = 0; i < DUMP_LINE; i++)
+			if (buf[i] != 0xff)
+				used = 1;
+
+		if (!used)
+			continue;
+
+		e = fmt_str(string, "L ");
+		e = fmt_u32(e, addr);
+		e = fmt_str(e, " ");
+
+		for (i = 0; i < DUMP_LINE; i++)
+			e = hex2(e, buf[i]);
+
+		fmt_str(e, "\n");
+		uart_printstr(0, string);
+	}
+
+	uart_printstr(0, "LOG end\n");
+}
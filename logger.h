@@ -0,0 +1,107 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file logger.h
+ * \brief Compressed sample log in EEPROM or SPI NOR flash.
+ *
+ * The storage is a ring of blocks, the erase unit of the device.
+ * A block starts with a header holding the full sample, the
+ * following samples are bit packed differences:
+ *
+ * \code
+ * header:  0xb1 seq:16 t:32 dt:16 p:32 T:16    little endian
+ * sample:  t delta of delta, p delta, T delta, each one
+ *          0                    0
+ *          10   + 4 bit         zig-zag < 16
+ *          110  + 8 bit         zig-zag < 256
+ *          1110 + 16 bit        zig-zag < 65536
+ *          1111 + 32 bit        any
+ * \endcode
+ *
+ * At a steady rate the time field is 1 bit, T mostly 1 bit and p
+ * 6 bit within +-8 Pa. Erased bits are 1: the data ends where the
+ * bits run out or the time field is 1111 + 32 ones.
+ *
+ * Blocks are only appended and used in a ring: every block is
+ * erased once per round, the wear is even. At the init the block
+ * with the newest seq is found, the log continues in the next one.
+ * Every sample is written through, nothing is lost at a reset: the
+ * byte with its last bits is written padded with 1 and written
+ * again by the next samples, which only clears bits and is allowed
+ * on NOR flash too. At about 1 byte per sample that is 2 to 3
+ * writes per byte per round.
+ *
+ * Time t is in units chosen by the caller, main.c uses 0.1 s.
+ */
+
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdint.h>
+
+/*! Header first byte */
+#define LOGGER_MAGIC 0xb1
+/*! Header size */
+#define LOGGER_HEADER 15
+
+/*! A storage device. */
+struct logger_dev_t {
+	/*! erase unit, bytes */
+	uint16_t block_size;
+	/*! blocks used by the log */
+	uint16_t blocks;
+	void (*read)(const uint32_t addr, uint8_t *buf, const uint16_t len);
+	void (*write)(const uint32_t addr, const uint8_t *buf,
+			const uint16_t len);
+	/*! erase the block at addr to 0xff */
+	void (*erase)(const uint32_t addr);
+};
+
+/*! Internal EEPROM, see logger_eeprom.c */
+extern const struct logger_dev_t logger_eeprom;
+/*! SPI NOR flash, see logger_nor.c */
+extern const struct logger_dev_t logger_nor;
+
+/*! The log state. */
+struct logger_t {
+	const struct logger_dev_t *dev;
+	/*! current block, blocks if none open */
+	uint16_t block;
+	uint16_t seq;
+	/*! next byte in the block */
+	uint16_t pos;
+	/*! the pending bits, MSB first */
+	uint8_t byte;
+	uint8_t nbits;
+	/*! the last sample */
+	uint32_t t;
+	int32_t dt;
+	int32_t p;
+	int16_t T;
+	/*! samples and bytes written since the init */
+	uint32_t samples;
+	uint32_t bytes;
+};
+
+void logger_init(struct logger_t *log, const struct logger_dev_t *dev);
+void logger_put(struct logger_t *log, const uint32_t t, const int32_t p,
+		const int16_t T);
+void logger_sync(struct logger_t *log);
+void logger_clear(struct logger_t *log);
+void logger_dump(struct logger_t *log, char *string);
+
+#endif
@@ -0,0 +1,71 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file logger_eeprom.c
+ * \brief The log in the internal EEPROM.
+ *
+ * Blocks of LOGGER_EEPROM_BLOCK bytes from LOGGER_EEPROM_BASE to
+ * the end. The EEPROM has no erase unit, the block is the trade
+ * between the header overhead and the part of a block left unused
+ * at every boot. A write waits for the previous one, 3.4 ms a byte;
+ * eeprom_update_*() skips the bytes already holding the value,
+ * the erase of a never used block costs nothing.
+ */
+
+#include <stdint.h>
+#include <avr/eeprom.h>
+#include "logger.h"
+
+/*! First byte of the log */
+#ifndef LOGGER_EEPROM_BASE
+#define LOGGER_EEPROM_BASE 0
+#endif
+
+/*! Block size */
+#ifndef LOGGER_EEPROM_BLOCK
+#define LOGGER_EEPROM_BLOCK 128
+#endif
+
+static void eeprom_read(const uint32_t addr, uint8_t *buf, const uint16_t len)
+{
+	eeprom_read_block(buf, (const void *)(uintptr_t)(LOGGER_EEPROM_BASE +
+				addr), len);
+}
+
+static void eeprom_write(const uint32_t addr, const uint8_t *buf,
+		const uint16_t len)
+{
+	eeprom_update_block(buf, (void *)(uintptr_t)(LOGGER_EEPROM_BASE +
+				addr), len);
+}
+
+static void eeprom_erase(const uint32_t addr)
+{
+	uint16_t i;
+
+	for (i = 0; i < LOGGER_EEPROM_BLOCK; i++)
+		eeprom_update_byte((uint8_t *)(uintptr_t)(LOGGER_EEPROM_BASE +
+					addr + i), 0xff);
+}
+
+const struct logger_dev_t logger_eeprom = {
+	LOGGER_EEPROM_BLOCK,
+	(E2END + 1 - LOGGER_EEPROM_BASE) / LOGGER_EEPROM_BLOCK,
+	eeprom_read,
+	eeprom_write,
+	eeprom_erase
+};
@@ -0,0 +1,150 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file logger_nor.c
+ * \brief The log in an external SPI NOR flash.
+ *
+ * Any 25-series flash with the JEDEC commands (W25Q, AT25SF, MX25)
+ * on the hardware SPI, SCK PB5, MISO PB4, MOSI PB3 and the chip
+ * select on PB2 (SS, an output keeps the SPI master). The blocks
+ * are the 4 KB sectors, LOGGER_NOR_BLOCKS of them from the start of
+ * the chip. Page programs never cross a 256 byte page.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "logger.h"
+
+/*! Sectors used by the log */
+#ifndef LOGGER_NOR_BLOCKS
+#define LOGGER_NOR_BLOCKS 16
+#endif
+
+#define NOR_SECTOR 4096
+#define NOR_PAGE 256
+
+#define NOR_WREN 0x06
+#define NOR_RDSR 0x05
+#define NOR_READ 0x03
+#define NOR_PP 0x02
+#define NOR_SE 0x20
+/* status register, write in progress */
+#define NOR_WIP 0x01
+
+static uint8_t spi_tx(const uint8_t c)
+{
+	SPDR = c;
+	loop_until_bit_is_set(SPSR, SPIF);
+	return(SPDR);
+}
+
+static void cs_low(void)
+{
+	/* the first call sets up the SPI, fck/2 */
+	if (!(SPCR & _BV(SPE))) {
+		PORTB |= _BV(PB2);
+		DDRB |= _BV(PB2) | _BV(PB3) | _BV(PB5);
+		SPCR = _BV(SPE) | _BV(MSTR);
+		SPSR = _BV(SPI2X);
+	}
+
+	PORTB &= ~_BV(PB2);
+}
+
+static void cs_high(void)
+{
+	PORTB |= _BV(PB2);
+}
+
+/* a command with a 24 bit address */
+static void command(const uint8_t cmd, const uint32_t addr)
+{
+	cs_low();
+	spi_tx(cmd);
+	spi_tx(addr >> 16);
+	spi_tx(addr >> 8);
+	spi_tx(addr);
+}
+
+static void write_enable(void)
+{
+	cs_low();
+	spi_tx(NOR_WREN);
+	cs_high();
+}
+
+static void wait_ready(void)
+{
+	cs_low();
+	spi_tx(NOR_RDSR);
+
+	while (spi_tx(0) & NOR_WIP);
+
+	cs_high();
+}
+
+static void nor_read(const uint32_t addr, uint8_t *buf, const uint16_t len)
+{
+	uint16_t i;
+
+	command(NOR_READ, addr);
+
+	for (i = 0; i < len; i++)
+		buf[i] = spi_tx(0);
+
+	cs_high();
+}
+
+static void nor_write(uint32_t addr, const uint8_t *buf, uint16_t len)
+{
+	uint16_t n;
+
+	while (len) {
+		/* up to the end of the page */
+		n = NOR_PAGE - (addr & (NOR_PAGE - 1));
+
+		if (n > len)
+			n = len;
+
+		write_enable();
+		command(NOR_PP, addr);
+		addr += n;
+		len -= n;
+
+		while (n--)
+			spi_tx(*buf++);
+
+		cs_high();
+		wait_ready();
+	}
+}
+
+static void nor_erase(const uint32_t addr)
+{
+	write_enable();
+	command(NOR_SE, addr);
+	cs_high();
+	wait_ready();
+}
+
+const struct logger_dev_t logger_nor = {
+	NOR_SECTOR,
+	LOGGER_NOR_BLOCKS,
+	nor_read,
+	nor_write,
+	nor_erase
+};
@@ -0,0 +1,162 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "uart.h"
+#include "lowpower.h"
+
+/* Timer2 tick, prescaler 1024, in us */
+#define TICK_US (1024000000UL / F_CPU)
+/* max ms in one Timer2 period */
+#define CHUNK_MS 16
+
+struct lowpower_stat_t lowpower_stat;
+
+static volatile uint8_t wake;
+
+/* Timer2 period end */
+ISR(TIMER2_COMPA_vect)
+{
+	wake = 1;
+}
+
+#ifdef LOWPOWER_EOC
+/* end of conversion */
+ISR(INT0_vect)
+{
+	wake = 2;
+}
+#endif
+
+/* the watchdog interrupt, power-down only */
+EMPTY_INTERRUPT(WDT_vect)
+
+/* Sleep in idle up to ms, at most CHUNK_MS.
+ *
+ * return 2 if the EOC ended it.
+ */
+static uint8_t idle(const uint8_t ms)
+{
+	uint8_t ticks;
+
+	ticks = (uint8_t)(((uint32_t)ms * 1000 + TICK_US - 1) / TICK_US - 1);
+	wake = 0;
+	TCCR2A = _BV(WGM21);
+	TCNT2 = 0;
+	OCR2A = ticks;
+	TIFR2 = _BV(OCF2A);
+	TIMSK2 = _BV(OCIE2A);
+	TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+	/* other interrupts wake it too, no wake lost before the sleep */
+	cli();
+
+	while (!wake) {
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+
+	sei();
+
+	TCCR2B = 0;
+	TIMSK2 = 0;
+	lowpower_stat.idle_us += (uint32_t)((wake == 1) ? ticks + 1 :
+			TCNT2) * TICK_US;
+	return(wake);
+}
+
+/*! Wait ms sleeping in idle.
+ *
+ * \note interrupts must be enabled.
+ */
+void lowpower_wait_ms(const uint8_t ms)
+{
+	uint8_t left, chunk;
+
+#ifdef LOWPOWER_EOC
+	/* rising edge */
+	EICRA = _BV(ISC01) | _BV(ISC00);
+	EIFR = _BV(INTF0);
+	EIMSK = _BV(INT0);
+#endif
+
+	left = ms;
+
+	while (left) {
+		chunk = (left > CHUNK_MS) ? CHUNK_MS : left;
+
+		if (idle(chunk) == 2)
+			break;
+
+		left -= chunk;
+	}
+
+#ifdef LOWPOWER_EOC
+	EIMSK = 0;
+#endif
+}
+
+/*! Power-down for about s seconds.
+ *
+ * The UART TX is flushed first, it stops in power-down. Woken by
+ * the watchdog every second, any other interrupt only shortens
+ * that second.
+ */
+void lowpower_sleep_s(uint16_t s)
+{
+	uart_flush(0);
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+
+	while (s--) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			wdt_reset();
+			/* interrupt only, 1 s */
+			WDTCSR = _BV(WDCE) | _BV(WDE);
+			WDTCSR = _BV(WDIE) | _BV(WDP2) | _BV(WDP1);
+		}
+
+		sleep_mode();
+		lowpower_stat.pwrdown_ms += 1000;
+	}
+
+	wdt_disable();
+}
+
+/*! Charge of a sample in nC (uA * ms).
+ *
+ * \param active_us the CPU awake.
+ * \param idle_us the CPU in idle.
+ * \param pwrdown_ms the CPU in power-down.
+ * \param sensor_us the sensor converting.
+ */
+uint32_t lowpower_charge(const uint32_t active_us, const uint32_t idle_us,
+		const uint32_t pwrdown_ms, const uint32_t sensor_us)
+{
+	return((active_us / 10 * LOWPOWER_I_ACTIVE +
+				idle_us / 10 * LOWPOWER_I_IDLE +
+				sensor_us / 10 * LOWPOWER_I_SENSOR) / 100 +
+			pwrdown_ms * LOWPOWER_I_PWRDOWN);
+}
@@ -0,0 +1,91 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file lowpower.h
+ * \brief Sleep during the conversions and between the samples.
+ *
+ * Built with -D BMP180_SLEEP (make SLEEP=1) the drivers wait the
+ * conversions with lowpower_wait_ms() instead of _delay_ms(): the
+ * CPU is in idle, woken by the Timer2 compare every 16 ms at most.
+ * Idle keeps the I/O clock, so the TWI, Timer1 and the UART TX
+ * interrupt (UART_TX_IRQ) go on while it sleeps. With LOWPOWER_EOC
+ * the wait also ends at the rising edge of the EOC line on INT0,
+ * for the BMP085 and the modules wiring it out, Timer2 is then the
+ * timeout.
+ *
+ * Power-save would need Timer2 on a 32Khz crystal, the Arduino has
+ * none, so between the samples lowpower_sleep_s() uses power-down
+ * and the watchdog interrupt, 1 s steps +/- 10%.
+ *
+ * lowpower_stat counts the time slept, lowpower_charge() turns the
+ * time in each state into charge with the LOWPOWER_I_* currents,
+ * typical ATmega328p at 16Mhz 5V, to be replaced by measured ones.
+ * Regulators, LEDs and USB chip of a board are not included.
+ */
+
+#ifndef _LOWPOWER_H_
+#define _LOWPOWER_H_
+
+#include <stdint.h>
+#include <util/delay.h>
+
+/*! Supply current in uA, active, idle, power-down with watchdog */
+#ifndef LOWPOWER_I_ACTIVE
+#define LOWPOWER_I_ACTIVE 9000UL
+#endif
+#ifndef LOWPOWER_I_IDLE
+#define LOWPOWER_I_IDLE 2600UL
+#endif
+#ifndef LOWPOWER_I_PWRDOWN
+#define LOWPOWER_I_PWRDOWN 6UL
+#endif
+/*! BMP180 during a conversion, peak from the datasheet */
+#ifndef LOWPOWER_I_SENSOR
+#define LOWPOWER_I_SENSOR 650UL
+#endif
+
+/*! Time slept, free running. */
+struct lowpower_stat_t {
+	/*! in idle, us. */
+	uint32_t idle_us;
+	/*! in power-down, ms. */
+	uint32_t pwrdown_ms;
+};
+
+extern struct lowpower_stat_t lowpower_stat;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void lowpower_wait_ms(const uint8_t ms);
+void lowpower_sleep_s(uint16_t s);
+uint32_t lowpower_charge(const uint32_t active_us, const uint32_t idle_us,
+		const uint32_t pwrdown_ms, const uint32_t sensor_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*! The conversion wait of the drivers. */
+#ifdef BMP180_SLEEP
+#define BMP180_WAIT_MS(ms) lowpower_wait_ms(ms)
+#else
+#define BMP180_WAIT_MS(ms) _delay_ms(ms)
+#endif
+
+#endif
@@ -15,90 +15,71 @@
  * If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdlib.h>
 #include <stdio.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include "bmp180.h"
 #include "uart.h"
+#include "trace.h"
+#include "i2c_rec.h"
+#include "alarm.h"
+#include "cic.h"
+#include "timer.h"
+#include "lowpower.h"
+#include "cmd.h"
+#include "fmt.h"
+#include "logger.h"
+
+/*! Max readings averaged */
+#define MAIN_AVG_MAX 32
+
+/* print "name: value\n" */
+static void print_line(const char *name, const int32_t value, char *string)
+{
+	char *e;
+
+	e = fmt_str(string, name);
+	e = fmt_i32(e, value);
+	fmt_str(e, "\n");
+	uart_printstr(0, string);
+}
 
 /*! Print the bmp180 struct content
  *
  */
 void print_struct(struct bmp180_t *bmp180, char *string)
 {
-	string = utoa(bmp180->id, string, 16);
-	uart_printstr(0, "id: 0x");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = utoa(bmp180->oss, string, 16);
-	uart_printstr(0, "oss: 0x");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->AC1, string, 10);
-	uart_printstr(0, "AC1: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->AC2, string, 10);
-	uart_printstr(0, "AC2: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->AC3, string, 10);
-	uart_printstr(0, "AC3: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = utoa(bmp180->AC4, string, 10);
-	uart_printstr(0, "AC4: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
+	char *e;
 
-	string = utoa(bmp180->AC5, string, 10);
-	uart_printstr(0, "AC5: ");
+	e = fmt_str(string, "id: 0x");
+	e = fmt_hex(e, bmp180->id);
+	e = fmt_str(e, "\noss: 0x");
+	e = fmt_hex(e, bmp180->oss);
+	fmt_str(e, "\n");
 	uart_printstr(0, string);
-	uart_printstr(0, "\n");
 
-	string = utoa(bmp180->AC6, string, 10);
-	uart_printstr(0, "AC6: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->B1, string, 10);
-	uart_printstr(0, "B1: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->B2, string, 10);
-	uart_printstr(0, "B2: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->MB, string, 10);
-	uart_printstr(0, "MB: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->MC, string, 10);
-	uart_printstr(0, "MC: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = itoa(bmp180->MD, string, 10);
-	uart_printstr(0, "MD: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
+	print_line("AC1: ", bmp180->cal.AC1, string);
+	print_line("AC2: ", bmp180->cal.AC2, string);
+	print_line("AC3: ", bmp180->cal.AC3, string);
+	print_line("AC4: ", bmp180->cal.AC4, string);
+	print_line("AC5: ", bmp180->cal.AC5, string);
+	print_line("AC6: ", bmp180->cal.AC6, string);
+	print_line("B1: ", bmp180->cal.B1, string);
+	print_line("B2: ", bmp180->cal.B2, string);
+	print_line("MB: ", bmp180->cal.MB, string);
+	print_line("MC: ", bmp180->cal.MC, string);
+	print_line("MD: ", bmp180->cal.MD, string);
 }
 
 void print_error(uint8_t error, char *string)
 {
-	string = utoa(error, string, 16);
-	uart_printstr(0, "\nError: 0x");
+	char *e;
+
+	e = fmt_str(string, "\nError: 0x");
+	e = fmt_hex(e, error);
+	fmt_str(e, "\n");
 	uart_printstr(0, string);
-	uart_printstr(0, "\n");
 }
 
 /*! Print the temperature and pressure.
@@ -107,25 +88,18 @@ void print_error(uint8_t error, char *string)
  */
 void print_results(struct bmp180_t *bmp180, char *string)
 {
-	string = ultoa(bmp180->UT, string, 10);
-	uart_printstr(0, "UT: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = ultoa(bmp180->UP, string, 10);
-	uart_printstr(0, "UP: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = ultoa(bmp180->T, string, 10);
-	uart_printstr(0, "T: ");
+	char *e;
+
+	e = fmt_str(string, "UT: ");
+	e = fmt_u32(e, bmp180->UT);
+	e = fmt_str(e, "\nUP: ");
+	e = fmt_u32(e, bmp180->UP);
+	e = fmt_str(e, "\nT: ");
+	e = fmt_fix(e, bmp180->T, 1, 0);
+	e = fmt_str(e, "\np: ");
+	e = fmt_u32(e, bmp180->p);
+	fmt_str(e, "\n");
 	uart_printstr(0, string);
-	uart_printstr(0, "\n");
-
-	string = ultoa(bmp180->p, string, 10);
-	uart_printstr(0, "p: ");
-	uart_printstr(0, string);
-	uart_printstr(0, "\n");
 }
 
 /* Simulate the sound of a buzzer.
@@ -136,14 +110,11 @@ void print_results(struct bmp180_t *bmp180, char *string)
  */
 void beep(int32_t dp, const char updown, char *string)
 {
-	int8_t beeps;
+	char *e;
 	uint8_t i;
 
-	beeps = (int8_t)(dp/12);
-	string = itoa(beeps, string, 10);
-
 	if (updown == '+') {
-		uart_printstr(0, "beeps UP ");
+		e = fmt_str(string, "beeps UP ");
 
 		for (i=0; i<50; i++) {
 			PORTC |= _BV(PC0);
@@ -152,28 +123,375 @@ void beep(int32_t dp, const char updown, char *string)
 			_delay_us(900);
 		}
 	} else {
-		uart_printstr(0, "beeps DOWN ");
+		e = fmt_str(string, "beeps DOWN ");
+	}
+
+	e = fmt_i32(e, (int8_t)(dp/12));
+	fmt_str(e, " ");
+	uart_printstr(0, string);
+}
+
+#ifdef MAIN_DUTY_S
+static void print_value(const char *name, const uint32_t value, char *string)
+{
+	fmt_u32(fmt_str(string, name), value);
+	uart_printstr(0, string);
+}
+
+/*! Measure every MAIN_DUTY_S seconds, power-down in between.
+ *
+ * After each period print the time awake, in idle and in
+ * power-down, the charge and the average current of the MCU and
+ * the sensor, see lowpower.h.
+ */
+static void duty_cycle(struct bmp180_t *bmp180, char *string)
+{
+	/* conversions as the driver waits them, oss 0..3 */
+	const uint8_t conv_ms[4] = { 5, 8, 14, 26 };
+	uint32_t cycles, idle, pwrdown, active, charge, now;
+	uint8_t err;
+
+	timer_init();
+	cycles = timer_cycles();
+	idle = lowpower_stat.idle_us;
+	pwrdown = lowpower_stat.pwrdown_ms;
+
+	while (1) {
+		err = bmp180_read_all(bmp180);
+
+		if (err) {
+			print_error(err, string);
+		} else {
+			print_value("p ", bmp180->p, string);
+			print_value(" T ", bmp180->T, string);
+			uart_printstr(0, "\n");
+		}
+
+		lowpower_sleep_s(MAIN_DUTY_S);
+
+		/* Timer1 stops in power-down */
+		now = timer_cycles();
+		idle = lowpower_stat.idle_us - idle;
+		pwrdown = lowpower_stat.pwrdown_ms - pwrdown;
+		active = (now - cycles) / (F_CPU / 1000000UL) - idle;
+		charge = lowpower_charge(active, idle, pwrdown,
+				(5UL + conv_ms[bmp180->oss]) * 1000);
+		print_value("awake_us ", active, string);
+		print_value(" idle_us ", idle, string);
+		print_value(" pwrdown_ms ", pwrdown, string);
+		print_value(" nC ", charge, string);
+		print_value(" avg_uA ", charge / (active / 1000 + idle / 1000 +
+					pwrdown), string);
+		uart_printstr(0, "\n");
+		cycles = now;
+		idle = lowpower_stat.idle_us;
+		pwrdown = lowpower_stat.pwrdown_ms;
 	}
+}
+#endif
+
+#ifdef MAIN_ALLAN
+/*! Capture MAIN_ALLAN raw samples back to back at each oss.
+ *
+ * The input of tools/allan.py, after the print_struct() output:
+ * a line "a oss UT UP" per sample and, after the oss block, a line
+ * "A oss samples us" with its duration, failed reads included. UT
+ * is read again every 32 samples, as the temperature changes much
+ * slower than the noise.
+ */
+static void allan_capture(struct bmp180_t *bmp180, char *string)
+{
+	uint32_t us, last, now;
+	uint16_t i, n;
+	char *e;
+	uint8_t oss, err;
+
+	timer_init();
+
+	for (oss = BMP180_RES_LOW; oss <= BMP180_RES_ULTRAHIGH; oss++) {
+		bmp180->oss = oss;
+		us = 0;
+		n = 0;
+		last = timer_cycles();
+
+		for (i = 0; i < MAIN_ALLAN; i++) {
+			err = (i & 31) ? 0 : bmp180_read_ut(bmp180);
+
+			if (!err)
+				err = bmp180_read_up(bmp180);
+
+			if (err) {
+				print_error(err, string);
+				continue;
+			}
+
+			e = fmt_str(string, "a ");
+			e = fmt_u32(e, oss);
+			e = fmt_str(e, " ");
+			e = fmt_u32(e, bmp180->UT);
+			e = fmt_str(e, " ");
+			e = fmt_u32(e, bmp180->UP);
+			fmt_str(e, "\n");
+			uart_printstr(0, string);
+			n++;
+
+			/* Timer1 wraps in 268 s, add it up per sample */
+			now = timer_cycles();
+			us += (now - last) / (F_CPU / 1000000UL);
+			last = now;
+		}
+
+		e = fmt_str(string, "A ");
+		e = fmt_u32(e, oss);
+		e = fmt_str(e, " ");
+		e = fmt_u32(e, n);
+		e = fmt_str(e, " ");
+		e = fmt_u32(e, us);
+		fmt_str(e, "\n");
+		uart_printstr(0, string);
+	}
+}
+#endif
+
+/*! The sampling setup, changed at runtime by the commands. */
+struct setup_t {
+	struct bmp180_t *bmp180;
+	struct alarm_t *alarm;
+#ifdef MAIN_CIC_RATE
+	struct cic_t *cic;
+#endif
+	char *string;
+	/*! readings averaged, 1..MAIN_AVG_MAX, with CIC log2 decimation */
+	uint8_t avg;
+	/*! output, 0 p dp dA, 1 p T, 2 UT UP */
+	uint8_t fmt;
+	/*! ms between samples */
+	uint16_t period;
+	/*! samples and failed samples since the start */
+	uint32_t samples;
+	uint32_t errors;
+	/*! the last error */
+	uint8_t error;
+#ifdef MAIN_LOG
+	struct logger_t *log;
+	/*! s between logged samples */
+	uint16_t log_s;
+#endif
+};
+
+#ifdef MAIN_CMD
+#ifndef MAIN_CIC_RATE
+static uint8_t cmd_oss(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	if (arg < BMP180_RES_LOW || arg > BMP180_RES_ULTRAHIGH)
+		return(CMD_E_ARG);
+
+	setup->bmp180->oss = arg;
+	return(CMD_OK);
+}
+#endif
+
+static uint8_t cmd_avg(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+#ifdef MAIN_CIC_RATE
+	/* the decimation, 2^arg */
+	if (arg < 0 || arg > CIC_RATE_MAX)
+		return(CMD_E_ARG);
+
+	cic_init(setup->cic, arg);
+#else
+	if (arg < 1 || arg > MAIN_AVG_MAX)
+		return(CMD_E_ARG);
+
+#endif
+	setup->avg = arg;
+	return(CMD_OK);
+}
+
+static uint8_t cmd_period(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	if (arg < 0 || arg > 60000)
+		return(CMD_E_ARG);
+
+	setup->period = arg;
+	return(CMD_OK);
+}
+
+static uint8_t cmd_fmt(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	if (arg < 0 || arg > 2)
+		return(CMD_E_ARG);
+
+	setup->fmt = arg;
+	return(CMD_OK);
+}
+
+static uint8_t cmd_qnh(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	if (arg < 30000 || arg > 110000)
+		return(CMD_E_ARG);
+
+	alarm_qnh(setup->alarm, arg);
+	return(CMD_OK);
+}
+
+static uint8_t cmd_stat(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+	char *e;
+
+	e = fmt_str(setup->string, "oss ");
+	e = fmt_u32(e, setup->bmp180->oss);
+	e = fmt_str(e, " avg ");
+	e = fmt_u32(e, setup->avg);
+	e = fmt_str(e, " period ");
+	e = fmt_u32(e, setup->period);
+	e = fmt_str(e, " fmt ");
+	e = fmt_u32(e, setup->fmt);
+	fmt_str(e, "\n");
+	uart_printstr(0, setup->string);
+	e = fmt_str(setup->string, "samples ");
+	e = fmt_u32(e, setup->samples);
+	e = fmt_str(e, " errors ");
+	e = fmt_u32(e, setup->errors);
+	e = fmt_str(e, " last 0x");
+	e = fmt_hex(e, setup->error);
+	e = fmt_str(e, " rx_lost ");
+	e = fmt_u32(e, uart_rx_lost(0));
+	fmt_str(e, "\n");
+	uart_printstr(0, setup->string);
+	return(CMD_OK);
+}
+
+static uint8_t cmd_cal(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
 
+	print_struct(setup->bmp180, setup->string);
+	return(CMD_OK);
+}
+
+#ifdef MAIN_LOG
+static uint8_t cmd_dump(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	logger_dump(setup->log, setup->string);
+	return(CMD_OK);
+}
+
+static uint8_t cmd_logclr(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	logger_clear(setup->log);
+	return(CMD_OK);
+}
+
+static uint8_t cmd_logper(void *ctx, const int32_t arg)
+{
+	struct setup_t *setup = ctx;
+
+	if (arg < 1 || arg > 3600)
+		return(CMD_E_ARG);
+
+	setup->log_s = arg;
+	return(CMD_OK);
+}
+#endif
+
+#ifdef TRACE_ENABLE
+static uint8_t cmd_trace(void *ctx, const int32_t arg)
+{
+	trace_dump();
+	return(CMD_OK);
+}
+#endif
+
+/*! The commands, see cmd.h */
+static const struct cmd_t cmds[] = {
+#ifndef MAIN_CIC_RATE
+	/* the CIC samples at oss 0 */
+	{ "oss", cmd_oss },
+#endif
+	{ "avg", cmd_avg },
+	{ "period", cmd_period },
+	{ "fmt", cmd_fmt },
+	{ "qnh", cmd_qnh },
+	{ "stat", cmd_stat },
+	{ "cal", cmd_cal },
+#ifdef MAIN_LOG
+	{ "dump", cmd_dump },
+	{ "logclr", cmd_logclr },
+	{ "logper", cmd_logper },
+#endif
+#ifdef TRACE_ENABLE
+	{ "trace", cmd_trace },
+#endif
+};
+#endif
+
+/*! Altitude bands, m */
+static const int16_t bands[] = { 0, 100, 500, 1000 };
+
+/*! Print the band crossings. */
+static void alarm_event(const uint8_t threshold, const uint8_t dir)
+{
+	char string[24];
+	char *e;
+
+	e = fmt_str(string, (dir == ALARM_UP) ? "\nALARM UP " : "\nALARM DOWN ");
+	e = fmt_i32(e, bands[threshold]);
+	fmt_str(e, "m\n");
 	uart_printstr(0, string);
-	uart_printstr(0, " ");
 }
 
 int main(void)
 {
+	/* static, no heap: avr-size counts them in the RAM used */
+	static struct bmp180_t sensor;
+	static char line[80];
 	struct bmp180_t *bmp180;
+	struct alarm_t alarm;
+	struct setup_t setup;
+#ifdef MAIN_CIC_RATE
+	struct cic_t cic;
+#else
+	struct bmp180_raw_t raw[MAIN_AVG_MAX];
+#endif
+#ifdef MAIN_LOG
+	struct logger_t log;
+	/* time in 0.1 s, the cycles not counted yet, the next log */
+	uint32_t ds, cycles, last, now, next;
+#endif
 	char *string;
-	uint8_t i, err;
+	uint8_t err;
+	uint16_t ms;
 	int32_t pmed, pold, dp;
-	float dA;
+	/* altitude change, 0.01 cm */
+	int32_t dA;
+	char *e;
 
 	PORTC = 0;
 	DDRC |= _BV(PC0);
 
-	string = malloc(80);
-	bmp180 = malloc(sizeof(struct bmp180_t));
+	string = line;
+	bmp180 = &sensor;
 
 	uart_init(0);
+	trace_init();
+	i2c_rec_init();
+	sei();
 	uart_printstr(0, "BMP180 example prg.\n");
 
 	_delay_ms(1000);
@@ -185,6 +503,33 @@ int main(void)
 
 	print_struct(bmp180, string);
 	bmp180->oss = BMP180_RES_ULTRAHIGH;
+	alarm_init(&alarm, alarm_event);
+	alarm_set(&alarm, bands, sizeof(bands) / sizeof(bands[0]), 10);
+	alarm_qnh(&alarm, bmp180->p0);
+	setup.bmp180 = bmp180;
+	setup.alarm = &alarm;
+	setup.string = string;
+	setup.avg = MAIN_AVG_MAX;
+	setup.fmt = 0;
+	setup.period = 0;
+	setup.samples = 0;
+	setup.errors = 0;
+	setup.error = 0;
+#ifdef MAIN_LOG
+	logger_init(&log, &MAIN_LOG);
+	setup.log = &log;
+	setup.log_s = 10;
+	timer_init();
+	ds = 0;
+	cycles = 0;
+	next = 0;
+	last = timer_cycles();
+#endif
+#ifdef MAIN_CIC_RATE
+	setup.cic = &cic;
+	setup.avg = MAIN_CIC_RATE;
+	cic_init(&cic, MAIN_CIC_RATE);
+#endif
 	err = bmp180_read_all(bmp180);
 	pold = bmp180->p;
 	dA = 0;
@@ -192,44 +537,106 @@ int main(void)
 	if (!err)
 		print_results(bmp180, string);
 
+#ifdef MAIN_ALLAN
+	allan_capture(bmp180, string);
+	bmp180->oss = BMP180_RES_ULTRAHIGH;
+#endif
+
+#ifdef MAIN_DUTY_S
+	duty_cycle(bmp180, string);
+#endif
+
 	/* try media for 32 readings,
 	 * p = ((p*31) + new)/2^6)
 	 */
 	while(1) {
-		i = 0;
-		pmed = 0;
-
-		/* use and average of 32 readings */
-		while (i<32) {
-			err = bmp180_read_pressure(bmp180);
-			pmed += bmp180->p;
-			i++;
+		/* use and average of setup.avg readings,
+		 * compensated only once on the averaged raw value.
+		 */
+#ifdef MAIN_CIC_RATE
+		/* oss 0 as fast as possible, decimated */
+		err = bmp180_capture_cic(bmp180, &cic);
+#else
+		err = bmp180_capture(bmp180, raw, setup.avg);
+
+		if (!err)
+			bmp180_compensate_avg(bmp180, raw, setup.avg);
+#endif
+		setup.samples++;
+
+		if (err) {
+			setup.errors++;
+			setup.error = err;
+			print_error(err, string);
 		}
 
-		/* pmed = pmed / 32 */
-		pmed >>= 5;
+		pmed = bmp180->p;
+		alarm_check(&alarm, pmed);
 		dp = pmed-pold;
 
 		/* Dp (delta pressure) of 1hpa = 8.43m @ sea level */
-		dA = (dA + dp * -8.43) / 2;
+		dA = (dA + dp * -843) / 2;
 		pold = pmed;
 
-		if (dp > 12)
-			beep(dp, '-', string);
-		else if (dp < -12)
-			beep(dp, '+', string);
+		if (setup.fmt == 1) {
+			e = fmt_u32(string, pmed);
+			e = fmt_str(e, " ");
+			e = fmt_fix(e, bmp180->T, 1, 0);
+		} else if (setup.fmt == 2) {
+			e = fmt_u32(string, bmp180->UT);
+			e = fmt_str(e, " ");
+			e = fmt_u32(e, bmp180->UP);
+		} else {
+			if (dp > 12)
+				beep(dp, '-', string);
+			else if (dp < -12)
+				beep(dp, '+', string);
+
+			e = fmt_u32(string, pmed);
+			e = fmt_str(e, " ");
+			e = fmt_i32(e, dp);
+			e = fmt_str(e, " ");
+			e = fmt_fix(e, dA, 2, 10);
+		}
 
-		string = ultoa(pmed, string, 10);
+		fmt_str(e, "\n");
 		uart_printstr(0, string);
-		uart_printstr(0, " ");
 
-		string = itoa(dp, string, 10);
-		uart_printstr(0, string);
-		uart_printstr(0, " ");
+#ifdef MAIN_LOG
+		/* Timer1 wraps in 268 s, add it up per sample */
+		now = timer_cycles();
+		cycles += now - last;
+		last = now;
 
-		string = dtostrf(dA, 10, 2, string);
-		uart_printstr(0, string);
-		uart_printstr(0, "\n");
+		while (cycles >= F_CPU / 10) {
+			cycles -= F_CPU / 10;
+			ds++;
+		}
+
+		if (!err && ds >= next) {
+			logger_put(&log, ds, pmed, bmp180->T);
+			next = ds + setup.log_s * 10UL;
+		}
+#endif
+
+		/* make RECORD=1, the i2c record, see i2c_rec.h */
+		i2c_rec_flush();
+
+		/* make CMD=1, the commands received during the sample */
+#ifdef MAIN_CMD
+		cmd_poll(cmds, sizeof(cmds) / sizeof(cmds[0]), &setup);
+#elif defined(TRACE_ENABLE)
+		/* send T to get the trace */
+		if (uart_getchar(0, FALSE) == 'T')
+			trace_dump();
+#endif
+
+		for (ms = 0; ms < setup.period; ms++) {
+			BMP180_WAIT_MS(1);
+#ifdef MAIN_CMD
+			cmd_poll(cmds, sizeof(cmds) / sizeof(cmds[0]), &setup);
+#endif
+		}
 	}
 
 	return(0);
@@ -0,0 +1,125 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "queue.h"
+
+/*! Init the queue, must be called before the producer starts. */
+void queue_init(struct queue_t *queue)
+{
+	queue->head = 0;
+	queue->tail = 0;
+	queue->overrun = 0;
+}
+
+/*! Push a sample, producer side.
+ *
+ * If the queue is full the sample is dropped and the overrun
+ * counter incremented, old samples are never overwritten
+ * because the consumer may be reading them.
+ *
+ * \return 0 - OK, 1 - queue full.
+ */
+uint8_t queue_push(struct queue_t *queue, const struct bmp180_sample_t *s)
+{
+	uint8_t head;
+
+	head = queue->head;
+
+	if ((uint8_t)(head - queue->tail) == QUEUE_SIZE) {
+		if (queue->overrun != 0xffff)
+			queue->overrun++;
+
+		return(1);
+	}
+
+	queue->buf[head & QUEUE_MASK] = *s;
+	/* the sample must be in place before it is published */
+	QUEUE_BARRIER();
+	queue->head = head + 1;
+	return(0);
+}
+
+/*! Pop a sample, consumer side.
+ *
+ * \return 0 - OK, 1 - queue empty.
+ */
+uint8_t queue_pop(struct queue_t *queue, struct bmp180_sample_t *s)
+{
+	uint8_t tail;
+
+	tail = queue->tail;
+
+	if (tail == queue->head)
+		return(1);
+
+	/* do not read the slot before the head has been seen */
+	QUEUE_BARRIER();
+	*s = queue->buf[tail & QUEUE_MASK];
+	QUEUE_BARRIER();
+	queue->tail = tail + 1;
+	return(0);
+}
+
+/*! Number of samples waiting, consumer side. */
+uint8_t queue_count(struct queue_t *queue)
+{
+	return((uint8_t)(queue->head - queue->tail));
+}
+
+/*! Samples lost since init.
+ *
+ * The counter is wider than the bus, read it until two reads
+ * agree instead of masking the interrupts.
+ */
+uint16_t queue_overrun(struct queue_t *queue)
+{
+	uint16_t n;
+
+	do {
+		n = queue->overrun;
+	} while (n != queue->overrun);
+
+	return(n);
+}
+
+/*! Publish the latest sample, writer side. */
+void latest_put(struct latest_t *latest, const struct bmp180_sample_t *s)
+{
+	latest->seq++;
+	QUEUE_BARRIER();
+	latest->sample = *s;
+	QUEUE_BARRIER();
+	latest->seq++;
+}
+
+/*! Read a consistent copy of the latest sample, reader side.
+ *
+ * If the writer has been running in the middle of the copy the
+ * copy is done again.
+ */
+void latest_get(struct latest_t *latest, struct bmp180_sample_t *s)
+{
+	uint8_t seq;
+
+	do {
+		seq = latest->seq;
+		QUEUE_BARRIER();
+		*s = latest->sample;
+		QUEUE_BARRIER();
+	} while ((seq & 1) || (seq != latest->seq));
+}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file queue.h
+ * \brief Lock-free single producer, single consumer sample queue.
+ *
+ * The producer is typically an ISR and the consumer the main loop.
+ * Each index is a single byte written by one side only, so no
+ * interrupt masking is needed on either side.
+ */
+
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
+#include <stdint.h>
+#include "bmp180.h"
+
+/*! Queue size, power of 2 and at most 128 */
+#ifndef QUEUE_SIZE
+#define QUEUE_SIZE 16
+#endif
+/*! Queue mask */
+#define QUEUE_MASK ( QUEUE_SIZE - 1 )
+/*! Check if something is wrong in the definitions */
+#if ( QUEUE_SIZE & QUEUE_MASK ) || ( QUEUE_SIZE > 128 )
+#error QUEUE_SIZE is not a power of 2 or is bigger than 128
+#endif
+
+/*! Compiler (and CPU on the host) memory barrier */
+#ifdef __AVR__
+#define QUEUE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+#else
+#define QUEUE_BARRIER() __sync_synchronize()
+#endif
+
+/*! The queue.
+ *
+ * head and tail are free running counters, the slot is the
+ * counter masked.
+ */
+struct queue_t {
+	/*! samples. */
+	struct bmp180_sample_t buf[QUEUE_SIZE];
+	/*! next slot to write, producer only. */
+	volatile uint8_t head;
+	/*! next slot to read, consumer only. */
+	volatile uint8_t tail;
+	/*! samples dropped on a full queue, producer only. */
+	volatile uint16_t overrun;
+};
+
+/*! Latest sample snapshot.
+ *
+ * seq is odd while the writer is updating the sample,
+ * readers retry until they see the same even seq before and
+ * after the copy.
+ */
+struct latest_t {
+	/*! sequence counter. */
+	volatile uint8_t seq;
+	/*! the sample. */
+	struct bmp180_sample_t sample;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void queue_init(struct queue_t *queue);
+uint8_t queue_push(struct queue_t *queue, const struct bmp180_sample_t *s);
+uint8_t queue_pop(struct queue_t *queue, struct bmp180_sample_t *s);
+uint8_t queue_count(struct queue_t *queue);
+uint16_t queue_overrun(struct queue_t *queue);
+void latest_put(struct latest_t *latest, const struct bmp180_sample_t *s);
+void latest_get(struct latest_t *latest, struct bmp180_sample_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "timer.h"
+
+/* upper 16 bit of the counter */
+static volatile uint16_t overflow;
+
+ISR(TIMER1_OVF_vect)
+{
+	overflow++;
+}
+
+/*! Start Timer1, normal mode, no prescaler.
+ *
+ * \note interrupts must be enabled.
+ */
+void timer_init(void)
+{
+	overflow = 0;
+	TCCR1A = 0;
+	TCNT1 = 0;
+	TIMSK1 = _BV(TOIE1);
+	TCCR1B = _BV(CS10);
+}
+
+/*! Stop Timer1. */
+void timer_shut(void)
+{
+	TCCR1B = 0;
+	TIMSK1 = 0;
+}
+
+/*! The CPU cycles since timer_init().
+ *
+ * An overflow pending but not yet served is added if the
+ * counter has already wrapped.
+ */
+uint32_t timer_cycles(void)
+{
+	uint16_t ovf, cnt;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ovf = overflow;
+		cnt = TCNT1;
+
+		if ((TIFR1 & _BV(TOV1)) && (cnt < 0x8000))
+			ovf++;
+	}
+
+	return(((uint32_t)ovf << 16) | cnt);
+}
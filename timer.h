@@ -0,0 +1,42 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file timer.h
+ * \brief Timer1 free running CPU cycles counter.
+ *
+ * Timer1 runs without prescaler, the overflow interrupt extends
+ * the counter to 32 bit (about 268 sec. at 16Mhz).
+ */
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void timer_init(void);
+void timer_shut(void);
+uint32_t timer_cycles(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,360 @@
+#!/usr/bin/env python3
+# Copyright (C) 2017 Enrico Rossi
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Noise of the raw captures, and the cheapest oss and averaging.
+
+The input is the serial output of the firmware built with
+make ALLAN=4096, ex.
+    stty -F /dev/ttyUSB0 115200 raw; cat /dev/ttyUSB0 > capture.txt
+It holds the print_struct() calibration, then "a oss UT UP" per
+sample and "A oss samples us" at the end of each oss block.
+
+Every sample is compensated to Pa, with the slope of the integer
+compensation around it to keep the sub Pa part of UP. The
+overlapping Allan deviation at the octaves of the sample period and
+the Welch PSD (Hann window, 50% overlap) are computed in a single
+pass, the memory is 2 * max tau samples plus one PSD segment per oss.
+
+With -t the cheapest setup reaching the noise target is suggested:
+the oss and number of readings averaged with the least conversion
+time per output, optionally within a max output period (-p). The
+firmware averages up to 32 readings, deeper averages of oss 0 are
+suggested as a CIC decimation build, make CIC=rate.
+The deviation of an average of n readings is taken as the Allan
+deviation at tau = n sample periods, the same for white noise and
+the right figure for the change between two outputs when the
+slower noise shows up.
+"""
+
+import argparse
+import cmath
+import math
+import re
+import sys
+
+NAMES = ["AC1", "AC2", "AC3", "AC4", "AC5", "AC6", "B1", "B2", "MB", "MC", "MD"]
+
+# conversion time of the driver, ms, see bmp180.c
+CONV_MS = [5, 8, 14, 26]
+# the UT conversion, once every 32 samples in the capture
+UT_MS = 5
+# the firmware avg command max, MAIN_AVG_MAX in main.c
+AVG_MAX = 32
+# the max make CIC= log2 decimation, at oss 0, CIC_RATE_MAX in cic.h
+CIC_RATE_MAX = 7
+
+
+def cdiv(a, b):
+    """C integer division, truncated toward zero."""
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+
+def pressure(cal, ut, up, oss):
+    """The integer compensation of bmp180_math.h, Pa."""
+    x1 = (ut - cal["AC6"]) * cal["AC5"] >> 15
+    x2 = cdiv(cal["MC"] * 2048, x1 + cal["MD"])
+    b6 = x1 + x2 - 4000
+    x1 = (cal["B2"] * (b6 * b6 >> 12)) >> 11
+    x2 = cal["AC2"] * b6 >> 11
+    b3 = (((cal["AC1"] * 4 + x1 + x2) << oss) + 2) >> 2
+    x1 = cal["AC3"] * b6 >> 13
+    x2 = (cal["B1"] * (b6 * b6 >> 12)) >> 16
+    x3 = (x1 + x2 + 2) >> 2
+    b4 = (cal["AC4"] * ((x3 + 32768) & 0xffffffff)) >> 15
+    b7 = ((up - b3) * (50000 >> oss)) & 0xffffffff
+
+    if b7 < 0x80000000:
+        p = (b7 << 1) // b4
+    else:
+        p = (b7 // b4) << 1
+
+    x1 = (p >> 8) * (p >> 8)
+    x1 = (x1 * 3038) >> 16
+    x2 = (-7357 * p) >> 16
+    return p + ((x1 + x2 + 3791) >> 4)
+
+
+def fft(x):
+    """Radix 2 FFT, len(x) a power of 2."""
+    n = len(x)
+
+    if n == 1:
+        return list(x)
+
+    even = fft(x[0::2])
+    odd = fft(x[1::2])
+    out = [0] * n
+
+    for k in range(n // 2):
+        t = cmath.exp(-2j * math.pi * k / n) * odd[k]
+        out[k] = even[k] + t
+        out[k + n // 2] = even[k] - t
+
+    return out
+
+
+class Noise:
+    """Streaming overlapping Allan deviation and Welch PSD of one oss."""
+
+    def __init__(self, max_m, segment):
+        self.ms = []
+        m = 1
+
+        while m <= max_m:
+            self.ms.append(m)
+            m <<= 1
+
+        self.size = 2 * max_m + 1
+        # phase ring, the cumulative sum of the samples
+        self.phase = [0.0] * self.size
+        self.n = 0
+        self.offset = None
+        self.sum2 = [0.0] * len(self.ms)
+        self.terms = [0] * len(self.ms)
+        self.segment = segment
+        self.window = [0.5 - 0.5 * math.cos(2 * math.pi * i / segment)
+                       for i in range(segment)]
+        self.buf = []
+        self.psd = [0.0] * (segment // 2 + 1)
+        self.segments = 0
+        self.mean = 0.0
+        self.var = 0.0
+        self.us = None
+        # the linear compensation around the last UT, see read()
+        self.slope = None
+        self.base = None
+
+    def put(self, y):
+        if self.offset is None:
+            self.offset = y
+
+        y -= self.offset
+        # Welford, the plain standard deviation
+        self.n += 1
+        d = y - self.mean
+        self.mean += d / self.n
+        self.var += d * (y - self.mean)
+
+        i = self.n % self.size
+        x = self.phase[(self.n - 1) % self.size] + y
+        self.phase[i] = x
+
+        for k, m in enumerate(self.ms):
+            if self.n < 2 * m:
+                break
+
+            t = x - 2 * self.phase[(self.n - m) % self.size] + \
+                self.phase[(self.n - 2 * m) % self.size]
+            self.sum2[k] += t * t
+            self.terms[k] += 1
+
+        self.buf.append(y)
+
+        if len(self.buf) == self.segment:
+            self.welch()
+            self.buf = self.buf[self.segment // 2:]
+
+    def welch(self):
+        mean = sum(self.buf) / self.segment
+        spec = fft([(v - mean) * w for v, w in zip(self.buf, self.window)])
+
+        for k in range(len(self.psd)):
+            self.psd[k] += abs(spec[k]) ** 2
+
+        self.segments += 1
+
+    def adev(self):
+        """[(m, deviation, terms)] of the octaves with data."""
+        return [(m, math.sqrt(s / (2.0 * m * m * t)), t)
+                for m, s, t in zip(self.ms, self.sum2, self.terms) if t]
+
+    def density(self, fs):
+        """[(Hz, Pa^2/Hz)], one sided."""
+        if not self.segments:
+            return []
+
+        scale = 1.0 / (fs * sum(w * w for w in self.window) * self.segments)
+        out = []
+
+        for k, v in enumerate(self.psd):
+            v *= scale
+
+            if 0 < k < self.segment // 2:
+                v *= 2
+
+            out.append((k * fs / self.segment, v))
+
+        return out
+
+
+def calibration(line, cal):
+    for name, value in re.findall(r"\b(AC[1-6]|B[12]|M[BCD])\s*:\s*(-?\d+)", line):
+        cal[name] = int(value)
+
+
+def read(f, max_m, segment):
+    cal = {}
+    noise = {}
+    ut = {}
+
+    for line in f:
+        fields = line.split()
+
+        if len(fields) == 4 and fields[0] == "a":
+            oss, ut_raw, up = (int(v) for v in fields[1:])
+
+            if len(cal) < len(NAMES):
+                sys.exit("no calibration before the samples")
+
+            if oss not in noise:
+                noise[oss] = Noise(max_m, segment)
+
+            # p(UP) is a step function, use its slope for the fraction
+            if ut.get(oss) != ut_raw:
+                ut[oss] = ut_raw
+                p0 = pressure(cal, ut_raw, up - 256, oss)
+                p1 = pressure(cal, ut_raw, up + 256, oss)
+                noise[oss].slope = (p1 - p0) / 512.0
+                noise[oss].base = (up, pressure(cal, ut_raw, up, oss))
+
+            n = noise[oss]
+            n.put(n.base[1] + (up - n.base[0]) * n.slope)
+        elif len(fields) == 4 and fields[0] == "A":
+            oss, count, us = (int(v) for v in fields[1:])
+
+            if oss in noise and count:
+                noise[oss].us = us / count
+        else:
+            calibration(line, cal)
+
+    return noise
+
+
+def report(noise, out):
+    for oss in sorted(noise):
+        n = noise[oss]
+
+        if n.us is None:
+            sys.exit("oss %d: no \"A\" line, the capture is truncated" % oss)
+
+        tau0 = n.us * 1e-6
+        std = math.sqrt(n.var / (n.n - 1)) if n.n > 1 else 0
+        out.write("# oss %d, %d samples, %.2f ms, std %.3f Pa\n" %
+                  (oss, n.n, tau0 * 1e3, std))
+        out.write("# tau_s adev_Pa terms\n")
+
+        for m, dev, terms in n.adev():
+            out.write("%.4f %.4f %d\n" % (m * tau0, dev, terms))
+
+        psd = n.density(1.0 / tau0)
+
+        if psd:
+            out.write("# Hz psd_Pa2/Hz, %d segments\n" % n.segments)
+            k = 1
+
+            # log spaced bins
+            while k < len(psd):
+                out.write("%.4f %.6f\n" % psd[k])
+                k = max(k + 1, int(k * 1.5))
+
+            white = sorted(v for _, v in psd[1:])[len(psd) // 2]
+            out.write("# white %.4f Pa/sqrt(Hz), %.3f Pa RMS per sample\n" %
+                      (math.sqrt(white), math.sqrt(white / (2 * tau0))))
+
+        out.write("\n")
+
+
+def suggest(noise, target, period, out):
+    """The least conversion time per output reaching the target."""
+    best = None
+
+    for oss in sorted(noise):
+        n = noise[oss]
+        tau0 = n.us * 1e-3
+
+        for m, dev, _ in n.adev():
+            if dev > target:
+                continue
+
+            if period and m * tau0 > period:
+                break
+
+            # deeper than the avg command, only the CIC build of oss 0
+            if m > AVG_MAX and (oss or m > 1 << CIC_RATE_MAX):
+                break
+
+            cost = m * CONV_MS[oss] + (m + 31) // 32 * UT_MS
+
+            if best is None or cost < best[0]:
+                best = (cost, oss, m, dev, m * tau0)
+
+            break
+
+    if best is None:
+        out.write("# no setup reaches %.3f Pa%s\n" %
+                  (target, " within %g ms" % period if period else ""))
+        return 1
+
+    cost, oss, m, dev, ms = best
+
+    if m > AVG_MAX:
+        rate = m.bit_length() - 1
+        out.write("# oss 0 CIC rate %d: %.3f Pa, %.0f ms per output, "
+                  "%d ms converting\n" % (rate, dev, ms, cost))
+        out.write("# build: make CIC=%d, the avg command takes at most %d\n"
+                  % (rate, AVG_MAX))
+    else:
+        out.write("# oss %d avg %d: %.3f Pa, %.0f ms per output, "
+                  "%d ms converting\n" % (oss, m, dev, ms, cost))
+        out.write("# commands (make CMD=1): oss %d, avg %d\n" % (oss, m))
+
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="serial capture, - for stdin")
+    parser.add_argument("-m", "--max-tau", type=int, default=1024,
+                        help="max tau in samples, a power of 2 (1024)")
+    parser.add_argument("-s", "--segment", type=int, default=256,
+                        help="PSD segment, a power of 2 (256)")
+    parser.add_argument("-t", "--target", type=float, help="noise target, Pa")
+    parser.add_argument("-p", "--period", type=float,
+                        help="max ms per output, with -t")
+    args = parser.parse_args()
+
+    if args.segment & (args.segment - 1):
+        parser.error("the PSD segment must be a power of 2")
+
+    if args.capture == "-":
+        noise = read(sys.stdin, args.max_tau, args.segment)
+    else:
+        with open(args.capture) as f:
+            noise = read(f, args.max_tau, args.segment)
+
+    if not noise:
+        sys.exit("no samples in the capture")
+
+    report(noise, sys.stdout)
+
+    if args.target:
+        sys.exit(suggest(noise, args.target, args.period, sys.stdout))
+
+
+if __name__ == "__main__":
+    main()
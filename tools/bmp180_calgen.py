@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# Copyright (C) 2017 Enrico Rossi
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Generate the calibration specialized compensation header.
+
+The input is a dumped calibration block, either the output of
+print_struct() ("AC1: 408" lines) or the 22 raw bytes in hex, ex.
+    bmp180_calgen.py dump.txt -o bmp180_cal_node7.h
+    bmp180_calgen.py --hex "01 98 ff b8 ..." -o bmp180_cal_node7.h
+
+Build the firmware with make CAL=bmp180_cal_node7.h, the driver uses
+the constant coefficients only if the sensor's calibration is the
+same, the CRC of the block is a quick first check. Any other sensor
+falls back to the generic code.
+
+With --table the calibrations of the sensors of a node, in the order
+they are added to the set, become the flash table of bmp180_set.h
+(BMP180_SET_CAL_FLASH), a C source to build with the firmware, ex.
+    bmp180_calgen.py --table s0.txt s1.txt -o bmp180_set_cal.c
+"""
+
+import argparse
+import re
+import sys
+
+NAMES = ["AC1", "AC2", "AC3", "AC4", "AC5", "AC6", "B1", "B2", "MB", "MC", "MD"]
+UNSIGNED = ("AC4", "AC5", "AC6")
+
+HEADER = """/* Generated by tools/bmp180_calgen.py, do not edit.
+ *
+ * Compensation specialized for the sensor with calibration
+ * CRC 0x%(crc)02x, %(source)s.
+ */
+
+#ifndef _BMP180_CAL_FIXED
+#define _BMP180_CAL_FIXED
+
+#include "bmp180_math.h"
+
+/*! CRC-8 (poly 0x07) of the raw calibration block */
+#define BMP180_FIXED_CRC 0x%(crc)02x
+
+/*! The coefficients */
+BMP180_CONST struct bmp180_cal_t bmp180_fixed_cal = {
+%(values)s
+};
+
+BMP180_INLINE int32_t bmp180_fixed_b5(const int32_t UT)
+{
+	return(bmp180_math_b5(&bmp180_fixed_cal, UT));
+}
+
+BMP180_INLINE int32_t bmp180_fixed_pressure(const int32_t b5,
+		const int32_t UP, const uint8_t oss)
+{
+	return(bmp180_math_pressure(&bmp180_fixed_cal, b5, UP, oss));
+}
+
+#endif
+"""
+
+TABLE = """/* Generated by tools/bmp180_calgen.py --table, do not edit. */
+
+#include <avr/pgmspace.h>
+#include "bmp180_set.h"
+
+#if BMP180_SET_SIZE < %(n)d
+#error the table has more sensors than BMP180_SET_SIZE
+#endif
+
+const struct bmp180_cal_t bmp180_set_cal_P[BMP180_SET_SIZE] PROGMEM = {
+%(rows)s
+};
+"""
+
+
+def crc8(data):
+    """CRC-8, poly 0x07, init 0, the same of the driver."""
+    crc = 0
+
+    for byte in data:
+        crc ^= byte
+
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xff if crc & 0x80 else (crc << 1) & 0xff
+
+    return crc
+
+
+def from_text(text):
+    """Coefficients from the print_struct() output."""
+    values = {}
+
+    for name, value in re.findall(r"\b(AC[1-6]|B[12]|M[BCD])\s*:\s*(-?\d+)", text):
+        values[name] = int(value)
+
+    missing = [n for n in NAMES if n not in values]
+
+    if missing:
+        sys.exit("missing coefficients: " + " ".join(missing))
+
+    raw = bytearray()
+
+    for name in NAMES:
+        raw += (values[name] & 0xffff).to_bytes(2, "big")
+
+    return bytes(raw)
+
+
+def from_hex(text):
+    raw = bytes.fromhex(re.sub(r"0x|[\s,]", "", text))
+
+    if len(raw) != 22:
+        sys.exit("the calibration block is 22 bytes, got %d" % len(raw))
+
+    return raw
+
+
+def decode(raw):
+    values = []
+
+    for i, name in enumerate(NAMES):
+        values.append(int.from_bytes(raw[i * 2:i * 2 + 2], "big",
+                                     signed=name not in UNSIGNED))
+
+    return values
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", nargs="*", help="print_struct() output, - for stdin")
+    parser.add_argument("--hex", action="append", default=[],
+                        help="the raw block in hex, repeated with --table")
+    parser.add_argument("--table", action="store_true",
+                        help="the flash table of bmp180_set.h")
+    parser.add_argument("-o", "--output", help="output file, default stdout")
+    args = parser.parse_args()
+
+    blocks = [(from_hex(h), "raw block") for h in args.hex]
+
+    for dump in args.dump:
+        text = sys.stdin.read() if dump == "-" else open(dump).read()
+        blocks.append((from_text(text), "from " + ("stdin" if dump == "-" else dump)))
+
+    if not blocks:
+        parser.error("either a dump file or --hex is needed")
+
+    if args.table:
+        rows = []
+
+        for raw, source in blocks:
+            rows.append("\t{%s}, /* %s */" %
+                        (", ".join("%d" % v for v in decode(raw)), source))
+
+        header = TABLE % {"n": len(blocks), "rows": "\n".join(rows)}
+    elif len(blocks) > 1:
+        parser.error("one calibration only, without --table")
+    else:
+        raw, source = blocks[0]
+        values = decode(raw)
+        body = ",\n".join("\t%d /* %s */" % (v, n) for n, v in zip(NAMES, values))
+        header = HEADER % {"crc": crc8(raw), "source": source, "values": body}
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(header)
+    else:
+        sys.stdout.write(header)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# Copyright (C) 2017 Enrico Rossi
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Decode the sample log dump (see logger.h) into CSV.
+
+The dump is the output of the "dump" command of the firmware built
+with make CMD=1 LOG=eeprom (or LOG=nor), ex.
+    stty -F /dev/ttyUSB0 115200 raw; cat /dev/ttyUSB0 > dump.txt
+Other lines around the dump are skipped.
+
+The blocks are decoded oldest first, by their seq. Output is
+"t,p,T" per sample, t in the firmware time unit (main.c 0.1 s),
+p in Pa and T in 0.1 C. A time going back marks a reboot: t
+restarts from 0. The bytes per sample are printed on stderr.
+"""
+
+import argparse
+import sys
+
+MAGIC = 0xb1
+HEADER = 15
+# bits of the value after a prefix of n ones
+WIDTH = [0, 4, 8, 16, 32]
+
+
+class Bits:
+    """MSB first bit reader, EOFError at the end."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, n):
+        v = 0
+
+        for _ in range(n):
+            if self.pos >= len(self.data) * 8:
+                raise EOFError
+
+            byte = self.data[self.pos >> 3]
+            v = (v << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+
+        return v
+
+
+def field(bits):
+    """A prefix coded zig-zag field, None for the end marker."""
+    ones = 0
+
+    while ones < 4 and bits.get(1):
+        ones += 1
+
+    if ones == 0:
+        return 0
+
+    z = bits.get(WIDTH[ones])
+
+    if ones == 4 and z == 0xffffffff:
+        return None
+
+    return (z >> 1) ^ -(z & 1)
+
+
+def signed(v, bits):
+    return v - (1 << bits) if v & (1 << (bits - 1)) else v
+
+
+def block(data):
+    """[(t, p, T)] of a block and the bytes used."""
+    le = int.from_bytes
+    t = le(data[3:7], "little")
+    dt = signed(le(data[7:9], "little"), 16)
+    p = signed(le(data[9:13], "little"), 32)
+    T = signed(le(data[13:15], "little"), 16)
+    samples = [(t, p, T)]
+    bits = Bits(data[HEADER:])
+    end = 0
+
+    try:
+        while True:
+            dod = field(bits)
+            dp = field(bits)
+            dT = field(bits)
+
+            if None in (dod, dp, dT):
+                break
+
+            end = bits.pos
+            dt += dod
+            t = (t + dt) & 0xffffffff
+            p += dp
+            T += dT
+            samples.append((t, p, T))
+    except EOFError:
+        pass
+
+    return samples, HEADER + (end + 7) // 8
+
+
+def read(f):
+    image = {}
+    block_size = blocks = None
+    stats = None
+
+    for line in f:
+        fields = line.split()
+
+        if len(fields) == 5 and fields[0] == "LOG":
+            block_size, blocks = int(fields[1]), int(fields[2])
+            stats = (int(fields[3]), int(fields[4]))
+        elif len(fields) == 3 and fields[0] == "L":
+            try:
+                image[int(fields[1])] = bytes.fromhex(fields[2])
+            except ValueError:
+                sys.stderr.write("skipped: %s" % line)
+
+    if block_size is None:
+        sys.exit("no LOG header in the dump")
+
+    mem = bytearray(b"\xff" * (block_size * blocks))
+
+    for addr, data in image.items():
+        mem[addr:addr + len(data)] = data
+
+    return mem, block_size, blocks, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="the dump, - for stdin")
+    parser.add_argument("-o", "--output", help="CSV file, default stdout")
+    args = parser.parse_args()
+
+    if args.dump == "-":
+        mem, block_size, blocks, stats = read(sys.stdin)
+    else:
+        with open(args.dump) as f:
+            mem, block_size, blocks, stats = read(f)
+
+    found = []
+
+    for i in range(blocks):
+        data = mem[i * block_size:(i + 1) * block_size]
+
+        if data[0] == MAGIC:
+            found.append((int.from_bytes(data[1:3], "little"), data))
+
+    if not found:
+        sys.exit("the log is empty")
+
+    # oldest first: the newest seq is followed by the oldest in the
+    # ring, the seqs are serial numbers
+    newest = found[0][0]
+
+    for seq, _ in found:
+        if (seq - newest) & 0xffff < 0x8000:
+            newest = seq
+
+    found.sort(key=lambda b: (b[0] - newest - 1) & 0xffff)
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    out.write("t,p,T\n")
+    total = used = 0
+
+    for seq, data in found:
+        samples, size = block(data)
+        total += len(samples)
+        used += size
+
+        for sample in samples:
+            out.write("%d,%d,%d\n" % sample)
+
+    sys.stderr.write("%d blocks, %d samples, %.2f bytes per sample\n" %
+                     (len(found), total, used / total))
+
+    if stats and stats[0]:
+        sys.stderr.write("this run: %d samples, %.2f bytes per sample\n" %
+                         (stats[0], stats[1] / stats[0]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# Copyright (C) 2017 Enrico Rossi
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Decode the binary trace dump (see trace.h) into a timeline.
+
+The dump can be captured with anything that saves the raw bytes of
+the serial line, ex.
+    stty -F /dev/ttyUSB0 115200 raw; cat /dev/ttyUSB0 > dump.bin
+then send a 'T' to the board. Non trace bytes around the frames
+are skipped.
+
+Output is an indented timeline with the duration of each trace
+point and, with -o, the folded stacks for flamegraph.pl.
+"""
+
+import argparse
+import sys
+
+# keep in sync with trace.h
+NAMES = {
+    1: "register_rb",
+    2: "register_rw",
+    3: "math_temperature",
+    4: "math_pressure",
+    5: "math_altitude",
+    6: "delay",
+    7: "uart",
+}
+EXIT = 0x80
+
+
+def frames(data):
+    """Yield the list of (id, cycles) of every valid frame."""
+    i = 0
+
+    while True:
+        i = data.find(b"TR", i)
+
+        if i < 0 or i + 3 > len(data):
+            return
+
+        n = data[i + 2]
+        end = i + 3 + n * 5
+
+        if end >= len(data):
+            return
+
+        if sum(data[i:end]) & 0xff != data[end]:
+            i += 1
+            continue
+
+        events = []
+
+        for k in range(n):
+            j = i + 3 + k * 5
+            events.append((data[j], int.from_bytes(data[j + 1:j + 5], "little")))
+
+        yield events
+        i = end + 1
+
+
+def timeline(events, fcpu, folded, out):
+    """Pair enter/exit events, print them and fill the folded stacks."""
+    stack = []
+    t0 = events[0][1] if events else 0
+
+    for ev, cycles in events:
+        dt = (cycles - t0) & 0xffffffff
+        name = NAMES.get(ev & ~EXIT, "id%d" % (ev & ~EXIT))
+
+        if not ev & EXIT:
+            out.write("%10.1f us %s> %s\n" % (dt * 1e6 / fcpu, "  " * len(stack), name))
+            stack.append((name, cycles, 0))
+            continue
+
+        # exit without its enter, the buffer wrapped
+        if not stack or stack[-1][0] != name:
+            continue
+
+        name, start, child = stack.pop()
+        total = (cycles - start) & 0xffffffff
+        out.write("%10.1f us %s< %s %.1f us\n" % (dt * 1e6 / fcpu, "  " * len(stack),
+                                               name, total * 1e6 / fcpu))
+        path = ";".join([s[0] for s in stack] + [name])
+        # self time only, the children add their own
+        folded[path] = folded.get(path, 0) + total - child
+
+        if stack:
+            parent = stack[-1]
+            stack[-1] = (parent[0], parent[1], parent[2] + total)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="raw dump file, - for stdin")
+    parser.add_argument("-f", "--fcpu", type=float, default=16e6, help="CPU clock (16e6)")
+    parser.add_argument("-o", "--folded", help="write the folded stacks (cycles) here")
+    args = parser.parse_args()
+
+    if args.dump == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.dump, "rb") as f:
+            data = f.read()
+
+    folded = {}
+
+    for n, events in enumerate(frames(data)):
+        sys.stdout.write("# dump %d, %d events\n" % (n, len(events)))
+        timeline(events, args.fcpu, folded, sys.stdout)
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for path, cycles in sorted(folded.items()):
+                f.write("%s %d\n" % (path, cycles))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <util/atomic.h>
+#include "timer.h"
+#include "uart.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLE
+
+/*! A trace event. */
+struct event_t {
+	uint8_t id;
+	uint32_t cycles;
+};
+
+static struct event_t buffer[TRACE_SIZE];
+/* next slot */
+static uint8_t head;
+/* events in the buffer */
+static uint8_t count;
+
+/*! Start the cycle counter and clear the buffer.
+ *
+ * \note interrupts must be enabled.
+ */
+void trace_init(void)
+{
+	head = 0;
+	count = 0;
+	timer_init();
+}
+
+/*! Record an event, it can be called from an ISR. */
+void trace_put(const uint8_t id)
+{
+	uint32_t cycles;
+
+	cycles = timer_cycles();
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		buffer[head].id = id;
+		buffer[head].cycles = cycles;
+		head = (head + 1) & TRACE_MASK;
+
+		if (count < TRACE_SIZE)
+			count++;
+	}
+}
+
+static void put(const uint8_t c, uint8_t *sum)
+{
+	*sum += c;
+	uart_putchar(0, c);
+}
+
+/*! Send the buffer, oldest event first, and clear it. */
+void trace_dump(void)
+{
+	struct event_t ev;
+	uint8_t i, n, tail, sum;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = count;
+		tail = (head - n) & TRACE_MASK;
+		count = 0;
+	}
+
+	sum = 0;
+	put('T', &sum);
+	put('R', &sum);
+	put(n, &sum);
+
+	for (i = 0; i < n; i++) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			ev = buffer[(tail + i) & TRACE_MASK];
+		}
+
+		put(ev.id, &sum);
+		put(ev.cycles, &sum);
+		put(ev.cycles >> 8, &sum);
+		put(ev.cycles >> 16, &sum);
+		put(ev.cycles >> 24, &sum);
+	}
+
+	uart_putchar(0, sum);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/* Copyright (C) 2017 Enrico Rossi
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file trace.h
+ * \brief Cycle stamped trace points.
+ *
+ * Enabled with -D TRACE_ENABLE (make TRACE=1), otherwise every
+ * macro compiles to nothing. Each event is stored in a RAM ring
+ * buffer with the Timer1 cycles, the oldest are overwritten.
+ *
+ * The dump is binary:
+ * 'T' 'R' <n> then n times <id> <cycles, 4 byte LSB first>
+ * then the 8 bit sum of all the previous bytes.
+ * tools/trace2flame.py decodes it.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+/*! Events in the buffer, power of 2 */
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 32
+#endif
+/*! Buffer mask */
+#define TRACE_MASK ( TRACE_SIZE - 1 )
+/*! Check if something is wrong in the definitions */
+#if ( TRACE_SIZE & TRACE_MASK ) || ( TRACE_SIZE > 128 )
+#error TRACE_SIZE is not a power of 2 or is bigger than 128
+#endif
+
+/* exit events have the MSB set */
+#define TRACE_EXIT 0x80
+
+/* trace points, keep in sync with tools/trace2flame.py */
+#define TRACE_REGISTER_RB 1
+#define TRACE_REGISTER_RW 2
+#define TRACE_MATH_TEMPERATURE 3
+#define TRACE_MATH_PRESSURE 4
+#define TRACE_MATH_ALTITUDE 5
+#define TRACE_DELAY 6
+#define TRACE_UART 7
+
+#ifdef TRACE_ENABLE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_init(void);
+void trace_put(const uint8_t id);
+void trace_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define TRACE_IN(id) trace_put(id)
+#define TRACE_OUT(id) trace_put((id) | TRACE_EXIT)
+
+#else /* TRACE_ENABLE */
+
+#define trace_init() do {} while (0)
+#define trace_dump() do {} while (0)
+#define TRACE_IN(id) do {} while (0)
+#define TRACE_OUT(id) do {} while (0)
+
+#endif /* TRACE_ENABLE */
+#endif
@@ -17,7 +17,59 @@
 
 #include <stdint.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "uart.h"
+#include "trace.h"
+
+/* something has been sent, see uart_flush() */
+static uint8_t tx_used;
+
+#ifdef UART_TX_IRQ
+/* TX ring, the ISR sends it while the CPU sleeps */
+static char tx_buffer[UART_TXBUF_SIZE];
+static volatile uint8_t tx_head;
+static volatile uint8_t tx_tail;
+
+/*! Send the next char, stop when the buffer is empty. */
+ISR(USART_UDRE_vect)
+{
+	if (tx_head == tx_tail) {
+		UCSR0B &= ~_BV(UDRIE0);
+	} else {
+		UDR0 = tx_buffer[tx_tail];
+		/* TXC is set again when this char is out */
+		UCSR0A |= _BV(TXC0);
+		tx_tail = (tx_tail + 1) & UART_TXBUF_MASK;
+	}
+}
+#endif
+
+#ifdef UART_RX_IRQ
+/* RX ring, filled by the ISR while the CPU is busy or asleep */
+static char rx_buffer[UART_RXBUF_SIZE];
+static volatile uint8_t rx_head;
+static volatile uint8_t rx_tail;
+/* chars dropped on a full buffer */
+static volatile uint8_t rx_lost;
+
+/*! Store the received char, drop it if the buffer is full. */
+ISR(USART_RX_vect)
+{
+	char c;
+	uint8_t next;
+
+	c = UDR0;
+	next = (rx_head + 1) & UART_RXBUF_MASK;
+
+	if (next == rx_tail) {
+		if (rx_lost < 0xff)
+			rx_lost++;
+	} else {
+		rx_buffer[rx_head] = c;
+		rx_head = next;
+	}
+}
+#endif
 
 /*! Init the uart port. */
 void uart_init(const uint8_t port)
@@ -26,6 +78,9 @@ void uart_init(const uint8_t port)
 	UBRR0L = 8;
 	/*! tx/rx enable */
 	UCSR0B = _BV(TXEN0) | _BV(RXEN0);
+#ifdef UART_RX_IRQ
+	UCSR0B |= _BV(RXCIE0);
+#endif
 	/* 8n2 */
 	UCSR0C = _BV(USBS0) | _BV(UCSZ00) | _BV(UCSZ01);
 }
@@ -39,9 +94,26 @@ void uart_shutdown(const uint8_t port)
 	UCSR0A = 0;
 }
 
-/*! Get a char from the uart port. */
+/*! Get a char from the uart port.
+ *
+ * \param locked wait for a char, else return 0 if there is none.
+ */
 char uart_getchar(const uint8_t port, const uint8_t locked)
 {
+#ifdef UART_RX_IRQ
+	char c;
+
+	if (rx_head == rx_tail) {
+		if (!locked)
+			return(0);
+
+		while (rx_head == rx_tail);
+	}
+
+	c = rx_buffer[rx_tail];
+	rx_tail = (rx_tail + 1) & UART_RXBUF_MASK;
+	return(c);
+#else
 	if (locked) {
 		loop_until_bit_is_set(UCSR0A, RXC0);
 		return(UDR0);
@@ -52,25 +124,75 @@ char uart_getchar(const uint8_t port, const uint8_t locked)
 			return(0);
 
 	}
+#endif
+}
+
+/*! Chars received and dropped on a full RX buffer.
+ *
+ * Always 0 without UART_RX_IRQ, the hardware overrun is not counted.
+ */
+uint8_t uart_rx_lost(const uint8_t port)
+{
+#ifdef UART_RX_IRQ
+	return(rx_lost);
+#else
+	return(0);
+#endif
 }
 
 /*! Send character c down the UART Tx, wait until tx holding register
- * is empty.
+ * is empty, with UART_TX_IRQ until there is room in the TX buffer.
  */
 void uart_putchar(const uint8_t port, const char c)
 {
+#ifdef UART_TX_IRQ
+	uint8_t next;
+
+	tx_used = 1;
+	next = (tx_head + 1) & UART_TXBUF_MASK;
+
+	/* the buffer is full, wait for the ISR */
+	while (next == tx_tail);
+
+	tx_buffer[tx_head] = c;
+	tx_head = next;
+	UCSR0B |= _BV(UDRIE0);
+#else
+	tx_used = 1;
 	loop_until_bit_is_set(UCSR0A, UDRE0);
 	UDR0 = c;
+	UCSR0A |= _BV(TXC0);
+#endif
+}
+
+/*! Wait until the last char is out of the shift register.
+ *
+ * Needed before a sleep mode stopping the UART clock.
+ */
+void uart_flush(const uint8_t port)
+{
+#ifdef UART_TX_IRQ
+	while (tx_head != tx_tail);
+#endif
+	/* TXC is never set if nothing has been sent */
+	if (!tx_used)
+		return;
+
+	loop_until_bit_is_set(UCSR0A, TXC0);
 }
 
 /*! Send a C (NUL-terminated) string down the UART Tx.
  */
 void uart_printstr(const uint8_t port, const char *s)
 {
+	TRACE_IN(TRACE_UART);
+
 	while (*s) {
 		if (*s == '\n')
 			uart_putchar (0, '\r');
 
 		uart_putchar(port, *s++);
 	}
+
+	TRACE_OUT(TRACE_UART);
 }
@@ -64,7 +64,9 @@ struct uartStruct {
 void uart_init(const uint8_t port);
 void uart_shutdown(const uint8_t port);
 char uart_getchar(const uint8_t port, const uint8_t locked);
+uint8_t uart_rx_lost(const uint8_t port);
 void uart_putchar(const uint8_t port, const char c);
 void uart_printstr(const uint8_t port, const char *s);
+void uart_flush(const uint8_t port);
 
 #endif